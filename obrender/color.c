@@ -103,7 +103,13 @@ RrColor *RrColorNew(const RrInstance *inst, gint r, gint g, gint b)
 
 RrColor *RrColorCopy(RrColor* c)
 {
+#ifndef NO_COLOR_CACHE
+    /* RrColorNew would find this same color in the cache */
+    c->refcount++;
+    return c;
+#else
     return RrColorNew(c->inst, c->r, c->g, c->b);
+#endif
 }
 
 void RrColorFree(RrColor *c)
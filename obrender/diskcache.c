@@ -0,0 +1,345 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   diskcache.c for the Openbox window manager
+   Copyright (c) 2026        agent
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "diskcache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* The file is made of a header, followed by arrays of CacheEntry and
+   CachePic, then all the strings that they refer to, and then the pixel
+   data.  All of the numbers are in the machine's byte order, as the file is
+   only used on the machine that made it.  Each section starts on a multiple
+   of CACHE_ALIGN bytes, so that the 64-bit numbers in it can be read in
+   place from the mapped file. */
+
+#define CACHE_MAGIC "OBIC"
+/*! Change this when the layout of the file changes */
+#define CACHE_VERSION 2
+#define CACHE_ALIGN 8
+#define CACHE_ALIGN_UP(n) (((n) + CACHE_ALIGN - 1) & ~(CACHE_ALIGN - 1))
+
+typedef struct _CacheHeader CacheHeader;
+typedef struct _CacheEntry  CacheEntry;
+typedef struct _CachePic    CachePic;
+
+struct _CacheHeader {
+    gchar magic[4];
+    guint32 version;
+    guint32 length; /*!< The size of the whole file */
+    guint32 n_entries;
+    guint32 n_pics;
+    guint32 entries; /*!< Offsets of the sections from the start of the file */
+    guint32 pics;
+    guint32 strings;
+    guint32 data;
+    guint32 pad; /*!< Keeps the size a multiple of CACHE_ALIGN */
+};
+
+/*! An image file, sorted by its path and then its size */
+struct _CacheEntry {
+    guint32 path; /*!< An offset from the start of the strings */
+    gint32 size;
+    gint64 mtime;
+    guint32 first_pic;
+    guint32 n_pics;
+};
+
+struct _CachePic {
+    gint32 width;
+    gint32 height;
+    guint32 data; /*!< An offset from the start of the pixel data */
+};
+
+struct _RrDiskCache {
+    GMappedFile *mapped;
+    const gchar *file;
+    const CacheHeader *header;
+};
+
+typedef struct _WriterEntry {
+    const gchar *path;
+    gint64 mtime;
+    gint size;
+    RrDiskCachePic *pics;
+    gint n_pics;
+} WriterEntry;
+
+struct _RrDiskCacheWriter {
+    GArray *entries;
+};
+
+static gint entry_cmp(const gchar *path_a, gint size_a,
+                      const gchar *path_b, gint size_b)
+{
+    gint c = strcmp(path_a, path_b);
+    if (c == 0)
+        c = (size_a > size_b) - (size_a < size_b);
+    return c;
+}
+
+/*! Returns TRUE if the file is well formed, so that nothing in it points
+  outside of it */
+static gboolean cache_valid(const gchar *file, gsize length)
+{
+    const CacheHeader *h = (const CacheHeader*)file;
+    const CacheEntry *entries;
+    const CachePic *pics;
+    guint32 i;
+
+    if (length < sizeof(CacheHeader) ||
+        memcmp(h->magic, CACHE_MAGIC, sizeof(h->magic)) ||
+        h->version != CACHE_VERSION ||
+        h->length != length ||
+        h->entries != sizeof(CacheHeader) ||
+        h->pics != h->entries + h->n_entries * sizeof(CacheEntry) ||
+        h->strings !=
+            CACHE_ALIGN_UP(h->pics + h->n_pics * sizeof(CachePic)) ||
+        h->data < h->strings || h->data > length ||
+        h->data % CACHE_ALIGN != 0 ||
+        (h->data > h->strings && file[h->data-1] != '\0'))
+    {
+        return FALSE;
+    }
+
+    entries = (const CacheEntry*)(file + h->entries);
+    for (i = 0; i < h->n_entries; ++i)
+        if (entries[i].path >= h->data - h->strings ||
+            entries[i].n_pics == 0 ||
+            entries[i].first_pic > h->n_pics ||
+            entries[i].n_pics > h->n_pics - entries[i].first_pic)
+        {
+            return FALSE;
+        }
+
+    pics = (const CachePic*)(file + h->pics);
+    for (i = 0; i < h->n_pics; ++i) {
+        gsize bytes = (gsize)pics[i].width * pics[i].height *
+            sizeof(RrPixel32);
+
+        if (pics[i].width <= 0 || pics[i].height <= 0 ||
+            pics[i].data % sizeof(RrPixel32) != 0 ||
+            pics[i].data > length - h->data ||
+            bytes > length - h->data - pics[i].data)
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+RrDiskCache* RrDiskCacheOpen(const gchar *file)
+{
+    RrDiskCache *self;
+    GMappedFile *mapped;
+    const gchar *contents;
+
+    if (!(mapped = g_mapped_file_new(file, FALSE, NULL)))
+        return NULL;
+
+    contents = g_mapped_file_get_contents(mapped);
+    if (!contents || !cache_valid(contents, g_mapped_file_get_length(mapped)))
+    {
+        g_mapped_file_unref(mapped);
+        return NULL;
+    }
+
+    self = g_slice_new(RrDiskCache);
+    self->mapped = mapped;
+    self->file = contents;
+    self->header = (const CacheHeader*)contents;
+    return self;
+}
+
+void RrDiskCacheClose(RrDiskCache *self)
+{
+    if (self) {
+        g_mapped_file_unref(self->mapped);
+        g_slice_free(RrDiskCache, self);
+    }
+}
+
+gint RrDiskCacheLookup(RrDiskCache *self, const gchar *path, gint64 mtime,
+                       gint size, RrDiskCachePic **pics)
+{
+    const CacheHeader *h = self->header;
+    const CacheEntry *entries, *e;
+    const CachePic *p;
+    const gchar *strings;
+    guint32 l, r, m, i;
+    gint c;
+
+    entries = (const CacheEntry*)(self->file + h->entries);
+    strings = self->file + h->strings;
+
+    e = NULL;
+    l = 0;
+    r = h->n_entries;
+    while (l < r) {
+        m = l + (r - l) / 2;
+        c = entry_cmp(path, size, strings + entries[m].path, entries[m].size);
+        if (c == 0) {
+            e = &entries[m];
+            break;
+        }
+        else if (c < 0)
+            r = m;
+        else
+            l = m + 1;
+    }
+
+    /* the file was changed since it was saved */
+    if (!e || e->mtime != mtime)
+        return 0;
+
+    p = (const CachePic*)(self->file + h->pics) + e->first_pic;
+    *pics = g_new(RrDiskCachePic, e->n_pics);
+    for (i = 0; i < e->n_pics; ++i) {
+        (*pics)[i].width = p[i].width;
+        (*pics)[i].height = p[i].height;
+        (*pics)[i].data = (const RrPixel32*)(self->file + h->data +
+                                             p[i].data);
+    }
+    return e->n_pics;
+}
+
+RrDiskCacheWriter* RrDiskCacheWriterNew(void)
+{
+    RrDiskCacheWriter *w;
+
+    w = g_slice_new(RrDiskCacheWriter);
+    w->entries = g_array_new(FALSE, FALSE, sizeof(WriterEntry));
+    return w;
+}
+
+void RrDiskCacheWriterAdd(RrDiskCacheWriter *w, const gchar *path,
+                          gint64 mtime, gint size,
+                          const RrDiskCachePic *pics, gint n_pics)
+{
+    WriterEntry e;
+
+    g_return_if_fail(n_pics > 0);
+
+    e.path = g_strdup(path);
+    e.mtime = mtime;
+    e.size = size;
+    e.pics = g_memdup(pics, n_pics * sizeof(RrDiskCachePic));
+    e.n_pics = n_pics;
+    g_array_append_val(w->entries, e);
+}
+
+static gint writer_entry_cmp(const void *a, const void *b)
+{
+    const WriterEntry *ea = a, *eb = b;
+    return entry_cmp(ea->path, ea->size, eb->path, eb->size);
+}
+
+gboolean RrDiskCacheWriterSave(RrDiskCacheWriter *w, const gchar *file)
+{
+    CacheHeader h;
+    GArray *entries, *pics;
+    GString *strings, *out;
+    guint32 data_len, i;
+    gint j;
+    gboolean ret;
+
+    /* sort the entries for searching, and drop any repeats */
+    qsort(w->entries->data, w->entries->len, sizeof(WriterEntry),
+          writer_entry_cmp);
+
+    entries = g_array_new(FALSE, FALSE, sizeof(CacheEntry));
+    pics = g_array_new(FALSE, FALSE, sizeof(CachePic));
+    strings = g_string_new(NULL);
+    data_len = 0;
+    for (i = 0; i < w->entries->len; ++i) {
+        WriterEntry *we = &g_array_index(w->entries, WriterEntry, i);
+        CacheEntry ce;
+
+        if (i > 0 && writer_entry_cmp(we, we - 1) == 0)
+            continue;
+
+        ce.path = strings->len;
+        g_string_append_len(strings, we->path, strlen(we->path) + 1);
+        ce.size = we->size;
+        ce.mtime = we->mtime;
+        ce.first_pic = pics->len;
+        ce.n_pics = we->n_pics;
+        g_array_append_val(entries, ce);
+
+        for (j = 0; j < we->n_pics; ++j) {
+            CachePic cp;
+
+            cp.width = we->pics[j].width;
+            cp.height = we->pics[j].height;
+            cp.data = data_len;
+            g_array_append_val(pics, cp);
+            data_len += cp.width * cp.height * sizeof(RrPixel32);
+        }
+    }
+    /* pad the strings so the pixel data is aligned */
+    while (strings->len % CACHE_ALIGN)
+        g_string_append_c(strings, '\0');
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CACHE_MAGIC, sizeof(h.magic));
+    h.version = CACHE_VERSION;
+    h.n_entries = entries->len;
+    h.n_pics = pics->len;
+    h.entries = sizeof(CacheHeader);
+    h.pics = h.entries + h.n_entries * sizeof(CacheEntry);
+    h.strings = CACHE_ALIGN_UP(h.pics + h.n_pics * sizeof(CachePic));
+    h.data = h.strings + strings->len;
+    h.length = h.data + data_len;
+
+    out = g_string_sized_new(h.length);
+    g_string_append_len(out, (gchar*)&h, sizeof(h));
+    g_string_append_len(out, entries->data,
+                        entries->len * sizeof(CacheEntry));
+    g_string_append_len(out, pics->data, pics->len * sizeof(CachePic));
+    while (out->len < h.strings)
+        g_string_append_c(out, '\0');
+    g_string_append_len(out, strings->str, strings->len);
+    for (i = 0; i < w->entries->len; ++i) {
+        WriterEntry *we = &g_array_index(w->entries, WriterEntry, i);
+
+        if (i > 0 && writer_entry_cmp(we, we - 1) == 0)
+            continue;
+        for (j = 0; j < we->n_pics; ++j)
+            g_string_append_len(out, (const gchar*)we->pics[j].data,
+                                we->pics[j].width * we->pics[j].height *
+                                sizeof(RrPixel32));
+    }
+    g_assert(out->len == h.length);
+
+    /* this replaces the file atomically, so anything which has the old file
+       mapped into memory is not disturbed */
+    ret = g_file_set_contents(file, out->str, out->len, NULL);
+
+    g_string_free(out, TRUE);
+    g_string_free(strings, TRUE);
+    g_array_free(pics, TRUE);
+    g_array_free(entries, TRUE);
+    for (i = 0; i < w->entries->len; ++i) {
+        WriterEntry *we = &g_array_index(w->entries, WriterEntry, i);
+        g_free((gchar*)we->path);
+        g_free(we->pics);
+    }
+    g_array_free(w->entries, TRUE);
+    g_slice_free(RrDiskCacheWriter, w);
+    return ret;
+}
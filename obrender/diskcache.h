@@ -0,0 +1,72 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   diskcache.h for the Openbox window manager
+   Copyright (c) 2026        agent
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef __diskcache_h
+#define __diskcache_h
+
+#include "render.h"
+
+#include <glib.h>
+
+/*! A file holding decoded image files, so that they do not need to be decoded
+  again the next time they are used.  The file is mapped into memory and is
+  never changed while it is open, so it can be read from any thread. */
+typedef struct _RrDiskCache       RrDiskCache;
+/*! Collects decoded image files to be saved as a new RrDiskCache file. */
+typedef struct _RrDiskCacheWriter RrDiskCacheWriter;
+typedef struct _RrDiskCachePic    RrDiskCachePic;
+
+struct _RrDiskCachePic {
+    gint width;
+    gint height;
+    const RrPixel32 *data;
+};
+
+/*! Open a disk cache file.  Returns NULL if the file does not exist, or was
+  written by a different version of Openbox. */
+RrDiskCache* RrDiskCacheOpen(const gchar *file);
+void RrDiskCacheClose(RrDiskCache *self);
+
+/*! Find the pictures saved for an image file.
+  @param path The image file's path.
+  @param mtime The image file's modification time.  Pictures saved for any
+    other modification time are out of date and are not returned.
+  @param size The size that the image file was loaded for.
+  @param pics Set to a newly allocated array of the pictures.  The first is
+    the picture decoded from the file, and any others are resized versions of
+    it.  The pixel data belongs to the RrDiskCache.
+  @return The number of pictures in pics, or 0 if the file was not found.
+*/
+gint RrDiskCacheLookup(RrDiskCache *self, const gchar *path, gint64 mtime,
+                       gint size, RrDiskCachePic **pics);
+
+RrDiskCacheWriter* RrDiskCacheWriterNew(void);
+/*! Add the pictures for an image file to be saved.  The pixel data is not
+  copied, so it must exist until RrDiskCacheWriterSave() is called.  Only
+  one set of pictures is kept for each path and size.
+  @param pics The picture decoded from the file, followed by any resized
+    versions of it.
+*/
+void RrDiskCacheWriterAdd(RrDiskCacheWriter *w, const gchar *path,
+                          gint64 mtime, gint size,
+                          const RrDiskCachePic *pics, gint n_pics);
+/*! Write the disk cache file, replacing any existing one, and free the
+  writer. */
+gboolean RrDiskCacheWriterSave(RrDiskCacheWriter *w, const gchar *file);
+
+#endif
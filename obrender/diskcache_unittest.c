@@ -0,0 +1,162 @@
+#include "obt/unittest_base.h"
+
+#include "obrender/diskcache.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+static gchar *cache_dir = NULL;
+static gchar *cache_file = NULL;
+
+static RrPixel32 pixels_a[4 * 2] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+static RrPixel32 pixels_a_small[2 * 1] = { 9, 10 };
+static RrPixel32 pixels_b[3 * 3] = { 11, 12, 13, 14, 15, 16, 17, 18, 19 };
+
+static void set_up()
+{
+    RrDiskCacheWriter *w;
+    RrDiskCachePic pics[2];
+
+    cache_dir = g_dir_make_tmp("obrender-diskcache-XXXXXX", NULL);
+    cache_file = g_build_filename(cache_dir, "test.cache", NULL);
+
+    w = RrDiskCacheWriterNew();
+
+    pics[0].width = 3;
+    pics[0].height = 3;
+    pics[0].data = pixels_b;
+    RrDiskCacheWriterAdd(w, "/icons/b.png", 200, 48, pics, 1);
+
+    pics[0].width = 4;
+    pics[0].height = 2;
+    pics[0].data = pixels_a;
+    pics[1].width = 2;
+    pics[1].height = 1;
+    pics[1].data = pixels_a_small;
+    RrDiskCacheWriterAdd(w, "/icons/a.svg", 100, 16, pics, 2);
+
+    RrDiskCacheWriterSave(w, cache_file);
+}
+
+static void tear_down()
+{
+    g_remove(cache_file);
+    g_remove(cache_dir);
+    g_free(cache_file);
+    g_free(cache_dir);
+    cache_file = cache_dir = NULL;
+}
+
+/*! Change the cache file with func, and check that it is not opened */
+static void expect_rejected(void (*func)(gchar *contents, gsize *length))
+{
+    gchar *contents;
+    gsize length;
+    RrDiskCache *c;
+
+    g_file_get_contents(cache_file, &contents, &length, NULL);
+    func(contents, &length);
+    g_file_set_contents(cache_file, contents, length, NULL);
+    g_free(contents);
+
+    c = RrDiskCacheOpen(cache_file);
+    EXPECT_BOOL_EQ(TRUE, c == NULL);
+    RrDiskCacheClose(c);
+}
+
+static void round_trip() {
+    RrDiskCache *c;
+    RrDiskCachePic *pics;
+    gint n;
+
+    TEST_START();
+
+    set_up();
+    c = RrDiskCacheOpen(cache_file);
+    EXPECT_BOOL_EQ(TRUE, c != NULL);
+
+    n = RrDiskCacheLookup(c, "/icons/a.svg", 100, 16, &pics);
+    EXPECT_INT_EQ(2, n);
+    if (n == 2) {
+        EXPECT_INT_EQ(4, pics[0].width);
+        EXPECT_INT_EQ(2, pics[0].height);
+        EXPECT_BOOL_EQ(TRUE, !memcmp(pixels_a, pics[0].data,
+                                     sizeof(pixels_a)));
+        EXPECT_INT_EQ(2, pics[1].width);
+        EXPECT_INT_EQ(1, pics[1].height);
+        EXPECT_BOOL_EQ(TRUE, !memcmp(pixels_a_small, pics[1].data,
+                                     sizeof(pixels_a_small)));
+        g_free(pics);
+    }
+
+    n = RrDiskCacheLookup(c, "/icons/b.png", 200, 48, &pics);
+    EXPECT_INT_EQ(1, n);
+    if (n == 1) {
+        EXPECT_INT_EQ(3, pics[0].width);
+        EXPECT_BOOL_EQ(TRUE, !memcmp(pixels_b, pics[0].data,
+                                     sizeof(pixels_b)));
+        g_free(pics);
+    }
+
+    /* the file changed since it was saved */
+    EXPECT_INT_EQ(0, RrDiskCacheLookup(c, "/icons/a.svg", 101, 16, &pics));
+    /* it was not saved at this size */
+    EXPECT_INT_EQ(0, RrDiskCacheLookup(c, "/icons/a.svg", 100, 24, &pics));
+    /* it was not saved at all */
+    EXPECT_INT_EQ(0, RrDiskCacheLookup(c, "/icons/c.png", 100, 16, &pics));
+
+    RrDiskCacheClose(c);
+    tear_down();
+
+    TEST_END();
+}
+
+static void truncate_file(gchar *contents, gsize *length)
+{
+    (void)contents;
+    *length -= 1;
+}
+
+static void change_magic(gchar *contents, gsize *length)
+{
+    (void)length;
+    contents[0] = 'X';
+}
+
+/* keep the header, but fill the entries and pictures after it with junk
+   offsets and sizes */
+static void fill_with_junk(gchar *contents, gsize *length)
+{
+    memset(contents + 48, 0xff, *length - 48);
+}
+
+static void corrupt_files() {
+    TEST_START();
+
+    set_up();
+    expect_rejected(truncate_file);
+    tear_down();
+
+    set_up();
+    expect_rejected(change_magic);
+    tear_down();
+
+    set_up();
+    expect_rejected(fill_with_junk);
+    tear_down();
+
+    /* not there at all */
+    EXPECT_BOOL_EQ(TRUE, RrDiskCacheOpen("/nonexistent/test.cache") == NULL);
+
+    TEST_END();
+}
+
+void run_diskcache_unittest() {
+    unittest_start_suite("diskcache");
+
+    round_trip();
+    corrupt_files();
+
+    unittest_end_suite();
+}
@@ -332,7 +332,9 @@ static void gradient_solid(RrAppearance *l, gint w, gint h)
     for (i = 0; i < w * h; i++)
         *data++ = pix;
 
-    if (sp->interlaced)
+    /* the pixels are being rendered again without a pixmap, for a
+       ParentRelative child */
+    if (sp->interlaced || l->pixmap == None)
         return;
 
     XFillRectangle(RrDisplay(l->inst), l->pixmap, RrColorGC(sp->primary),
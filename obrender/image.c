@@ -21,6 +21,8 @@
 #include "image.h"
 #include "color.h"
 #include "imagecache.h"
+#include "diskcache.h"
+#include "obt/icontheme.h"
 #ifdef USE_IMLIB2
 #include <Imlib2.h>
 #endif
@@ -31,9 +33,18 @@
 
 #include <glib.h>
 
+#ifdef HAVE_SYS_STAT_H
+#  include <sys/stat.h>
+#endif
+#ifdef HAVE_SYS_TYPES_H
+#  include <sys/types.h>
+#endif
+
 #define FRACTION        12
 #define FLOOR(i)        ((i) & (~0UL << FRACTION))
 #define AVERAGE(a, b)   (((((a) ^ (b)) & 0xfefefefeL) >> 1) + ((a) & (b)))
+/*! The size that the "original" pictures in an RrImageSet are sorted by */
+#define PIC_SIZE(p)     MAX((p)->width, (p)->height)
 
 /************************************************************************
  RrImagePic functions.
@@ -55,14 +66,11 @@
 */
 static void RrImagePicInit(RrImagePic *pic, gint w, gint h, RrPixel32 *data)
 {
-    gint i;
-
     pic->width = w;
     pic->height = h;
     pic->data = data;
-    pic->sum = 0;
-    for (i = w*h; i > 0; --i)
-        pic->sum += *(data++);
+    pic->hash = 0;
+    pic->hashed = FALSE;
 }
 
 /*! Create a new RrImagePic from some picture data.
@@ -107,6 +115,37 @@ static void RrImagePicFree(RrImagePic *pic)
 **************************************************************************/
 
 
+/*! Throw away an RrImageSet's mipmap levels, when its largest original
+  changes. */
+static void RrImageSetFreeMipmap(RrImageSet *self)
+{
+    gint i;
+
+    for (i = 0; i < self->n_mipmap; ++i)
+        RrImagePicFree(self->mipmap[i]);
+    g_free(self->mipmap);
+    self->mipmap = NULL;
+    self->n_mipmap = 0;
+}
+
+/*! Find the first picture in a list sorted by PIC_SIZE with a PIC_SIZE of at
+  least size.  Returns n if there is none. */
+static gint RrImagePicFindSize(RrImagePic **list, gint n, gint size)
+{
+    gint l, r, m;
+
+    l = 0;
+    r = n;
+    while (l < r) {
+        m = l + (r - l) / 2;
+        if (PIC_SIZE(list[m]) < size)
+            l = m + 1;
+        else
+            r = m;
+    }
+    return l;
+}
+
 /*! Free an RrImageSet and the stuff inside it.
   This should only occur when there are no more RrImages pointing to the set.
 */
@@ -138,6 +177,12 @@ static void RrImageSetFree(RrImageSet *self)
             RrImagePicFree(self->resized[i]);
         }
         g_free(self->resized);
+        RrImageSetFreeMipmap(self);
+
+#if defined(USE_LIBRSVG)
+        if (self->svg)
+            g_object_unref(self->svg);
+#endif
 
         g_slice_free(RrImageSet, self);
     }
@@ -168,6 +213,9 @@ static void RrImageSetRemovePictureAt(RrImageSet *self, gint i,
 
     g_assert(i >= 0 && i < *len);
 
+    if (original)
+        RrImageSetFreeMipmap(self);
+
     /* remove the picture data as a key in the cache */
     g_hash_table_remove(self->cache->pic_table, (*list)[i]);
 
@@ -184,13 +232,13 @@ static void RrImageSetRemovePictureAt(RrImageSet *self, gint i,
 
 /*! Add an RrImagePic to an RrImageSet.
   The RrImagePic should _not_ exist in the image cache already.
-  Pictures are added to the front of the list, to maintain the ordering of
-  newest to oldest.
+  Resized pictures are added to the front of the list, to maintain the
+  ordering of newest to oldest.  Originals are kept sorted by size.
 */
 static void RrImageSetAddPicture(RrImageSet *self, RrImagePic *pic,
                                  gboolean original)
 {
-    gint i;
+    gint i, pos;
     RrImagePic ***list;
     gint *len;
 
@@ -210,21 +258,27 @@ static void RrImageSetAddPicture(RrImageSet *self, RrImagePic *pic,
 
         list = &self->original;
         len = &self->n_original;
+        pos = RrImagePicFindSize(*list, *len, PIC_SIZE(pic));
+
+        /* the mipmap is made from the largest original */
+        if (pos == *len)
+            RrImageSetFreeMipmap(self);
     }
     else {
         list = &self->resized;
         len = &self->n_resized;
+        pos = 0;
     }
 
-    /* grow the list by one spot, shift everything down one, and insert the new
-       picture at the front of the list */
+    /* grow the list by one spot, shift everything after pos down one, and
+       insert the new picture at pos */
     *list = g_renew(RrImagePic*, *list, ++*len);
-    for (i = *len-1; i > 0; --i)
+    for (i = *len-1; i > pos; --i)
         (*list)[i] = (*list)[i-1];
-    (*list)[0] = pic;
+    (*list)[pos] = pic;
 
     /* add the picture as a key to point to this image in the cache */
-    g_hash_table_insert(self->cache->pic_table, (*list)[0], self);
+    g_hash_table_insert(self->cache->pic_table, (*list)[pos], self);
 
 /*
 #ifdef DEBUG
@@ -252,14 +306,17 @@ RrImageSet* RrImageSetMergeSets(RrImageSet *b, RrImageSet *a)
         return a;
     if (a == b)
         return b;
-    /* the original and resized picture lists in an RrImageSet are kept ordered
-       as newest to oldest.  we don't have timestamps for them, so we cannot
-       preserve this in the merged RrImageSet exactly.  a decent approximation,
-       i think, is to add them in alternating order (one from a, one from b,
-       repeat).  this way, the newest from each will be near the front at
-       least, and in the resized list, when we drop an old picture, we will
-       not always only drop from a or b only, but from each of them equally (or
-       from whichever has more resized pictures.
+    /* the original picture lists are sorted by size, so they are merged in
+       order of size.
+
+       the resized picture lists in an RrImageSet are kept ordered as newest
+       to oldest.  we don't have timestamps for them, so we cannot preserve
+       this in the merged RrImageSet exactly.  a decent approximation, i think,
+       is to add them in alternating order (one from a, one from b, repeat).
+       this way, the newest from each will be near the front at least, and
+       when we drop an old picture, we will not always only drop from a or b
+       only, but from each of them equally (or from whichever has more resized
+       pictures.
     */
 
     g_assert(b->cache == a->cache);
@@ -270,12 +327,18 @@ RrImageSet* RrImageSetMergeSets(RrImageSet *b, RrImageSet *a)
     n_original = a->n_original + b->n_original;
     original = g_new(RrImagePic*, n_original);
     while (merged_i < n_original) {
-        if (a_i < a->n_original)
+        if (b_i >= b->n_original ||
+            (a_i < a->n_original &&
+             PIC_SIZE(a->original[a_i]) <= PIC_SIZE(b->original[b_i])))
             original[merged_i++] = a->original[a_i++];
-        if (b_i < b->n_original)
+        else
             original[merged_i++] = b->original[b_i++];
     }
 
+    /* the largest original may have changed */
+    RrImageSetFreeMipmap(a);
+    RrImageSetFreeMipmap(b);
+
     a_i = b_i = merged_i = 0;
     n_resized = MIN(max_resized, a->n_resized + b->n_resized);
     resized = g_new(RrImagePic*, n_resized);
@@ -334,6 +397,12 @@ RrImageSet* RrImageSetMergeSets(RrImageSet *b, RrImageSet *a)
     for (it = b->images; it; it = g_slist_next(it))
         ((RrImage*)it->data)->set = a;
 
+    /* both sets hold the same image, so either SVG will do */
+    if (!a->svg) {
+        a->svg = b->svg;
+        b->svg = NULL;
+    }
+
     a->images = g_slist_concat(a->images, b->images);
     b->images = NULL;
     a->names = g_slist_concat(a->names, b->names);
@@ -412,6 +481,19 @@ void RrImageSetDestroyFunc(RrImage *self, RrImageDestroyFunc func,
     self->destroy_data = data;
 }
 
+/*! Create a new RrImage, with a new RrImageSet that has no pictures in it. */
+static RrImage* RrImageNewEmpty(RrImageCache *cache)
+{
+    RrImage *self;
+
+    self = g_slice_new0(RrImage);
+    self->ref = 1;
+    self->set = g_slice_new0(RrImageSet);
+    self->set->cache = cache;
+    self->set->images = g_slist_append(self->set->images, self);
+    return self;
+}
+
 void RrImageAddFromData(RrImage *self, RrPixel32 *data, gint w, gint h)
 {
     RrImagePic pic, *ppic;
@@ -456,11 +538,7 @@ RrImage* RrImageNewFromData(RrImageCache *cache, RrPixel32 *data,
        a new RrImageSet, and a new RrImage that points to it, and place the
        new image inside the new RrImageSet */
 
-    self = g_slice_new0(RrImage);
-    self->ref = 1;
-    self->set = g_slice_new0(RrImageSet);
-    self->set->cache = cache;
-    self->set->images = g_slist_append(self->set->images, self);
+    self = RrImageNewEmpty(cache);
 
     ppic = RrImagePicNew(w, h, data);
     RrImageSetAddPicture(self->set, ppic, TRUE);
@@ -515,7 +593,6 @@ typedef struct _RsvgLoader RsvgLoader;
 struct _RsvgLoader
 {
     RsvgHandle *handle;
-    cairo_surface_t *surface;
     RrPixel32 *pixel_data;
 };
 
@@ -526,48 +603,38 @@ void DestroyRsvgLoader(RsvgLoader *loader)
 
     if (loader->pixel_data)
         g_free(loader->pixel_data);
-    if (loader->surface)
-        cairo_surface_destroy(loader->surface);
     if (loader->handle)
         g_object_unref(loader->handle);
     g_slice_free(RsvgLoader, loader);
 }
 
-RsvgLoader* LoadWithRsvg(gchar *path,
-                         RrPixel32 **pixel_data,
-                         gint *width,
-                         gint *height)
+/*! Draw an SVG into a newly allocated picture of the given size. */
+static RrPixel32* RenderWithRsvg(RsvgHandle *handle, gint width, gint height)
 {
-    RsvgLoader *loader = g_slice_new0(RsvgLoader);
-
-    if (!(loader->handle = rsvg_handle_new_from_file(path, NULL))) {
-        DestroyRsvgLoader(loader);
-        return NULL;
-    }
-
-    if (!rsvg_handle_close(loader->handle, NULL)) {
-        DestroyRsvgLoader(loader);
-        return NULL;
-    }
-
     RsvgDimensionData dimension_data;
-    rsvg_handle_get_dimensions(loader->handle, &dimension_data);
-    *width = dimension_data.width;
-    *height = dimension_data.height;
-
-    loader->surface = cairo_image_surface_create(
-        CAIRO_FORMAT_ARGB32, *width, *height);
-
-    cairo_t* context = cairo_create(loader->surface);
-    gboolean success = rsvg_handle_render_cairo(loader->handle, context);
+    cairo_surface_t *surface;
+    cairo_t *context;
+    RrPixel32 *pixel_data, *out_row;
+    guint32 *in_row;
+    gint in_stride, x, y;
+    gboolean success;
+
+    surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+
+    rsvg_handle_get_dimensions(handle, &dimension_data);
+    context = cairo_create(surface);
+    cairo_scale(context,
+                (gdouble)width / dimension_data.width,
+                (gdouble)height / dimension_data.height);
+    success = rsvg_handle_render_cairo(handle, context);
     cairo_destroy(context);
 
     if (!success) {
-        DestroyRsvgLoader(loader);
+        cairo_surface_destroy(surface);
         return NULL;
     }
 
-    loader->pixel_data = g_new(guint32, *width * *height);
+    pixel_data = g_new(RrPixel32, width * height);
 
     /*
       Cairo has its data in ARGB with premultiplied alpha, but RrPixel32
@@ -581,16 +648,14 @@ RsvgLoader* LoadWithRsvg(gchar *path,
     g_assert(RrDefaultGreenOffset == 8);
     g_assert(RrDefaultBlueOffset == 0);
 
-    guint32 *out_row = loader->pixel_data;
+    out_row = pixel_data;
 
-    guint32 *in_row =
-        (guint32*)cairo_image_surface_get_data(loader->surface);
-    gint in_stride = cairo_image_surface_get_stride(loader->surface);
+    cairo_surface_flush(surface);
+    in_row = (guint32*)cairo_image_surface_get_data(surface);
+    in_stride = cairo_image_surface_get_stride(surface);
 
-    gint y;
-    for (y = 0; y < *height; ++y) {
-        gint x;
-        for (x = 0; x < *width; ++x) {
+    for (y = 0; y < height; ++y) {
+        for (x = 0; x < width; ++x) {
             guchar a = in_row[x] >> 24;
             guchar r = (in_row[x] >> 16) & 0xff;
             guchar g = (in_row[x] >> 8) & 0xff;
@@ -602,7 +667,60 @@ RsvgLoader* LoadWithRsvg(gchar *path,
                 (a << RrDefaultAlphaOffset);
         }
         in_row += in_stride / 4;
-        out_row += *width;
+        out_row += width;
+    }
+
+    cairo_surface_destroy(surface);
+    return pixel_data;
+}
+
+/*! Load an SVG file.  The picture is drawn at the SVG's own size, or if that
+  is larger than max_size (and max_size is not 0), then it is drawn to fit
+  within max_size instead.
+*/
+RsvgLoader* LoadWithRsvg(gchar *path,
+                         gint max_size,
+                         RrPixel32 **pixel_data,
+                         gint *width,
+                         gint *height)
+{
+    RsvgLoader *loader = g_slice_new0(RsvgLoader);
+    RsvgDimensionData dimension_data;
+
+    if (!(loader->handle = rsvg_handle_new_from_file(path, NULL))) {
+        DestroyRsvgLoader(loader);
+        return NULL;
+    }
+
+    if (!rsvg_handle_close(loader->handle, NULL)) {
+        DestroyRsvgLoader(loader);
+        return NULL;
+    }
+
+    rsvg_handle_get_dimensions(loader->handle, &dimension_data);
+    if (dimension_data.width <= 0 || dimension_data.height <= 0) {
+        DestroyRsvgLoader(loader);
+        return NULL;
+    }
+    *width = dimension_data.width;
+    *height = dimension_data.height;
+
+    /* keep the aspect ratio */
+    if (max_size > 0 && (*width > max_size || *height > max_size)) {
+        if (*width >= *height) {
+            *height = MAX(1, *height * max_size / *width);
+            *width = max_size;
+        }
+        else {
+            *width = MAX(1, *width * max_size / *height);
+            *height = max_size;
+        }
+    }
+
+    loader->pixel_data = RenderWithRsvg(loader->handle, *width, *height);
+    if (!loader->pixel_data) {
+        DestroyRsvgLoader(loader);
+        return NULL;
     }
 
     *pixel_data = loader->pixel_data;
@@ -611,13 +729,47 @@ RsvgLoader* LoadWithRsvg(gchar *path,
 }
 #endif  /* USE_LIBRSVG */
 
-RrImage* RrImageNewFromName(RrImageCache *cache, const gchar *name)
+/*! An image file being loaded by the image cache's load_pool */
+typedef struct _RrImageLoad RrImageLoad;
+
+struct _RrImageLoad
 {
-    RrImage *self;
-    RrImageSet *set;
-    gint w, h;
-    RrPixel32 *data;
+    /*! The name that the image was requested with */
+    gchar *name;
+    /*! The file to load the image from */
     gchar *path;
+    /*! The largest size to draw an SVG file at when loading it */
+    gint size;
+    /*! The decoded picture, or NULL if it could not be loaded */
+    RrPixel32 *data;
+    gint w, h;
+    /*! The RsvgHandle if the file was an SVG, which is kept to draw it at
+      other sizes later */
+    gpointer svg;
+    /*! The modification time of the file */
+    gint64 mtime;
+    /*! The pictures found for the file in the image cache's disk cache, in
+      which case the file is not decoded */
+    RrDiskCachePic *cached;
+    gint n_cached;
+};
+
+/* Imlib2 keeps its state in a global context, so only one thread can use it
+   at a time */
+#if defined(USE_IMLIB2)
+G_LOCK_DEFINE_STATIC(imlib);
+#endif
+
+/*! Decode an image file into a newly allocated picture.
+  This is run in the image cache's load_pool, so it can't touch the cache.
+  @param size SVG files are drawn no larger than this, if it is not 0.
+  @param svg If the file is an SVG, this is set to its RsvgHandle, otherwise
+    it is set to NULL.
+*/
+static RrPixel32* LoadFile(const gchar *path, gint size, gint *w, gint *h,
+                           gpointer *svg)
+{
+    RrPixel32 *data, *ret;
     gboolean loaded;
 
 #if defined(USE_IMLIB2)
@@ -627,66 +779,246 @@ RrImage* RrImageNewFromName(RrImageCache *cache, const gchar *name)
     RsvgLoader *rsvg_loader = NULL;
 #endif
 
-    g_return_val_if_fail(cache != NULL, NULL);
-    g_return_val_if_fail(name != NULL, NULL);
-
-    set = g_hash_table_lookup(cache->name_table, name);
-    if (set) {
-        self = set->images->data;
-        RrImageRef(self);
-        return self;
-    }
-
-    /* XXX find the path via freedesktop icon spec (use obt) ! */
-    path = g_strdup(name);
-
     loaded = FALSE;
+    ret = NULL;
+    *svg = NULL;
 #if defined(USE_LIBRSVG)
     if (!loaded) {
-        rsvg_loader = LoadWithRsvg(path, &data, &w, &h);
+        rsvg_loader = LoadWithRsvg((gchar*)path, size, &data, w, h);
         loaded = !!rsvg_loader;
+        if (loaded) {
+            /* take the picture and the handle from the loader */
+            ret = data;
+            rsvg_loader->pixel_data = NULL;
+            *svg = rsvg_loader->handle;
+            rsvg_loader->handle = NULL;
+        }
+        DestroyRsvgLoader(rsvg_loader);
     }
+#else
+    (void)size;
 #endif
 #if defined(USE_IMLIB2)
     if (!loaded) {
-        imlib_loader = LoadWithImlib(path, &data, &w, &h);
+        G_LOCK(imlib);
+        imlib_loader = LoadWithImlib((gchar*)path, &data, w, h);
         loaded = !!imlib_loader;
+        if (loaded)
+            ret = g_memdup(data, *w * *h * sizeof(RrPixel32));
+        DestroyImlibLoader(imlib_loader);
+        G_UNLOCK(imlib);
     }
 #endif
 
-    if (!loaded) {
-        g_message("Cannot load image \"%s\" from file \"%s\"", name, path);
-        g_free(path);
+    return ret;
+}
+
+/*! Open an SVG file, without drawing it, so that it can be drawn at other
+  sizes later.  Returns NULL if the file is not an SVG. */
+static gpointer OpenSvg(const gchar *path)
+{
 #if defined(USE_LIBRSVG)
-        DestroyRsvgLoader(rsvg_loader);
-#endif
-#if defined(USE_IMLIB2)
-        DestroyImlibLoader(imlib_loader);
+    if (g_str_has_suffix(path, ".svg"))
+        return rsvg_handle_new_from_file(path, NULL);
+#else
+    (void)path;
 #endif
-        return NULL;
+    return NULL;
+}
+
+void RrImageLoadThread(gpointer data, gpointer user_data)
+{
+    RrImageLoad *load = data;
+    RrImageCache *cache = user_data;
+
+    /* the cache is being destroyed, don't bother */
+    if (!g_atomic_int_get(&cache->load_cancelled)) {
+        /* use the pictures saved in the disk cache if the file hasn't
+           changed since they were saved */
+        if (cache->disk && load->mtime)
+            load->n_cached = RrDiskCacheLookup(cache->disk, load->path,
+                                               load->mtime, load->size,
+                                               &load->cached);
+
+        if (load->n_cached) {
+            load->w = load->cached[0].width;
+            load->h = load->cached[0].height;
+            /* the saved pictures don't replace drawing an SVG at the size
+               it is shown at */
+            load->svg = OpenSvg(load->path);
+        }
+        else {
+            load->data = LoadFile(load->path, load->size,
+                                  &load->w, &load->h, &load->svg);
+            if (!load->data)
+                g_message("Cannot load image \"%s\" from file \"%s\"",
+                          load->name, load->path);
+        }
     }
 
-    g_free(path);
+    /* hand it back to the main thread */
+    g_async_queue_push(cache->loaded, load);
+    g_idle_add(RrImageLoadedIdle, cache);
+}
 
-    /* get an RrImage that contains an RrImageSet with this picture in it.
-       the RrImage might be new, or reused if the picture was already in the
-       cache.
+/*! Add a resized picture from the disk cache to an RrImageSet, unless the
+  set has as many resized pictures as it can keep, or the picture is in the
+  image cache already. */
+static void RrImageSetAddCachedResize(RrImageSet *self,
+                                      const RrDiskCachePic *cached)
+{
+    RrImagePic pic;
 
-       either way, we get back an RrImageSet (via the RrImage), and we must add
-       the name to that RrImageSet.  because of the check above, we know that
-       there is no RrImageSet in the cache which already has the given name
-       asosciated with it.
-    */
+    if (self->n_resized >= self->cache->max_resized_saved)
+        return;
 
-    self = RrImageNewFromData(cache, data, w, h);
-    RrImageSetAddName(self->set, name);
+    RrImagePicInit(&pic, cached->width, cached->height,
+                   (RrPixel32*)cached->data);
+    if (!g_hash_table_lookup(self->cache->pic_table, &pic))
+        RrImageSetAddPicture(self,
+                             RrImagePicNew(cached->width, cached->height,
+                                           (RrPixel32*)cached->data),
+                             FALSE);
+}
+
+gboolean RrImageLoadedIdle(gpointer data)
+{
+    RrImageCache *cache = data;
+    RrImageLoad *load;
+    RrImageSet *set;
+    RrImage *self;
+    RrImageCacheFile *f;
+    gint i;
+
+    while ((load = g_async_queue_try_pop(cache->loaded))) {
+        /* if every RrImage for the name was destroyed while it was loading,
+           then the name is gone from the cache, and the picture is not
+           wanted any more.  if the set already has a picture, then the
+           name was requested again and loaded more than once. */
+        set = g_hash_table_lookup(cache->name_table, load->name);
+        if (set && load->n_cached && set->n_original == 0) {
+            self = set->images->data;
+            RrImageAddFromData(self, (RrPixel32*)load->cached[0].data,
+                               load->w, load->h);
+
+            /* AddPicture puts each one at the front, so go backwards to
+               keep them in the order they were last used */
+            for (i = load->n_cached - 1; i > 0; --i)
+                RrImageSetAddCachedResize(self->set, &load->cached[i]);
+
+            if (load->svg && !self->set->svg) {
+                self->set->svg = load->svg;
+                load->svg = NULL;
+            }
+        }
+        else if (set && load->data && set->n_original == 0) {
+            /* this may merge the set with another that holds the same
+               picture already */
+            self = set->images->data;
+            RrImageAddFromData(self, load->data, load->w, load->h);
+
+            /* keep the SVG to draw other sizes from */
+            if (load->svg && !self->set->svg) {
+                self->set->svg = load->svg;
+                load->svg = NULL;
+            }
 
+            /* the picture isn't in the disk cache yet */
+            cache->disk_dirty = TRUE;
+        }
+        else
+            self = NULL;
+
+        if (self) {
+            /* remember where the picture came from, to save it in the disk
+               cache */
+            if (cache->disk_file && load->mtime) {
+                f = g_slice_new(RrImageCacheFile);
+                f->path = g_strdup(load->path);
+                f->mtime = load->mtime;
+                f->size = load->size;
+                f->width = load->w;
+                f->height = load->h;
+                g_hash_table_replace(cache->disk_files,
+                                     g_strdup(load->name), f);
+            }
+
+            if (cache->loaded_func)
+                cache->loaded_func(self, cache->loaded_data);
+        }
+        RrImageLoadFree(load);
+    }
+    return FALSE; /* don't repeat */
+}
+
+void RrImageLoadFree(gpointer data)
+{
+    RrImageLoad *load = data;
+
+    g_free(load->name);
+    g_free(load->path);
+    g_free(load->data);
+    g_free(load->cached);
 #if defined(USE_LIBRSVG)
-    DestroyRsvgLoader(rsvg_loader);
-#endif
-#if defined(USE_IMLIB2)
-    DestroyImlibLoader(imlib_loader);
+    if (load->svg)
+        g_object_unref(load->svg);
 #endif
+    g_slice_free(RrImageLoad, load);
+}
+
+RrImage* RrImageNewFromName(RrImageCache *cache, const gchar *name)
+{
+    RrImage *self;
+    RrImageSet *set;
+    RrImageLoad *load;
+    gchar *path;
+    struct stat buf;
+
+    g_return_val_if_fail(cache != NULL, NULL);
+    g_return_val_if_fail(name != NULL, NULL);
+
+    /* this finds images that are still being loaded too, so each file is
+       only loaded once */
+    set = g_hash_table_lookup(cache->name_table, name);
+    if (set) {
+        self = set->images->data;
+        RrImageRef(self);
+        return self;
+    }
+
+    /* icon names are looked up in the icon theme's index, which is quick,
+       and anything else is used as a path */
+    path = NULL;
+    if (!g_path_is_absolute(name) && cache->icon_theme)
+        path = obt_icon_theme_lookup(cache->icon_theme, name,
+                                     cache->icon_size);
+    if (!path)
+        path = g_strdup(name);
+
+    /* only decoding the file is put off, so there is no image if the file
+       is not there at all */
+    if (stat(path, &buf) != 0) {
+        g_message("Cannot load image \"%s\" from file \"%s\"", name, path);
+        g_free(path);
+        return NULL;
+    }
+
+    /* make an empty RrImage with the name attached to it, and load the file
+       into it in the background.  the name won't be in any other RrImageSet
+       because of the check above.
+
+       once the picture is loaded, if it is the same as one already in the
+       cache, the two RrImageSets will be merged then.
+    */
+    self = RrImageNewEmpty(cache);
+    RrImageSetAddName(self->set, name);
+
+    load = g_slice_new0(RrImageLoad);
+    load->name = g_strdup(name);
+    load->path = path;
+    load->mtime = buf.st_mtime;
+    load->size = cache->icon_size;
+    g_thread_pool_push(cache->load_pool, load, NULL);
 
     return self;
 }
@@ -809,6 +1141,133 @@ static RrImagePic* ResizeImage(RrPixel32 *src,
     return pic;
 }
 
+RrPixel32* RrImageScaleData(RrPixel32 *data, gint w, gint h,
+                            gint *dst_w, gint *dst_h)
+{
+    RrImagePic *pic;
+    RrPixel32 *ret;
+
+    g_return_val_if_fail(data != NULL, NULL);
+    g_return_val_if_fail(w > 0 && h > 0, NULL);
+    g_return_val_if_fail(*dst_w > 0 && *dst_h > 0, NULL);
+
+    pic = ResizeImage(data, w, h, *dst_w, *dst_h);
+    if (!pic)
+        return NULL;
+
+    /* hand the pixels to the caller and throw away the RrImagePic wrapper */
+    *dst_w = pic->width;
+    *dst_h = pic->height;
+    ret = pic->data;
+    g_slice_free(RrImagePic, pic);
+    return ret;
+}
+
+/*! Make a picture half the size of the given one, by averaging each 2x2
+  block of pixels.  A side which is only one pixel long stays that way. */
+static RrImagePic* HalveImage(RrImagePic *src)
+{
+    RrImagePic *pic;
+    RrPixel32 *dst, *dststart;
+    const RrPixel32 *row1, *row2;
+    gint x, y, x1, x2, dstW, dstH;
+
+    dstW = MAX(src->width / 2, 1);
+    dstH = MAX(src->height / 2, 1);
+    dststart = dst = g_new(RrPixel32, dstW * dstH);
+
+    for (y = 0; y < dstH; ++y) {
+        row1 = src->data + MIN(y * 2, src->height - 1) * src->width;
+        row2 = src->data + MIN(y * 2 + 1, src->height - 1) * src->width;
+        for (x = 0; x < dstW; ++x) {
+            x1 = MIN(x * 2, src->width - 1);
+            x2 = MIN(x * 2 + 1, src->width - 1);
+            *dst++ = AVERAGE(AVERAGE(row1[x1], row1[x2]),
+                             AVERAGE(row2[x1], row2[x2]));
+        }
+    }
+
+    pic = g_slice_new(RrImagePic);
+    RrImagePicInit(pic, dstW, dstH, dststart);
+
+    return pic;
+}
+
+/*! Find the smallest picture in the RrImageSet's mipmap which is at least as
+  large as the largest original would be when resized to fit in w x h.  The
+  levels of the mipmap are made as they are needed.
+  @return The largest original if no mipmap level is small enough.  The
+    returned picture belongs to the RrImageSet.
+*/
+static RrImagePic* RrImageSetMipmap(RrImageSet *self, gint w, gint h)
+{
+    RrImagePic *big, *pic;
+    gint need_w, need_h, i;
+
+    g_assert(self->n_original > 0);
+
+    big = self->original[self->n_original-1];
+
+    /* the size the picture would be resized to, keeping its aspect ratio */
+    need_w = w;
+    need_h = (gint)(w * ((gdouble)big->height / big->width));
+    if (need_h > h) {
+        need_h = h;
+        need_w = (gint)(h * ((gdouble)big->width / big->height));
+    }
+
+    pic = big;
+    for (i = 0; ; ++i) {
+        /* would the next level be too small? */
+        if (pic->width / 2 < need_w || pic->height / 2 < need_h ||
+            pic->width < 2 || pic->height < 2)
+            break;
+
+        if (i == self->n_mipmap) {
+            self->mipmap = g_renew(RrImagePic*, self->mipmap,
+                                   ++self->n_mipmap);
+            self->mipmap[i] = HalveImage(pic);
+        }
+        pic = self->mipmap[i];
+    }
+    return pic;
+}
+
+#if defined(USE_LIBRSVG)
+/*! Draw an SVG into a newly allocated RrImagePic which fits in the requested
+  size (but keeps its aspect ratio), as ResizeImage does.
+  @return Returns NULL if the SVG could not be drawn.
+*/
+static RrImagePic* RenderImageSvg(RsvgHandle *handle, gint w, gint h)
+{
+    RsvgDimensionData dimension_data;
+    RrPixel32 *data;
+    RrImagePic *pic;
+    gint aspect_w, aspect_h;
+
+    rsvg_handle_get_dimensions(handle, &dimension_data);
+
+    /* keep the aspect ratio */
+    aspect_w = w;
+    aspect_h = (gint)(w * ((gdouble)dimension_data.height /
+                           dimension_data.width));
+    if (aspect_h > h) {
+        aspect_h = h;
+        aspect_w = (gint)(h * ((gdouble)dimension_data.width /
+                               dimension_data.height));
+    }
+    w = aspect_w ? aspect_w : 1;
+    h = aspect_h ? aspect_h : 1;
+
+    if (!(data = RenderWithRsvg(handle, w, h)))
+        return NULL;
+
+    pic = g_slice_new(RrImagePic);
+    RrImagePicInit(pic, w, h, data);
+    return pic;
+}
+#endif
+
 /*! This draws an RGBA picture into the target, within the rectangle specified
   by the area parameter.  If the area's size differs from the source's then it
   will be centered within the rectangle */
@@ -896,37 +1355,45 @@ void RrImageDrawRGBA(RrPixel32 *target, RrTextureRGBA *rgba,
                  rgba->alpha, area);
 }
 
-/*! Draw an RrImage texture into a target pixel buffer.  If the RrImage does
-  not contain a picture of the appropriate size, then one of its "original"
-  pictures will be resized and used (and stored in the RrImage as a "resized"
-  picture).
- */
-void RrImageDrawImage(RrPixel32 *target, RrTextureImage *img,
-                      gint target_w, gint target_h,
-                      RrRect *area)
+/* RrImageDrawImage can be called from the threads rendering an
+   RrPaintBatch.  They look for pictures in the image cache and scale and
+   draw them while holding this for reading, so that nothing is freed under
+   them, and only hold it for writing to change the image cache. */
+static GRWLock draw_image_lock;
+/* An RrImageSet's mipmap is made as it is needed, while draw_image_lock is
+   held for reading */
+G_LOCK_DEFINE_STATIC(mipmap);
+#if defined(USE_LIBRSVG)
+/* and an RsvgHandle can only draw in one thread at a time */
+G_LOCK_DEFINE_STATIC(svg);
+#endif
+
+/*! Find a picture in the RrImageSet of the size of the area, without
+  resizing one.
+  @param resized_i Set to the index of the picture in the resized list, or
+    -1 if it is an original.
+*/
+static RrImagePic* RrImageSetFindPicture(RrImageSet *set, RrRect *area,
+                                         gint *resized_i)
 {
-    gint i, min_diff, min_i, min_aspect_diff, min_aspect_i;
-    RrImage *self;
-    RrImageSet *set;
-    RrImagePic *pic;
-    gboolean free_pic;
+    gint i;
 
-    self = img->image;
-    set = self->set;
-    pic = NULL;
-    free_pic = FALSE;
+    *resized_i = -1;
 
     /* is there an original of this size? (only the larger of
-       w or h has to be right cuz we maintain aspect ratios) */
-    for (i = 0; i < set->n_original; ++i)
-        if ((set->original[i]->width >= set->original[i]->height &&
-             set->original[i]->width == area->width) ||
-            (set->original[i]->width <= set->original[i]->height &&
-             set->original[i]->height == area->height))
-        {
-            pic = set->original[i];
-            break;
-        }
+       w or h has to be right cuz we maintain aspect ratios)
+       the originals are sorted by the larger of their w and h, so only the
+       ones with that equal to the area's w or h need to be checked */
+    for (i = RrImagePicFindSize(set->original, set->n_original, area->width);
+         i < set->n_original && PIC_SIZE(set->original[i]) == area->width;
+         ++i)
+        if (set->original[i]->width >= set->original[i]->height)
+            return set->original[i];
+    for (i = RrImagePicFindSize(set->original, set->n_original, area->height);
+         i < set->n_original && PIC_SIZE(set->original[i]) == area->height;
+         ++i)
+        if (set->original[i]->width <= set->original[i]->height)
+            return set->original[i];
 
     /* is there a resize of this size? */
     for (i = 0; i < set->n_resized; ++i)
@@ -935,103 +1402,215 @@ void RrImageDrawImage(RrPixel32 *target, RrTextureImage *img,
             (set->resized[i]->width <= set->resized[i]->height &&
              set->resized[i]->height == area->height))
         {
-            gint j;
-            RrImagePic *saved;
+            *resized_i = i;
+            return set->resized[i];
+        }
+    return NULL;
+}
 
-            /* save the selected one */
-            saved = set->resized[i];
+/*! Move a resized picture to the top of the RrImageSet's resized list, if
+  it is still in it, as the most recently used one. */
+static void RrImageSetUseResized(RrImageSet *set, RrImagePic *pic)
+{
+    gint i, j;
 
+    for (i = 0; i < set->n_resized; ++i)
+        if (set->resized[i] == pic) {
             /* shift all the others down */
             for (j = i; j > 0; --j)
                 set->resized[j] = set->resized[j-1];
 
             /* and move the selected one to the top of the list */
-            set->resized[0] = saved;
-
-            pic = set->resized[0];
+            set->resized[0] = pic;
             break;
         }
+}
 
-    if (!pic) {
-        gdouble aspect;
-        RrImageSet *cache_set;
-
-        /* find an original with a close size */
-        min_diff = min_aspect_diff = -1;
-        min_i = min_aspect_i = 0;
-        aspect = ((gdouble)area->width) / area->height;
-        for (i = 0; i < set->n_original; ++i) {
-            gint diff;
-            gint wdiff, hdiff;
-            gdouble myasp;
-
-            /* our size difference metric.. */
-            wdiff = set->original[i]->width - area->width;
-            if (wdiff < 0) wdiff *= 2; /* prefer scaling down than up */
-            hdiff = set->original[i]->height - area->height;
-            if (hdiff < 0) hdiff *= 2; /* prefer scaling down than up */
-            diff = (wdiff * wdiff) + (hdiff * hdiff);
-
-            /* find the smallest difference */
-            if (min_diff < 0 || diff < min_diff) {
-                min_diff = diff;
-                min_i = i;
-            }
-            /* and also find the smallest difference with the same aspect
-               ratio (and prefer this one) */
-            myasp = ((gdouble)set->original[i]->width) /
-                set->original[i]->height;
-            if (ABS(aspect - myasp) < 0.0000001 &&
-                (min_aspect_diff < 0 || diff < min_aspect_diff))
-            {
-                min_aspect_diff = diff;
-                min_aspect_i = i;
-            }
+/*! Resize one of the RrImageSet's pictures to the size of the area, into a
+  new RrImagePic.
+  @return Returns NULL if a picture in the RrImageSet's mipmap is already the
+    right size, and sets src to it.
+*/
+static RrImagePic* RrImageSetResize(RrImageSet *set, RrRect *area,
+                                    RrImagePic **src)
+{
+    gint i, min_diff, min_i, min_aspect_diff, min_aspect_i;
+    gdouble aspect;
+    RrImagePic *pic;
+
+    /* find an original with a close size */
+    min_diff = min_aspect_diff = -1;
+    min_i = min_aspect_i = 0;
+    aspect = ((gdouble)area->width) / area->height;
+    for (i = 0; i < set->n_original; ++i) {
+        gint diff;
+        gint wdiff, hdiff;
+        gdouble myasp;
+
+        /* our size difference metric.. */
+        wdiff = set->original[i]->width - area->width;
+        if (wdiff < 0) wdiff *= 2; /* prefer scaling down than up */
+        hdiff = set->original[i]->height - area->height;
+        if (hdiff < 0) hdiff *= 2; /* prefer scaling down than up */
+        diff = (wdiff * wdiff) + (hdiff * hdiff);
+
+        /* find the smallest difference */
+        if (min_diff < 0 || diff < min_diff) {
+            min_diff = diff;
+            min_i = i;
+        }
+        /* and also find the smallest difference with the same aspect
+           ratio (and prefer this one) */
+        myasp = ((gdouble)set->original[i]->width) /
+            set->original[i]->height;
+        if (ABS(aspect - myasp) < 0.0000001 &&
+            (min_aspect_diff < 0 || diff < min_aspect_diff))
+        {
+            min_aspect_diff = diff;
+            min_aspect_i = i;
         }
+    }
+
+    /* use the aspect ratio correct source if there is one */
+    if (min_aspect_i >= 0)
+        min_i = min_aspect_i;
+
+#if defined(USE_LIBRSVG)
+    /* draw the SVG at the size of the area, which looks better than
+       scaling a picture of it */
+    if (set->svg) {
+        G_LOCK(svg);
+        pic = RenderImageSvg(set->svg, area->width, area->height);
+        G_UNLOCK(svg);
+        if (pic)
+            return pic;
+    }
+#endif
+
+    /* resize the original to the given area.  if the largest original was
+       picked, then start from the smallest level of its mipmap that is
+       still large enough, which is much less work to scale down */
+    if (min_i == set->n_original-1) {
+        G_LOCK(mipmap);
+        *src = RrImageSetMipmap(set, area->width, area->height);
+        G_UNLOCK(mipmap);
+    }
+    else
+        *src = set->original[min_i];
+    return ResizeImage((*src)->data, (*src)->width, (*src)->height,
+                       area->width, area->height);
+}
 
-        /* use the aspect ratio correct source if there is one */
-        if (min_aspect_i >= 0)
-            min_i = min_aspect_i;
-
-        /* resize the original to the given area */
-        pic = ResizeImage(set->original[min_i]->data,
-                          set->original[min_i]->width,
-                          set->original[min_i]->height,
-                          area->width, area->height);
-
-        /* is it already in the cache ? */
-        cache_set = g_hash_table_lookup(set->cache->pic_table, pic);
-        if (cache_set) {
-            /* merge this set with the one found in the cache - they are
-               apparently the same image !  then next time we won't have to do
-               this resizing, we will use the cache_set's pic instead. */
+/*! Add a resized RrImagePic to the image's RrImageSet, or merge the
+  RrImageSet with one that already has it.  This must be called with
+  draw_image_lock held for writing.
+  @return Returns TRUE if the RrImagePic was kept, or FALSE if it needs to be
+    freed.
+*/
+static gboolean RrImageAddResized(RrImage *self, RrImagePic *pic)
+{
+    RrImageSet *set, *cache_set;
+    gboolean kept;
+
+    set = self->set;
+    kept = FALSE;
+
+    /* is it already in the cache ? */
+    cache_set = g_hash_table_lookup(set->cache->pic_table, pic);
+    if (cache_set) {
+        /* merge this set with the one found in the cache - they are
+           apparently the same image !  then next time we won't have to do
+           this resizing, we will use the cache_set's pic instead.  another
+           thread may have just added the same picture to this set */
+        if (cache_set != set)
             set = RrImageSetMergeSets(set, cache_set);
-            free_pic = TRUE;
-        }
-        else {
-            /* add the resized image to the image, as the first in the resized
-               list */
-            while (set->n_resized >= set->cache->max_resized_saved)
-                /* remove the last one (last used one) to make space for
-                 adding our resized picture */
-                RrImageSetRemovePictureAt(set, set->n_resized-1, FALSE);
-            if (set->cache->max_resized_saved)
-                /* add it to the resized list */
-                RrImageSetAddPicture(set, pic, FALSE);
-            else
-                free_pic = TRUE; /* don't leak mem! */
+    }
+    else {
+        /* add the resized image to the image, as the first in the resized
+           list */
+        while (set->n_resized >= set->cache->max_resized_saved)
+            /* remove the last one (last used one) to make space for
+             adding our resized picture */
+            RrImageSetRemovePictureAt(set, set->n_resized-1, FALSE);
+        if (set->cache->max_resized_saved) {
+            /* add it to the resized list */
+            RrImageSetAddPicture(set, pic, FALSE);
+            /* save it in the disk cache, if it came from a file */
+            if (set->names)
+                set->cache->disk_dirty = TRUE;
+            kept = TRUE;
         }
     }
 
     /* The RrImageSet may have changed if we merged it with another, so the
        RrImage object needs to be updated to use the new merged RrImageSet. */
     self->set = set;
+    return kept;
+}
 
-    g_assert(pic != NULL);
+/*! Draw an RrImage texture into a target pixel buffer.  If the RrImage does
+  not contain a picture of the appropriate size, then one of its "original"
+  pictures will be resized and used (and stored in the RrImage as a "resized"
+  picture).
+ */
+void RrImageDrawImage(RrPixel32 *target, RrTextureImage *img,
+                      gint target_w, gint target_h,
+                      RrRect *area)
+{
+    RrImage *self;
+    RrImageSet *set;
+    RrImagePic *pic, *src;
+    gint resized_i;
+
+    self = img->image;
+
+    g_rw_lock_reader_lock(&draw_image_lock);
+    set = self->set;
+
+    /* the image's file hasn't been loaded yet, or could not be loaded */
+    if (set->n_original == 0) {
+        g_rw_lock_reader_unlock(&draw_image_lock);
+        return;
+    }
+
+    pic = RrImageSetFindPicture(set, area, &resized_i);
+    if (pic) {
+        DrawRGBA(target, target_w, target_h,
+                 pic->data, pic->width, pic->height,
+                 img->alpha, area);
+        g_rw_lock_reader_unlock(&draw_image_lock);
+
+        /* it is the most recently used resize now */
+        if (resized_i > 0) {
+            g_rw_lock_writer_lock(&draw_image_lock);
+            RrImageSetUseResized(self->set, pic);
+            g_rw_lock_writer_unlock(&draw_image_lock);
+        }
+        return;
+    }
+
+    pic = RrImageSetResize(set, area, &src);
+    if (!pic) {
+        /* the mipmap level was already the right size, so it can be drawn
+           as it is */
+        DrawRGBA(target, target_w, target_h,
+                 src->data, src->width, src->height,
+                 img->alpha, area);
+        g_rw_lock_reader_unlock(&draw_image_lock);
+        return;
+    }
 
+    /* nothing else can see the new picture yet, so draw it before it is
+       put in the cache, where another thread could throw it away */
     DrawRGBA(target, target_w, target_h,
              pic->data, pic->width, pic->height,
              img->alpha, area);
-    if (free_pic)
-        RrImagePicFree(pic);
+    g_rw_lock_reader_unlock(&draw_image_lock);
+
+    /* another thread may have changed the image's RrImageSet in between,
+       so it is looked at again */
+    g_rw_lock_writer_lock(&draw_image_lock);
+    if (!RrImageAddResized(self, pic))
+        RrImagePicFree(pic); /* don't leak mem! */
+    g_rw_lock_writer_unlock(&draw_image_lock);
 }
@@ -25,6 +25,13 @@
 void RrImageDrawImage(RrPixel32 *target, RrTextureImage *img,
                       gint target_w, gint target_h,
                       RrRect *area);
+/*! Decode an image file in the image cache's load_pool. */
+void RrImageLoadThread(gpointer load, gpointer cache);
+/*! Add decoded image files to their RrImages, in the main thread. */
+gboolean RrImageLoadedIdle(gpointer cache);
+/*! Free a decoded image file which will not be added to an RrImage. */
+void RrImageLoadFree(gpointer load);
+
 void RrImageDrawRGBA(RrPixel32 *target, RrTextureRGBA *rgba,
                      gint target_w, gint target_h,
                      RrRect *area);
@@ -19,6 +19,14 @@
 #include "render.h"
 #include "imagecache.h"
 #include "image.h"
+#include "diskcache.h"
+#include "obt/icontheme.h"
+#include "obt/paths.h"
+
+#include <string.h>
+
+/*! The number of threads used to load image files in the background */
+#define LOAD_THREADS 2
 
 static gboolean RrImagePicEqual(const RrImagePic *p1,
                                 const RrImagePic *p2);
@@ -35,6 +43,20 @@ RrImageCache* RrImageCacheNew(gint max_resized_saved)
     self->pic_table = g_hash_table_new((GHashFunc)RrImagePicHash,
                                        (GEqualFunc)RrImagePicEqual);
     self->name_table = g_hash_table_new(g_str_hash, g_str_equal);
+    self->load_pool = g_thread_pool_new(RrImageLoadThread, self,
+                                        LOAD_THREADS, FALSE, NULL);
+    self->loaded = g_async_queue_new_full(RrImageLoadFree);
+    self->load_cancelled = 0;
+    self->loaded_func = NULL;
+    self->loaded_data = NULL;
+    self->icon_theme = NULL;
+    self->icon_size = 0;
+    self->disk = NULL;
+    self->disk_file = NULL;
+    self->disk_dirty = FALSE;
+    self->disk_files = g_hash_table_new_full(
+        g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify)RrImageCacheFileFree);
     return self;
 }
 
@@ -43,9 +65,129 @@ void RrImageCacheRef(RrImageCache *self)
     ++self->ref;
 }
 
+void RrImageCacheSetLoadedFunc(RrImageCache *self, RrImageLoadedFunc func,
+                               gpointer data)
+{
+    self->loaded_func = func;
+    self->loaded_data = data;
+}
+
+void RrImageCacheSetIconTheme(RrImageCache *self, const gchar *theme,
+                              gint size)
+{
+    ObtPaths *p;
+
+    if (self->icon_theme)
+        obt_icon_theme_unref(self->icon_theme);
+
+    p = obt_paths_new();
+    self->icon_theme = obt_icon_theme_new(p, theme);
+    self->icon_size = size;
+    obt_paths_unref(p);
+}
+
+void RrImageCacheSetDiskCache(RrImageCache *self, const gchar *file)
+{
+    /* the load_pool reads the disk cache without locking it */
+    g_return_if_fail(self->disk_file == NULL);
+    g_return_if_fail(g_hash_table_size(self->name_table) == 0);
+
+    self->disk_file = g_strdup(file);
+    self->disk = RrDiskCacheOpen(file);
+    /* write a new one if there was nothing usable */
+    self->disk_dirty = !self->disk;
+}
+
+void RrImageCacheSave(RrImageCache *self)
+{
+    RrDiskCacheWriter *w;
+    GHashTableIter it;
+    gpointer name, value;
+    GArray *pics;
+
+    if (!self->disk_file || !self->disk_dirty)
+        return;
+
+    w = RrDiskCacheWriterNew();
+    pics = g_array_new(FALSE, FALSE, sizeof(RrDiskCachePic));
+
+    g_hash_table_iter_init(&it, self->disk_files);
+    while (g_hash_table_iter_next(&it, &name, &value)) {
+        RrImageCacheFile *f = value;
+        RrImageSet *set;
+        RrDiskCachePic pic;
+        gint i;
+
+        /* skip files whose images have all been destroyed */
+        if (!(set = g_hash_table_lookup(self->name_table, name)))
+            continue;
+
+        /* find the picture from the file, which is in the set's originals
+           unless the set was merged with another holding the same image */
+        g_array_set_size(pics, 0);
+        for (i = 0; i < set->n_original; ++i)
+            if (set->original[i]->width == f->width &&
+                set->original[i]->height == f->height)
+            {
+                pic.width = f->width;
+                pic.height = f->height;
+                pic.data = set->original[i]->data;
+                g_array_append_val(pics, pic);
+                break;
+            }
+        if (pics->len == 0)
+            continue;
+
+        /* the resized pictures are in the order they were last used */
+        for (i = 0; i < set->n_resized; ++i) {
+            pic.width = set->resized[i]->width;
+            pic.height = set->resized[i]->height;
+            pic.data = set->resized[i]->data;
+            g_array_append_val(pics, pic);
+        }
+
+        RrDiskCacheWriterAdd(w, f->path, f->mtime, f->size,
+                             (RrDiskCachePic*)pics->data, pics->len);
+    }
+
+    if (!RrDiskCacheWriterSave(w, self->disk_file))
+        g_message("Unable to save the image cache to \"%s\"",
+                  self->disk_file);
+    else
+        self->disk_dirty = FALSE;
+
+    g_array_free(pics, TRUE);
+}
+
+void RrImageCacheFileFree(RrImageCacheFile *f)
+{
+    if (f) {
+        g_free(f->path);
+        g_slice_free(RrImageCacheFile, f);
+    }
+}
+
 void RrImageCacheUnref(RrImageCache *self)
 {
     if (self && --self->ref == 0) {
+        /* let the threads skip whatever is left in their queue, and wait for
+           them to finish. then nothing will be added to the loaded queue, and
+           nothing new will try to read it */
+        g_atomic_int_set(&self->load_cancelled, TRUE);
+        g_thread_pool_free(self->load_pool, FALSE, TRUE);
+        self->load_pool = NULL;
+        while (g_idle_remove_by_data(self));
+        g_async_queue_unref(self->loaded);
+        self->loaded = NULL;
+
+        if (self->icon_theme)
+            obt_icon_theme_unref(self->icon_theme);
+
+        /* nothing reads from the disk cache any more */
+        RrDiskCacheClose(self->disk);
+        g_free(self->disk_file);
+        g_hash_table_destroy(self->disk_files);
+
         g_assert(g_hash_table_size(self->pic_table) == 0);
         g_hash_table_unref(self->pic_table);
         self->pic_table = NULL;
@@ -127,14 +269,112 @@ guint32 hashword(const guint32 *key, gint length, guint32 initval)
 */
 #define HASH_INITVAL 0xf00d
 
+/*! The most pixels that are looked at to build the quick hash of a picture.
+  Pictures which get this far will also be compared in full, so the quick
+  hash only needs to be good enough to keep the hash table buckets small. */
+#define HASH_GRID 8
+#define HASH_SAMPLES (HASH_GRID * HASH_GRID)
+
 guint RrImagePicHash(const RrImagePic *p)
 {
-    return hashword(p->data, p->width * p->height, HASH_INITVAL);
+    guint32 key[HASH_SAMPLES + 2];
+    gsize n, i, j;
+    gint x, y;
+
+    key[0] = p->width;
+    key[1] = p->height;
+
+    n = (gsize)p->width * p->height;
+    if (n <= HASH_SAMPLES) {
+        /* small enough to use every pixel */
+        for (i = 0, j = 2; i < n; ++i, ++j)
+            key[j] = p->data[i];
+    }
+    else {
+        /* take the middle of each cell of a grid over the picture.  stepping
+           through the pixels in order instead would land in the same column
+           every time for the common square sizes */
+        for (i = 0, j = 2; i < HASH_SAMPLES; ++i, ++j) {
+            x = (i % HASH_GRID) * p->width / HASH_GRID +
+                p->width / (2 * HASH_GRID);
+            y = (i / HASH_GRID) * p->height / HASH_GRID +
+                p->height / (2 * HASH_GRID);
+            key[j] = p->data[y * p->width + x];
+        }
+    }
+
+    return hashword(key, j, HASH_INITVAL);
+}
+
+/* these primes and the rounds using them come from xxHash, by Yann Collet */
+#define PRIME64_1 G_GUINT64_CONSTANT(0x9E3779B185EBCA87)
+#define PRIME64_2 G_GUINT64_CONSTANT(0xC2B2AE3D27D4EB4F)
+#define PRIME64_3 G_GUINT64_CONSTANT(0x165667B19E3779F9)
+#define rot64(x,k) (((x)<<(k)) | ((x)>>(64-(k))))
+#define round64(acc,in) \
+{ \
+  acc += (in) * PRIME64_2; \
+  acc = rot64(acc, 31); \
+  acc *= PRIME64_1; \
+}
+
+guint64 RrImagePicHash64(RrImagePic *p)
+{
+    const RrPixel32 *d;
+    guint64 v1, v2, v3, v4, h;
+    gsize n;
+
+    if (p->hashed)
+        return p->hash;
+
+    d = p->data;
+    n = (gsize)p->width * p->height;
+
+    /* four independent accumulators, each taking two pixels at a time, so
+       that the rounds can run in parallel */
+    v1 = HASH_INITVAL + PRIME64_1 + PRIME64_2;
+    v2 = HASH_INITVAL + PRIME64_2;
+    v3 = HASH_INITVAL;
+    v4 = HASH_INITVAL - PRIME64_1;
+    for (; n >= 8; n -= 8, d += 8) {
+        round64(v1, d[0] | ((guint64)d[1] << 32));
+        round64(v2, d[2] | ((guint64)d[3] << 32));
+        round64(v3, d[4] | ((guint64)d[5] << 32));
+        round64(v4, d[6] | ((guint64)d[7] << 32));
+    }
+    h = rot64(v1, 1) + rot64(v2, 7) + rot64(v3, 12) + rot64(v4, 18);
+
+    /* the last few pixels, and the size of the picture */
+    for (; n > 0; --n, ++d)
+        round64(h, *d);
+    h ^= ((guint64)p->width << 32) | (guint32)p->height;
+
+    /* final avalanche */
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+
+    p->hash = h;
+    p->hashed = TRUE;
+    return h;
 }
 
 static gboolean RrImagePicEqual(const RrImagePic *p1,
                                 const RrImagePic *p2)
 {
-    return p1->width == p2->width && p1->height == p2->height &&
-        p1->sum == p2->sum;
+    if (p1 == p2)
+        return TRUE;
+    if (p1->width != p2->width || p1->height != p2->height)
+        return FALSE;
+
+    /* the quick hashes matched, so check the full hashes, which are saved in
+       the pictures for next time */
+    if (RrImagePicHash64((RrImagePic*)p1) != RrImagePicHash64((RrImagePic*)p2))
+        return FALSE;
+
+    /* don't trust the hash alone, make sure it is not a collision */
+    return memcmp(p1->data, p2->data,
+                  (gsize)p1->width * p1->height * sizeof(RrPixel32)) == 0;
 }
@@ -19,11 +19,36 @@
 #ifndef __imagecache_h
 #define __imagecache_h
 
+#include "render.h"
+
 #include <glib.h>
 
 struct _RrImagePic;
+struct _ObtIconTheme;
+struct _RrDiskCache;
+
+typedef struct _RrImageCacheFile RrImageCacheFile;
+
+/*! An image file that was loaded into the cache, which can be saved in the
+  disk cache. */
+struct _RrImageCacheFile {
+    gchar *path;
+    gint64 mtime;
+    /*! The size the file was loaded for */
+    gint size;
+    /*! The size of the picture decoded from the file */
+    gint width;
+    gint height;
+};
+
+void RrImageCacheFileFree(RrImageCacheFile *f);
 
+/*! A quick hash of an RrImagePic, made from its size and a sample of its
+  pixels.  This is what the image cache is keyed on. */
 guint RrImagePicHash(const struct _RrImagePic *p);
+/*! A 64-bit hash of all the pixels in an RrImagePic.  It is saved in the
+  RrImagePic the first time it is calculated. */
+guint64 RrImagePicHash64(struct _RrImagePic *p);
 
 /*! Create a new image cache.  An image cache is basically a hash table to look
   up RrImages.  Each RrImage in the cache may contain one or more Pictures,
@@ -53,6 +78,39 @@ struct _RrImageCache {
     /*! Used to find out if an image file has already been loaded into an
       image set. Provides a quick file_name -> RrImageSet lookup. */
     GHashTable *name_table;
+
+    /*! Image files are decoded by the threads in this pool, so that loading
+      them does not block the caller. */
+    GThreadPool *load_pool;
+    /*! Image files which have been decoded by the load_pool, and are waiting
+      to be added to their RrImageSet in the main thread. */
+    GAsyncQueue *loaded;
+    /*! Set when the cache is being destroyed, so that the load_pool can skip
+      any work it has left. */
+    gint load_cancelled;
+
+    /*! The icon theme used to find image files which are given by an icon
+      name instead of a path, or NULL if there is none. */
+    struct _ObtIconTheme *icon_theme;
+    /*! The size to look for images at in the icon_theme. */
+    gint icon_size;
+
+    /*! Decoded image files saved from an earlier run, which the load_pool
+      uses instead of decoding the files again.  It is NULL if there is no
+      disk cache. */
+    struct _RrDiskCache *disk;
+    /*! The path to save the disk cache to */
+    gchar *disk_file;
+    /*! The image files that have been loaded, as RrImageCacheFile, keyed on
+      the name they were loaded with */
+    GHashTable *disk_files;
+    /*! TRUE when pictures have been made which are not in the disk cache */
+    gboolean disk_dirty;
+
+    /*! Called in the main thread when an image file has been loaded into an
+      RrImage. */
+    RrImageLoadedFunc loaded_func;
+    gpointer loaded_data;
 };
 
 #endif
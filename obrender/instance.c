@@ -67,6 +67,11 @@ RrInstance* RrInstanceNew (Display *display, gint screen)
     definst->pango = pango_xft_get_context(display, screen);
 
     definst->pseudo_colors = NULL;
+    definst->paint_pool = NULL;
+    definst->release_pixel_data = FALSE;
+    definst->pixel_data_released = 0;
+    definst->parent_pixels = NULL;
+    definst->parent_pixels_owner = NULL;
 
     definst->color_hash = g_hash_table_new_full(g_int_hash, g_int_equal,
                                                 NULL, dest);
@@ -212,6 +217,9 @@ void RrInstanceFree (RrInstance *inst)
         g_free(inst->pseudo_colors);
         g_hash_table_destroy(inst->color_hash);
         g_object_unref(inst->pango);
+        if (inst->paint_pool)
+            g_thread_pool_free(inst->paint_pool, FALSE, TRUE);
+        g_free(inst->parent_pixels);
         g_slice_free(RrInstance, inst);
     }
 }
@@ -305,3 +313,13 @@ GHashTable* RrColorHash (const RrInstance *inst)
 {
     return (inst ? inst : definst)->color_hash;
 }
+
+void RrSetReleasePixelData(RrInstance *inst, gboolean release)
+{
+    (inst ? inst : definst)->release_pixel_data = release;
+}
+
+gsize RrPixelDataReleased(const RrInstance *inst)
+{
+    return (inst ? inst : definst)->pixel_data_released;
+}
@@ -48,6 +48,19 @@ struct _RrInstance {
     XColor *pseudo_colors;
 
     GHashTable *color_hash;
+
+    /*! Renders appearances for RrPaintBatch.  It is made the first time it is
+      needed. */
+    GThreadPool *paint_pool;
+
+    /*! Appearances free their pixel_data once it is sent to the X server */
+    gboolean release_pixel_data;
+    /*! The number of bytes of pixel_data that appearances have freed */
+    gsize pixel_data_released;
+    /*! The pixel_data of the last parent that was rendered again for its
+      ParentRelative children, after it was freed */
+    RrPixel32 *parent_pixels;
+    const RrAppearance *parent_pixels_owner;
 };
 
 guint       RrPseudoBPC    (const RrInstance *inst);
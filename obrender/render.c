@@ -25,6 +25,7 @@
 #include "color.h"
 #include "image.h"
 #include "theme.h"
+#include "instance.h"
 
 #include <glib.h>
 #include <X11/Xlib.h>
@@ -34,60 +35,107 @@
 #ifdef HAVE_STDLIB_H
 #  include <stdlib.h>
 #endif
+#ifdef HAVE_UNISTD_H
+#  include <unistd.h>
+#endif
+
+/*! The most threads to render an RrPaintBatch with */
+#define PAINT_THREADS_MAX 8
+/*! Surfaces smaller than this many pixels are rendered quicker than they can
+  be handed to another thread */
+#define PAINT_THREAD_MIN_PIXELS 4096
 
 static void pixel_data_to_pixmap(RrAppearance *l,
                                  gint x, gint y, gint w, gint h);
 
-Pixmap RrPaintPixmap(RrAppearance *a, gint w, gint h)
+/*! The area of an appearance, inside its bevel or border, that the textures
+  are drawn in */
+static void texture_area(RrAppearance *a, RrRect *tarea)
 {
-    gint i, transferred = 0, force_transfer = 0;
-    Pixmap oldp = None;
-    RrRect tarea; /* area in which to draw textures */
-    gboolean resized;
-
-    if (w <= 0 || h <= 0) return None;
-
-    if (a->surface.parentx < 0 || a->surface.parenty < 0) {
-        /* ob_debug("Invalid parent co-ordinates\n"); */
-        return None;
-    }
-
-    if (a->surface.grad == RR_SURFACE_PARENTREL &&
-        (a->surface.parentx >= a->surface.parent->w ||
-         a->surface.parenty >= a->surface.parent->h))
-    {
-        return None;
-    }
-
-    resized = (a->w != w || a->h != h);
-
-    oldp = a->pixmap; /* save to free after changing the visible pixmap */
-    a->pixmap = XCreatePixmap(RrDisplay(a->inst),
-                              RrRootWindow(a->inst),
-                              w, h, RrDepth(a->inst));
+    gint l, t, r, b;
+    RrMargins(a, &l, &t, &r, &b);
+    RECT_SET(*tarea, l, t, a->w - l - r, a->h - t - b);
+}
 
-    g_assert(a->pixmap != None);
-    a->w = w;
-    a->h = h;
+/*! Draw the textures which go into the appearance's pixel_data.  These always
+  come before any textures drawn with X.  This does not use the X server, so
+  it can be run outside of the main thread.
+  @return TRUE if any textures were drawn.
+*/
+static gboolean draw_pixel_textures(RrAppearance *a)
+{
+    gint i;
+    RrRect tarea;
+    gboolean drawn = FALSE;
 
-    if (a->xftdraw != NULL)
-        XftDrawDestroy(a->xftdraw);
-    a->xftdraw = XftDrawCreate(RrDisplay(a->inst), a->pixmap,
-                               RrVisual(a->inst), RrColormap(a->inst));
-    g_assert(a->xftdraw != NULL);
+    texture_area(a, &tarea);
 
-    if (resized) {
-        g_free(a->surface.pixel_data);
-        a->surface.pixel_data = g_new(RrPixel32, w * h);
+    for (i = 0; i < a->textures; i++) {
+        switch (a->texture[i].type) {
+        case RR_TEXTURE_IMAGE:
+            {
+                RrRect narea = tarea;
+                RrTextureImage *img = &a->texture[i].data.image;
+                narea.x += img->tx;
+                narea.width -= img->tx;
+                narea.y += img->ty;
+                narea.height -= img->ty;
+                if (img->twidth)
+                    narea.width = MIN(narea.width, img->twidth);
+                if (img->theight)
+                    narea.height = MIN(narea.height, img->theight);
+                RrImageDrawImage(a->surface.pixel_data,
+                                 &a->texture[i].data.image,
+                                 a->w, a->h,
+                                 &narea);
+            }
+            drawn = TRUE;
+            break;
+        case RR_TEXTURE_RGBA:
+            {
+                RrRect narea = tarea;
+                RrTextureRGBA *rgb = &a->texture[i].data.rgba;
+                narea.x += rgb->tx;
+                narea.width -= rgb->tx;
+                narea.y += rgb->ty;
+                narea.height -= rgb->ty;
+                if (rgb->twidth)
+                    narea.width = MIN(narea.width, rgb->twidth);
+                if (rgb->theight)
+                    narea.height = MIN(narea.height, rgb->theight);
+                RrImageDrawRGBA(a->surface.pixel_data,
+                                &a->texture[i].data.rgba,
+                                a->w, a->h,
+                                &narea);
+            }
+            drawn = TRUE;
+            break;
+        case RR_TEXTURE_NONE:
+        case RR_TEXTURE_TEXT:
+        case RR_TEXTURE_LINE_ART:
+        case RR_TEXTURE_MASK:
+            break;
+        case RR_TEXTURE_NUM_TYPES:
+            g_assert_not_reached();
+        }
     }
+    return drawn;
+}
 
-    RrRender(a, w, h);
+/*! Draw the textures which are drawn with X into the appearance's pixmap,
+  and move the pixel_data into the pixmap before them if it is needed.
+  @param force_transfer The pixel_data has textures drawn in it, so it must
+    be moved into the pixmap if there are no textures drawn with X.
+  @param no_transfer The pixmap already holds the surface, and there is no
+    pixel_data to move into it.
+*/
+static void draw_x_textures(RrAppearance *a, gboolean force_transfer,
+                            gboolean no_transfer)
+{
+    gint i, transferred = no_transfer;
+    RrRect tarea;
 
-    {
-        gint l, t, r, b;
-        RrMargins(a, &l, &t, &r, &b);
-        RECT_SET(tarea, l, t, w - l - r, h - t - b);
-    }
+    texture_area(a, &tarea);
 
     for (i = 0; i < a->textures; i++) {
         switch (a->texture[i].type) {
@@ -98,7 +146,7 @@ Pixmap RrPaintPixmap(RrAppearance *a, gint w, gint h)
                 transferred = 1;
                 if ((a->surface.grad != RR_SURFACE_SOLID)
                     || (a->surface.interlaced))
-                    pixel_data_to_pixmap(a, 0, 0, w, h);
+                    pixel_data_to_pixmap(a, 0, 0, a->w, a->h);
             }
             if (a->xftdraw == NULL) {
                 a->xftdraw = XftDrawCreate(RrDisplay(a->inst), a->pixmap,
@@ -112,7 +160,7 @@ Pixmap RrPaintPixmap(RrAppearance *a, gint w, gint h)
                 transferred = 1;
                 if ((a->surface.grad != RR_SURFACE_SOLID)
                     || (a->surface.interlaced))
-                    pixel_data_to_pixmap(a, 0, 0, w, h);
+                    pixel_data_to_pixmap(a, 0, 0, a->w, a->h);
             }
             XDrawLine(RrDisplay(a->inst), a->pixmap,
                       RrColorGC(a->texture[i].data.lineart.color),
@@ -126,50 +174,15 @@ Pixmap RrPaintPixmap(RrAppearance *a, gint w, gint h)
                 transferred = 1;
                 if ((a->surface.grad != RR_SURFACE_SOLID)
                     || (a->surface.interlaced))
-                    pixel_data_to_pixmap(a, 0, 0, w, h);
+                    pixel_data_to_pixmap(a, 0, 0, a->w, a->h);
             }
             RrPixmapMaskDraw(a->pixmap, &a->texture[i].data.mask, &tarea);
             break;
         case RR_TEXTURE_IMAGE:
-            g_assert(!transferred);
-            {
-                RrRect narea = tarea;
-                RrTextureImage *img = &a->texture[i].data.image;
-                narea.x += img->tx;
-                narea.width -= img->tx;
-                narea.y += img->ty;
-                narea.height -= img->ty;
-                if (img->twidth)
-                    narea.width = MIN(narea.width, img->twidth);
-                if (img->theight)
-                    narea.height = MIN(narea.height, img->theight);
-                RrImageDrawImage(a->surface.pixel_data,
-                                 &a->texture[i].data.image,
-                                 a->w, a->h,
-                                 &narea);
-            }
-            force_transfer = 1;
-            break;
         case RR_TEXTURE_RGBA:
+            /* these were drawn into the pixel_data already */
             g_assert(!transferred);
-            {
-                RrRect narea = tarea;
-                RrTextureRGBA *rgb = &a->texture[i].data.rgba;
-                narea.x += rgb->tx;
-                narea.width -= rgb->tx;
-                narea.y += rgb->ty;
-                narea.height -= rgb->ty;
-                if (rgb->twidth)
-                    narea.width = MIN(narea.width, rgb->twidth);
-                if (rgb->theight)
-                    narea.height = MIN(narea.height, rgb->theight);
-                RrImageDrawRGBA(a->surface.pixel_data,
-                                &a->texture[i].data.rgba,
-                                a->w, a->h,
-                                &narea);
-            }
-            force_transfer = 1;
-        break;
+            break;
         case RR_TEXTURE_NUM_TYPES:
             g_assert_not_reached();
         }
@@ -180,9 +193,218 @@ Pixmap RrPaintPixmap(RrAppearance *a, gint w, gint h)
         if ((a->surface.grad != RR_SURFACE_SOLID) || (a->surface.interlaced) ||
             force_transfer)
         {
-            pixel_data_to_pixmap(a, 0, 0, w, h);
+            pixel_data_to_pixmap(a, 0, 0, a->w, a->h);
         }
     }
+}
+
+/*! Update the count of released pixel_data before an appearance gets new
+  pixel_data or is freed */
+static void pixel_data_unreleased(RrAppearance *a)
+{
+    if (!a->surface.pixel_data && a->w && a->h && a->inst)
+        ((RrInstance*)a->inst)->pixel_data_released -=
+            a->w * a->h * sizeof(RrPixel32);
+}
+
+/*! Free an appearance's pixel_data, and count it as released.  This is
+  only used while painting, after pixel_data_unreleased(). */
+static void pixel_data_free(RrAppearance *a)
+{
+    g_free(a->surface.pixel_data);
+    a->surface.pixel_data = NULL;
+    if (a->inst)
+        ((RrInstance*)a->inst)->pixel_data_released +=
+            a->w * a->h * sizeof(RrPixel32);
+}
+
+/*! Free an appearance's pixel_data once it has been sent to the X server, if
+  the instance wants that */
+static void pixel_data_release(RrAppearance *a)
+{
+    if (a->inst && a->inst->release_pixel_data && a->surface.pixel_data)
+        pixel_data_free(a);
+}
+
+/*! Returns TRUE if a ParentRelative appearance looks just like the area of
+  its parent's pixmap under it, apart from the textures drawn with X.  Then
+  it can be painted by copying from the parent's pixmap on the X server,
+  without any pixel_data.
+  @param parent The parent, with the textures it was painted with.
+*/
+static gboolean parentrel_copyable(RrAppearance *a, RrAppearance *parent)
+{
+    gint i;
+
+    if (a->surface.grad != RR_SURFACE_PARENTREL || !parent ||
+        a->surface.relief != RR_RELIEF_FLAT || a->surface.border ||
+        a->surface.interlaced)
+        return FALSE;
+
+    /* these would be drawn into the pixel_data */
+    for (i = 0; i < a->textures; ++i)
+        if (a->texture[i].type == RR_TEXTURE_IMAGE ||
+            a->texture[i].type == RR_TEXTURE_RGBA)
+            return FALSE;
+
+    /* the parent's pixmap has these in it, but its pixel_data does not */
+    for (i = 0; i < parent->textures; ++i)
+        if (parent->texture[i].type == RR_TEXTURE_TEXT ||
+            parent->texture[i].type == RR_TEXTURE_LINE_ART ||
+            parent->texture[i].type == RR_TEXTURE_MASK)
+            return FALSE;
+    return TRUE;
+}
+
+static const RrPixel32* parent_pixels(RrAppearance *p);
+
+/*! If a ParentRelative appearance's parent has released its pixel_data, then
+  lend it pixels rendered again, until pixels_return() is called.
+  @return TRUE if the parent was given pixels.
+*/
+static gboolean pixels_lend(RrAppearance *a)
+{
+    RrAppearance *p = a->surface.parent;
+
+    if (a->surface.grad != RR_SURFACE_PARENTREL ||
+        !p || p->surface.pixel_data || !p->w || !p->h)
+        return FALSE;
+
+    p->surface.pixel_data = (RrPixel32*)parent_pixels(p);
+    return TRUE;
+}
+
+static void pixels_return(RrAppearance *a, gboolean lent)
+{
+    if (lent)
+        a->surface.parent->surface.pixel_data = NULL;
+}
+
+/*! Render an appearance's pixel_data again into a new buffer, after it was
+  released.  Nothing is drawn with X, so its pixmap is not changed. */
+static RrPixel32* pixels_render(RrAppearance *a)
+{
+    RrAppearance copy = *a;
+    gboolean lent;
+
+    copy.pixmap = None;
+    copy.xftdraw = NULL;
+    copy.surface.pixel_data = g_new(RrPixel32, a->w * a->h);
+
+    lent = pixels_lend(&copy);
+    RrRender(&copy, a->w, a->h);
+    pixels_return(&copy, lent);
+    draw_pixel_textures(&copy);
+
+    return copy.surface.pixel_data;
+}
+
+/*! Get the released pixel_data of an appearance, rendered again.  The last
+  one is kept, as a parent usually has several children painted after it.
+  The pixels belong to the instance, and are valid until the next call. */
+static const RrPixel32* parent_pixels(RrAppearance *p)
+{
+    RrInstance *inst = (RrInstance*)p->inst;
+    RrPixel32 *data;
+
+    if (inst->parent_pixels_owner != p) {
+        /* this may render the parent's parent, and keep it in the instance
+           for a moment */
+        data = pixels_render(p);
+        g_free(inst->parent_pixels);
+        inst->parent_pixels = data;
+        inst->parent_pixels_owner = p;
+    }
+    return inst->parent_pixels;
+}
+
+/*! Forget the pixels that were rendered again for an appearance, when it is
+  painted or freed */
+static void parent_pixels_forget(RrAppearance *a)
+{
+    RrInstance *inst = (RrInstance*)a->inst;
+
+    if (inst && inst->parent_pixels_owner == a) {
+        g_free(inst->parent_pixels);
+        inst->parent_pixels = NULL;
+        inst->parent_pixels_owner = NULL;
+    }
+}
+
+/*! Make a new pixmap for the appearance to draw into, and return the old
+  one */
+static Pixmap new_pixmap(RrAppearance *a, gint w, gint h)
+{
+    Pixmap oldp;
+
+    oldp = a->pixmap; /* save to free after changing the visible pixmap */
+    a->pixmap = XCreatePixmap(RrDisplay(a->inst),
+                              RrRootWindow(a->inst),
+                              w, h, RrDepth(a->inst));
+
+    g_assert(a->pixmap != None);
+    a->w = w;
+    a->h = h;
+
+    if (a->xftdraw != NULL)
+        XftDrawDestroy(a->xftdraw);
+    a->xftdraw = XftDrawCreate(RrDisplay(a->inst), a->pixmap,
+                               RrVisual(a->inst), RrColormap(a->inst));
+    g_assert(a->xftdraw != NULL);
+
+    return oldp;
+}
+
+Pixmap RrPaintPixmap(RrAppearance *a, gint w, gint h)
+{
+    Pixmap oldp = None;
+    gboolean resized, lent;
+
+    if (w <= 0 || h <= 0) return None;
+
+    if (a->surface.parentx < 0 || a->surface.parenty < 0) {
+        /* ob_debug("Invalid parent co-ordinates\n"); */
+        return None;
+    }
+
+    if (a->surface.grad == RR_SURFACE_PARENTREL &&
+        (a->surface.parentx >= a->surface.parent->w ||
+         a->surface.parenty >= a->surface.parent->h))
+    {
+        return None;
+    }
+
+    resized = (a->w != w || a->h != h);
+
+    parent_pixels_forget(a);
+    pixel_data_unreleased(a);
+    oldp = new_pixmap(a, w, h);
+
+    if (a->surface.grad == RR_SURFACE_PARENTREL &&
+        a->surface.parent->pixmap != None &&
+        parentrel_copyable(a, a->surface.parent))
+    {
+        XCopyArea(RrDisplay(a->inst), a->surface.parent->pixmap, a->pixmap,
+                  DefaultGC(RrDisplay(a->inst), RrScreen(a->inst)),
+                  a->surface.parentx, a->surface.parenty, w, h, 0, 0);
+        /* children which need the pixels will render them again */
+        pixel_data_free(a);
+        draw_x_textures(a, FALSE, TRUE);
+        return oldp;
+    }
+
+    if (resized || !a->surface.pixel_data) {
+        g_free(a->surface.pixel_data);
+        a->surface.pixel_data = g_new(RrPixel32, w * h);
+    }
+
+    lent = pixels_lend(a);
+    RrRender(a, w, h);
+    pixels_return(a, lent);
+
+    draw_x_textures(a, draw_pixel_textures(a), FALSE);
+
+    pixel_data_release(a);
 
     return oldp;
 }
@@ -198,6 +420,354 @@ void RrPaint(RrAppearance *a, Window win, gint w, gint h)
     if (oldp) XFreePixmap(RrDisplay(a->inst), oldp);
 }
 
+typedef struct _RrPaintItem RrPaintItem;
+
+struct _RrPaintItem {
+    RrPaintBatch *batch;
+    /*! The appearance to paint */
+    RrAppearance *a;
+    Window win;
+    gint w, h;
+    /*! A copy of the appearance as it was when it was added to the batch.
+      When it is rendered off the X server, this is what is rendered, and it
+      keeps the pixel_data until it is sent to the X server.  Its texture
+      array is its own, but what is in it is not. */
+    RrAppearance copy;
+    /*! The item earlier in the batch that this one is ParentRelative to */
+    RrPaintItem *parent;
+    /*! A copy of the appearance this one is ParentRelative to, when that is
+      not in the batch and has released its pixel_data.  It holds the parent's
+      pixels rendered again, so that the threads do not have to. */
+    RrAppearance parent_copy;
+    /*! If TRUE the item is painted by copying from its parent's pixmap, after
+      the parent has been sent to the X server */
+    gboolean server_side;
+    /*! If TRUE the appearance's pixmap is already right, and is shown in the
+      window without painting anything */
+    gboolean reuse;
+    /*! If TRUE, other items in the batch are ParentRelative to this one */
+    gboolean has_children;
+    /*! If TRUE the surface is rendered without using the X server, which
+      lets it be rendered in the paint_pool. Otherwise it is painted with
+      RrPaint. */
+    gboolean pixels_only;
+    gboolean done;
+};
+
+struct _RrPaintBatch {
+    const RrInstance *inst;
+    GPtrArray *items;
+    /*! Items which the paint_pool has finished rendering */
+    GAsyncQueue *finished;
+};
+
+/*! Returns TRUE if the appearance's surface can be rendered without drawing
+  anything with X.  Solid surfaces are drawn with X.  The parent of a
+  ParentRelative surface may be drawn again in its place, which might be
+  solid. */
+static gboolean render_pixels_only(RrAppearance *a, RrAppearance *parent)
+{
+    if (a->surface.grad == RR_SURFACE_PARENTREL) {
+        if (!parent || parent->surface.grad == RR_SURFACE_PARENTREL)
+            return FALSE;
+        a = parent;
+    }
+    return a->surface.grad != RR_SURFACE_SOLID || a->surface.interlaced;
+}
+
+/*! Render an item's copy of its appearance into its own pixel_data. */
+static void paint_item_render(RrPaintItem *it)
+{
+    RrAppearance *a = &it->copy;
+
+    a->surface.pixel_data = g_new(RrPixel32, it->w * it->h);
+    RrRender(a, it->w, it->h);
+    /* RrImageDrawImage locks the image cache, so images can be drawn in any
+       thread */
+    draw_pixel_textures(a);
+}
+
+static void paint_thread(gpointer data, gpointer user_data)
+{
+    RrPaintItem *it = data;
+
+    paint_item_render(it);
+    g_async_queue_push(it->batch->finished, it);
+}
+
+/*! Paint an item with RrPaint, using the parent and textures it was added
+  with */
+static void paint_item_direct(RrPaintItem *it)
+{
+    RrAppearance *a = it->a;
+    RrSurface old = a->surface;
+    RrTexture *texture = a->texture;
+    gint textures = a->textures;
+
+    /* copying from the parent's pixmap needs the parent itself, which has
+       been sent to the X server by now */
+    if (it->server_side && it->parent)
+        a->surface.parent = it->parent->a;
+    else
+        a->surface.parent = it->copy.surface.parent;
+    a->surface.parentx = it->copy.surface.parentx;
+    a->surface.parenty = it->copy.surface.parenty;
+    a->texture = it->copy.texture;
+    a->textures = it->copy.textures;
+
+    RrPaint(a, it->win, it->w, it->h);
+
+    /* pixel_data may have been reallocated, and bevel colours made */
+    old.pixel_data = a->surface.pixel_data;
+    old.bevel_dark = a->surface.bevel_dark;
+    old.bevel_light = a->surface.bevel_light;
+    a->surface = old;
+    a->texture = texture;
+    a->textures = textures;
+
+    it->copy.surface.bevel_dark = a->surface.bevel_dark;
+    it->copy.surface.bevel_light = a->surface.bevel_light;
+
+    /* ParentRelative children read from the copy.  the appearance could be
+       painted again in this batch before they are rendered, so give the copy
+       its own pixel_data */
+    if (it->has_children && !it->copy.surface.pixel_data) {
+        if (a->surface.pixel_data)
+            it->copy.surface.pixel_data =
+                g_memdup(a->surface.pixel_data,
+                         it->w * it->h * sizeof(RrPixel32));
+        else if (a->w && a->h)
+            it->copy.surface.pixel_data = pixels_render(&it->copy);
+    }
+}
+
+/*! Send a rendered item to the X server and show it in its window */
+static void paint_item_upload(RrPaintItem *it)
+{
+    RrAppearance *a = it->a;
+    RrTexture *texture = a->texture;
+    gint textures = a->textures;
+    Pixmap oldp;
+
+    parent_pixels_forget(a);
+    pixel_data_unreleased(a);
+    oldp = new_pixmap(a, it->w, it->h);
+
+    /* the appearance takes the pixel_data, as it would from RrPaint */
+    g_free(a->surface.pixel_data);
+    a->surface.pixel_data = it->copy.surface.pixel_data;
+    it->copy.surface.pixel_data = NULL;
+
+    a->texture = it->copy.texture;
+    a->textures = it->copy.textures;
+    draw_x_textures(a, TRUE, FALSE);
+    a->texture = texture;
+    a->textures = textures;
+
+    pixel_data_release(a);
+
+    XSetWindowBackgroundPixmap(RrDisplay(a->inst), it->win, a->pixmap);
+    XClearWindow(RrDisplay(a->inst), it->win);
+    /* free this after changing the visible pixmap */
+    if (oldp) XFreePixmap(RrDisplay(a->inst), oldp);
+}
+
+RrPaintBatch* RrPaintBatchNew(const RrInstance *inst)
+{
+    RrPaintBatch *b;
+
+    g_return_val_if_fail(inst != NULL, NULL);
+
+    b = g_slice_new(RrPaintBatch);
+    b->inst = inst;
+    b->items = g_ptr_array_new();
+    b->finished = g_async_queue_new();
+    return b;
+}
+
+void RrPaintBatchAdd(RrPaintBatch *b, RrAppearance *a, Window win,
+                     gint w, gint h)
+{
+    RrPaintItem *it;
+    RrAppearance *parent;
+    gint i;
+
+    it = g_slice_new0(RrPaintItem);
+    it->batch = b;
+    it->a = a;
+    it->win = win;
+    it->w = w;
+    it->h = h;
+    it->copy = *a;
+    it->copy.surface.pixel_data = NULL;
+    it->copy.texture = g_memdup(a->texture, a->textures * sizeof(RrTexture));
+    it->copy.w = w;
+    it->copy.h = h;
+
+    parent = NULL;
+    if (a->surface.grad == RR_SURFACE_PARENTREL && a->surface.parent) {
+        /* the parent may be painted in this batch too */
+        for (i = b->items->len - 1; i >= 0; --i) {
+            RrPaintItem *p = g_ptr_array_index(b->items, i);
+            if (p->a == a->surface.parent && !p->reuse) {
+                it->parent = p;
+                it->copy.surface.parent = &p->copy;
+                p->has_children = TRUE;
+                break;
+            }
+        }
+
+        /* the parent's pixmap has to be made before it can be copied, so
+           this waits for the upload if the parent is in the batch */
+        if (it->parent)
+            it->server_side = ((it->parent->pixels_only ||
+                                it->parent->server_side) &&
+                               parentrel_copyable(a, &it->parent->copy));
+        else
+            it->server_side = (a->surface.parent->pixmap != None &&
+                               parentrel_copyable(a, a->surface.parent));
+
+        if (!it->parent && !it->server_side &&
+            !a->surface.parent->surface.pixel_data &&
+            a->surface.parent->w && a->surface.parent->h)
+        {
+            it->parent_copy = *a->surface.parent;
+            it->parent_copy.surface.pixel_data =
+                pixels_render(a->surface.parent);
+            it->copy.surface.parent = &it->parent_copy;
+        }
+        parent = it->copy.surface.parent;
+    }
+
+    /* leave anything RrPaint would refuse to draw for RrPaint */
+    it->pixels_only = (!it->server_side &&
+                       w > 0 && h > 0 &&
+                       a->surface.parentx >= 0 && a->surface.parenty >= 0 &&
+                       render_pixels_only(a, parent) &&
+                       (!parent ||
+                        (a->surface.parentx < parent->w &&
+                         a->surface.parenty < parent->h)));
+
+    g_ptr_array_add(b->items, it);
+}
+
+void RrPaintBatchAddStatic(RrPaintBatch *b, RrAppearance *a, Window win,
+                           gint w, gint h)
+{
+    RrPaintItem *it;
+
+    /* a ParentRelative appearance looks different wherever it is */
+    if (a->surface.grad == RR_SURFACE_PARENTREL || a->pixmap == None ||
+        a->w != w || a->h != h)
+    {
+        RrPaintBatchAdd(b, a, win, w, h);
+        return;
+    }
+
+    it = g_slice_new0(RrPaintItem);
+    it->batch = b;
+    it->a = a;
+    it->win = win;
+    it->w = w;
+    it->h = h;
+    it->reuse = TRUE;
+    g_ptr_array_add(b->items, it);
+}
+
+void RrPaintBatchRun(RrPaintBatch *b)
+{
+    RrInstance *inst;
+    guint i, n_done, n_pushed;
+
+    inst = (RrInstance*)b->inst;
+    if (!inst->paint_pool) {
+        glong n = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+        inst->paint_pool = g_thread_pool_new(paint_thread, NULL,
+                                             CLAMP(n, 1, PAINT_THREADS_MAX),
+                                             FALSE, NULL);
+    }
+
+    /* render everything whose parent has been rendered, until everything
+       is done.  ParentRelative appearances are only one or two deep, so
+       this takes few rounds */
+    n_done = 0;
+    while (n_done < b->items->len) {
+        n_pushed = 0;
+        for (i = 0; i < b->items->len; ++i) {
+            RrPaintItem *it = g_ptr_array_index(b->items, i);
+
+            if (it->done || (it->parent && !it->parent->done))
+                continue;
+            if (it->pixels_only && it->w * it->h >= PAINT_THREAD_MIN_PIXELS) {
+                g_thread_pool_push(inst->paint_pool, it, NULL);
+                ++n_pushed;
+            }
+        }
+        /* do the rest here while the pool works */
+        for (i = 0; i < b->items->len; ++i) {
+            RrPaintItem *it = g_ptr_array_index(b->items, i);
+
+            if (it->done || (it->parent && !it->parent->done))
+                continue;
+            if (it->reuse) {
+                it->done = TRUE;
+                ++n_done;
+            }
+            else if (it->server_side) {
+                /* it is painted with the uploads, but its children need its
+                   pixels now */
+                if (it->has_children && it->w > 0 && it->h > 0)
+                    it->copy.surface.pixel_data = pixels_render(&it->copy);
+                it->done = TRUE;
+                ++n_done;
+            }
+            else if (!it->pixels_only) {
+                paint_item_direct(it);
+                it->done = TRUE;
+                ++n_done;
+            }
+            else if (it->w * it->h < PAINT_THREAD_MIN_PIXELS) {
+                paint_item_render(it);
+                it->done = TRUE;
+                ++n_done;
+            }
+        }
+        for (; n_pushed > 0; --n_pushed) {
+            RrPaintItem *it = g_async_queue_pop(b->finished);
+            it->done = TRUE;
+            ++n_done;
+        }
+    }
+
+    /* send it all to the X server in order */
+    for (i = 0; i < b->items->len; ++i) {
+        RrPaintItem *it = g_ptr_array_index(b->items, i);
+        if (it->pixels_only)
+            paint_item_upload(it);
+        else if (it->server_side)
+            paint_item_direct(it);
+        else if (it->reuse) {
+            XSetWindowBackgroundPixmap(RrDisplay(it->a->inst), it->win,
+                                       it->a->pixmap);
+            XClearWindow(RrDisplay(it->a->inst), it->win);
+        }
+    }
+
+    for (i = 0; i < b->items->len; ++i) {
+        RrPaintItem *it = g_ptr_array_index(b->items, i);
+        g_free(it->copy.surface.pixel_data);
+        g_free(it->parent_copy.surface.pixel_data);
+        g_free(it->copy.texture);
+        g_slice_free(RrPaintItem, it);
+    }
+    g_ptr_array_free(b->items, TRUE);
+    g_async_queue_unref(b->finished);
+    g_slice_free(RrPaintBatch, b);
+}
+
 RrAppearance *RrAppearanceNew(const RrInstance *inst, gint numtex)
 {
   RrAppearance *out;
@@ -231,80 +801,28 @@ void RrAppearanceClearTextures(RrAppearance *a)
     memset(a->texture, 0, a->textures * sizeof(RrTexture));
 }
 
-/* deep copy of orig, means reset ref to 1 on copy
- * and copy each thing memwise. */
+/*! Copy an appearance's style.  The colors are shared with the original,
+  so this does not allocate anything with X. */
 RrAppearance *RrAppearanceCopy(RrAppearance *orig)
 {
-    RrSurface *spo, *spc;
+    RrSurface *spc;
     RrAppearance *copy = g_slice_new(RrAppearance);
 
     copy->inst = orig->inst;
+    copy->surface = orig->surface;
 
-    spo = &(orig->surface);
     spc = &(copy->surface);
-    spc->grad = spo->grad;
-    spc->relief = spo->relief;
-    spc->bevel = spo->bevel;
-    if (spo->primary != NULL)
-        spc->primary = RrColorNew(copy->inst,
-                                  spo->primary->r,
-                                  spo->primary->g,
-                                  spo->primary->b);
-    else spc->primary = NULL;
-
-    if (spo->secondary != NULL)
-        spc->secondary = RrColorNew(copy->inst,
-                                    spo->secondary->r,
-                                    spo->secondary->g,
-                                    spo->secondary->b);
-    else spc->secondary = NULL;
-
-    if (spo->border_color != NULL)
-        spc->border_color = RrColorNew(copy->inst,
-                                       spo->border_color->r,
-                                       spo->border_color->g,
-                                       spo->border_color->b);
-    else spc->border_color = NULL;
-
-    if (spo->interlace_color != NULL)
-        spc->interlace_color = RrColorNew(copy->inst,
-                                       spo->interlace_color->r,
-                                       spo->interlace_color->g,
-                                       spo->interlace_color->b);
-    else spc->interlace_color = NULL;
-
-    if (spo->bevel_dark != NULL)
-        spc->bevel_dark = RrColorNew(copy->inst,
-                                     spo->bevel_dark->r,
-                                     spo->bevel_dark->g,
-                                     spo->bevel_dark->b);
-    else spc->bevel_dark = NULL;
-
-    if (spo->bevel_light != NULL)
-        spc->bevel_light = RrColorNew(copy->inst,
-                                      spo->bevel_light->r,
-                                      spo->bevel_light->g,
-                                      spo->bevel_light->b);
-    else spc->bevel_light = NULL;
-
-    if (spo->split_primary != NULL)
-        spc->split_primary = RrColorNew(copy->inst,
-                                        spo->split_primary->r,
-                                        spo->split_primary->g,
-                                        spo->split_primary->b);
-    else spc->split_primary = NULL;
-
-    if (spo->split_secondary != NULL)
-        spc->split_secondary = RrColorNew(copy->inst,
-                                        spo->split_secondary->r,
-                                        spo->split_secondary->g,
-                                        spo->split_secondary->b);
-    else spc->split_secondary = NULL;
-
-    spc->interlaced = spo->interlaced;
-    spc->bevel_light_adjust = spo->bevel_light_adjust;
-    spc->bevel_dark_adjust = spo->bevel_dark_adjust;
-    spc->border = spo->border;
+    if (spc->primary) spc->primary = RrColorCopy(spc->primary);
+    if (spc->secondary) spc->secondary = RrColorCopy(spc->secondary);
+    if (spc->border_color) spc->border_color = RrColorCopy(spc->border_color);
+    if (spc->interlace_color)
+        spc->interlace_color = RrColorCopy(spc->interlace_color);
+    if (spc->bevel_dark) spc->bevel_dark = RrColorCopy(spc->bevel_dark);
+    if (spc->bevel_light) spc->bevel_light = RrColorCopy(spc->bevel_light);
+    if (spc->split_primary)
+        spc->split_primary = RrColorCopy(spc->split_primary);
+    if (spc->split_secondary)
+        spc->split_secondary = RrColorCopy(spc->split_secondary);
     spc->parent = NULL;
     spc->parentx = spc->parenty = 0;
     spc->pixel_data = NULL;
@@ -323,6 +841,8 @@ void RrAppearanceFree(RrAppearance *a)
 {
     if (a) {
         RrSurface *p;
+        parent_pixels_forget(a);
+        pixel_data_unreleased(a);
         if (a->pixmap != None) XFreePixmap(RrDisplay(a->inst), a->pixmap);
         if (a->xftdraw != NULL) XftDrawDestroy(a->xftdraw);
         if (a->textures)
@@ -48,6 +48,7 @@ typedef struct _RrImageSet         RrImageSet;
 typedef struct _RrImagePic         RrImagePic;
 typedef struct _RrImageCache       RrImageCache;
 typedef struct _RrButton           RrButton;
+typedef struct _RrPaintBatch       RrPaintBatch;
 
 typedef guint32 RrPixel32;  /* ARGB format, not premultiplied alpha */
 typedef guint16 RrPixel16;
@@ -237,12 +238,15 @@ struct _RrAppearance {
 struct _RrImagePic {
     gint width, height;
     RrPixel32 *data;
-    /* The sum of all the pixels.  This is used to compare pictures if their
-       hashes match. */
-    gint sum;
+    /* A 64-bit hash of all the pixels.  This is used to compare pictures if
+       their sampled hashes match.  It is only calculated when it is first
+       needed, and hashed is set to TRUE at that time. */
+    guint64 hash;
+    gboolean hashed;
 };
 
 typedef void (*RrImageDestroyFunc)(RrImage *image, gpointer data);
+typedef void (*RrImageLoadedFunc)(RrImage *image, gpointer data);
 
 /*! An RrImage refers to a RrImageSet.  If multiple RrImageSets end up
   holding the same image data, they will be marged and the RrImages that
@@ -276,15 +280,27 @@ struct _RrImageSet
 
     /*! An array of "originals", that is of RrPictures that have been added
       to the image in various sizes, and that have not been resized.  These
-      are explicitly added to the RrImageSet. */
+      are explicitly added to the RrImageSet.  They are kept sorted by the
+      larger of their width and height, smallest first. */
     RrImagePic **original;
     gint n_original;
+    /*! The largest "original" picture, halved in size again and again.
+      Each level is made the first time a picture that small is needed, so
+      that smaller pictures are scaled from a nearby level instead of from
+      the largest original. */
+    RrImagePic **mipmap;
+    gint n_mipmap;
     /*! An array of "resized" pictures.  When an "original" RrPicture
       needs to be resized for drawing, it is saved in here so that it doesn't
       need to be resized again.  These are automatically added to the
       RrImage. */
     RrImagePic **resized;
     gint n_resized;
+
+    /*! If the pictures came from an SVG file, this is its RsvgHandle.  Then
+      "resized" pictures are drawn from the SVG at the size needed, instead
+      of being scaled from an "original" picture. */
+    gpointer svg;
 };
 
 struct _RrButton {
@@ -354,6 +370,14 @@ Window   RrRootWindow   (const RrInstance *inst);
 Visual*  RrVisual       (const RrInstance *inst);
 gint     RrDepth        (const RrInstance *inst);
 Colormap RrColormap     (const RrInstance *inst);
+
+/*! Choose whether appearances keep their pixel_data after it is sent to the
+  X server.  When they do not, the pixels of a ParentRelative appearance's
+  parent are rendered again when the child is painted. */
+void     RrSetReleasePixelData (RrInstance *inst, gboolean release);
+/*! The number of bytes of pixel_data that appearances are not keeping in
+  memory because of RrSetReleasePixelData */
+gsize    RrPixelDataReleased   (const RrInstance *inst);
 gint     RrRedOffset    (const RrInstance *inst);
 gint     RrGreenOffset  (const RrInstance *inst);
 gint     RrBlueOffset   (const RrInstance *inst);
@@ -405,6 +429,31 @@ void    RrFontDescriptionFromString(RrFont *font, gchar *description);
    it is non-null. */
 Pixmap RrPaintPixmap (RrAppearance *a, gint w, gint h);
 void   RrPaint       (RrAppearance *a, Window win, gint w, gint h);
+
+/*! Start a group of appearances to be painted together.  The appearances'
+  surfaces and images are rendered by a pool of threads, and then they are
+  sent to the X server from the calling thread.
+*/
+RrPaintBatch* RrPaintBatchNew(const RrInstance *inst);
+/*! Add an appearance to be painted into a window, as RrPaint would.  The
+  appearance's textures and parent position are saved now, so the appearance
+  can be changed and added again before the batch is run.  If the appearance
+  is ParentRelative to an appearance added earlier in the batch, it is
+  rendered after that one.
+*/
+void   RrPaintBatchAdd(RrPaintBatch *b, RrAppearance *a, Window win,
+                       gint w, gint h);
+/*! Add an appearance that does not change once it is made, such as a
+  titlebar button in the theme.  Its pixmap is shared by all the windows it
+  is shown in, so it is only rendered when the size changes, and otherwise
+  the window's background is just set to it.  ParentRelative appearances
+  depend on where they are, so they are always painted.
+*/
+void   RrPaintBatchAddStatic(RrPaintBatch *b, RrAppearance *a, Window win,
+                             gint w, gint h);
+/*! Paint everything in the batch and free it.  The windows are painted in the
+  order they were added. */
+void   RrPaintBatchRun(RrPaintBatch *b);
 void   RrMinSize     (RrAppearance *a, gint *w, gint *h);
 gint   RrMinWidth    (RrAppearance *a);
 /* For text textures, if flow is TRUE, then the string must be set before
@@ -422,6 +471,36 @@ gboolean RrPixmapToRGBA(const RrInstance *inst,
 RrImageCache* RrImageCacheNew(gint max_resized_saved);
 void          RrImageCacheRef(RrImageCache *self);
 void          RrImageCacheUnref(RrImageCache *self);
+/*! Use an icon theme to find image files which are requested by an icon name
+  (such as "firefox") instead of a path.
+  @param theme The name of the icon theme.  Its parent themes and "hicolor"
+    are also searched.
+  @param size The size to choose image files for when the theme has more than
+    one size of an icon.
+*/
+void          RrImageCacheSetIconTheme(RrImageCache *self,
+                                       const gchar *theme, gint size);
+/*! Keep the pictures decoded from image files in a file on disk, so that the
+  image files don't need to be decoded again the next time they are loaded.
+  This must be called before any images are requested with
+  RrImageNewFromName.
+  @param file The path of the disk cache.  It is read now, and it is written
+    by RrImageCacheSave.
+*/
+void          RrImageCacheSetDiskCache(RrImageCache *self, const gchar *file);
+/*! Write the pictures decoded from image files, and the resized versions of
+  them which have been drawn, to the disk cache.  This does nothing if there
+  is no disk cache, or if nothing new has been decoded or resized since it
+  was last saved.
+*/
+void          RrImageCacheSave(RrImageCache *self);
+/*! Set a function to be called when an image file, which was requested with
+  RrImageNewFromName, has finished loading.  The function is called from the
+  main loop, with the RrImage that now holds the picture, and it should
+  redraw anything showing the image. */
+void          RrImageCacheSetLoadedFunc(RrImageCache *self,
+                                        RrImageLoadedFunc func,
+                                        gpointer data);
 
 /*! Create a new image, or return one from the cache that matches.
   @param cache The image cache.
@@ -429,9 +508,13 @@ void          RrImageCacheUnref(RrImageCache *self);
     Use this if loading a different sized version of the same image.
     The returned RrImage should replace the one passed in as old.
     Pass NULL here if adding an image which is (or may be) entirely new.
-  @param name The name of the icon to be loaded off disk, or used in the cache
-  @return Returns NULL if unable to load an image by the name and it is not in
-    the cache already
+  @param name The path of the image to be loaded off disk, or an icon name to
+    be found in the cache's icon theme, or a name used in the cache.
+  @return Returns an RrImage for the name, or NULL if there is no such file.
+    If the file is not in the cache already, then it is loaded in the
+    background and the RrImage will be empty until the cache's
+    RrImageLoadedFunc is called for it.  If the file exists but cannot be
+    decoded, the RrImage stays empty, and draws nothing.
 */
 RrImage* RrImageNewFromName(RrImageCache *cache, const gchar *name);
 
@@ -456,6 +539,18 @@ RrImage* RrImageNewFromData(RrImageCache *cache, RrPixel32 *data,
 */
 void RrImageAddFromData(RrImage *image, RrPixel32 *data, gint w, gint h);
 
+/*! Resize picture data with a box filter, keeping its aspect ratio.
+  @param data The image data in RGBA32 format, @w * @h pixels.
+  @param dst_w The largest width for the result.  Set to the actual width of
+    the returned data.
+  @param dst_h The largest height for the result.  Set to the actual height of
+    the returned data.
+  @return A newly allocated array of pixels which should be freed with
+    g_free(), or NULL if the data is already the requested size.
+*/
+RrPixel32* RrImageScaleData(RrPixel32 *data, gint w, gint h,
+                            gint *dst_w, gint *dst_h);
+
 void RrImageRef(RrImage *im);
 void RrImageUnref(RrImage *im);
 
@@ -25,6 +25,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include "render.h"
+#include "gradient.h"
+#include "image.h"
 #include <glib.h>
 
 static gint x_error_handler(Display * disp, XErrorEvent * error)
@@ -39,7 +41,409 @@ Display *ob_display;
 gint ob_screen;
 Window ob_root;
 
-gint main()
+/* Benchmark mode.  Every kind of surface and texture is rendered at a grid of
+   sizes, and the time taken per pixel is reported.  With --cpu, only the
+   pixel data is rendered, without sending it to the X server (solid surfaces
+   are always drawn with X).  The depth is the X server's, so to measure
+   another depth, run it on Xvfb, such as "Xvfb :1 -screen 0 1280x1024x16". */
+
+/*! How long to render each case for, in milliseconds */
+#define BENCH_DEFAULT_TIME 100
+/*! Fail a comparison when a case gets slower than the baseline by this
+  percent */
+#define BENCH_DEFAULT_THRESHOLD 10.0
+#define BENCH_DEFAULT_SIZES "16x16,64x24,256x24,1024x768"
+
+typedef enum {
+    BENCH_NONE,
+    BENCH_PARENTREL,
+    BENCH_TEXT,
+    BENCH_IMAGE
+} BenchExtra;
+
+typedef struct _BenchCase {
+    gchar *name;
+    RrAppearance *a;
+    /*! The appearance that a ParentRelative case is drawn on */
+    RrAppearance *parent;
+    /*! Needs the X server */
+    gboolean x_only;
+} BenchCase;
+
+static const struct {
+    const gchar *name;
+    RrSurfaceColorType grad;
+} bench_grads[] = {
+    { "solid", RR_SURFACE_SOLID },
+    { "splitvertical", RR_SURFACE_SPLIT_VERTICAL },
+    { "horizontal", RR_SURFACE_HORIZONTAL },
+    { "mirrorhorizontal", RR_SURFACE_MIRROR_HORIZONTAL },
+    { "vertical", RR_SURFACE_VERTICAL },
+    { "diagonal", RR_SURFACE_DIAGONAL },
+    { "crossdiagonal", RR_SURFACE_CROSS_DIAGONAL },
+    { "pyramid", RR_SURFACE_PYRAMID }
+};
+
+static const struct {
+    const gchar *name;
+    RrReliefType relief;
+    RrBevelType bevel;
+    gboolean border;
+    gboolean interlaced;
+} bench_styles[] = {
+    { "flat", RR_RELIEF_FLAT, RR_BEVEL_1, FALSE, FALSE },
+    { "border", RR_RELIEF_FLAT, RR_BEVEL_1, TRUE, FALSE },
+    { "raised1", RR_RELIEF_RAISED, RR_BEVEL_1, FALSE, FALSE },
+    { "sunken2", RR_RELIEF_SUNKEN, RR_BEVEL_2, FALSE, FALSE },
+    { "interlaced", RR_RELIEF_FLAT, RR_BEVEL_1, FALSE, TRUE }
+};
+
+static RrAppearance* bench_appearance(RrInstance *inst, gint textures,
+                                      RrSurfaceColorType grad)
+{
+    RrAppearance *a;
+
+    a = RrAppearanceNew(inst, textures);
+    a->surface.grad = grad;
+    a->surface.primary = RrColorNew(inst, 0x20, 0x40, 0xa0);
+    a->surface.secondary = RrColorNew(inst, 0xe0, 0xe0, 0x60);
+    a->surface.split_primary = RrColorNew(inst, 0x40, 0x80, 0x40);
+    a->surface.split_secondary = RrColorNew(inst, 0xa0, 0x20, 0x20);
+    a->surface.border_color = RrColorNew(inst, 0, 0, 0);
+    a->surface.interlace_color = RrColorNew(inst, 0x10, 0x10, 0x10);
+    return a;
+}
+
+static GPtrArray* bench_cases(RrInstance *inst, RrImageCache *icons,
+                              RrFont *font)
+{
+    GPtrArray *cases;
+    BenchCase *c;
+    guint i, j;
+
+    cases = g_ptr_array_new();
+
+    for (i = 0; i < G_N_ELEMENTS(bench_grads); ++i)
+        for (j = 0; j < G_N_ELEMENTS(bench_styles); ++j) {
+            c = g_slice_new0(BenchCase);
+            c->name = g_strdup_printf("%s/%s", bench_grads[i].name,
+                                      bench_styles[j].name);
+            c->a = bench_appearance(inst, 0, bench_grads[i].grad);
+            c->a->surface.relief = bench_styles[j].relief;
+            c->a->surface.bevel = bench_styles[j].bevel;
+            c->a->surface.border = bench_styles[j].border;
+            c->a->surface.interlaced = bench_styles[j].interlaced;
+            g_ptr_array_add(cases, c);
+        }
+
+    /* copied out of its parent */
+    c = g_slice_new0(BenchCase);
+    c->name = g_strdup("parentrelative");
+    c->parent = bench_appearance(inst, 0, RR_SURFACE_VERTICAL);
+    c->a = bench_appearance(inst, 0, RR_SURFACE_PARENTREL);
+    c->a->surface.parent = c->parent;
+    g_ptr_array_add(cases, c);
+
+    /* text is drawn by Xft */
+    c = g_slice_new0(BenchCase);
+    c->name = g_strdup("text");
+    c->a = bench_appearance(inst, 1, RR_SURFACE_VERTICAL);
+    c->a->texture[0].type = RR_TEXTURE_TEXT;
+    c->a->texture[0].data.text.font = font;
+    c->a->texture[0].data.text.justify = RR_JUSTIFY_LEFT;
+    c->a->texture[0].data.text.color = RrColorNew(inst, 0xff, 0xff, 0xff);
+    c->a->texture[0].data.text.string =
+        "The quick brown fox jumps over the lazy dog";
+    c->x_only = TRUE;
+    g_ptr_array_add(cases, c);
+
+    /* an icon blended onto the surface */
+    {
+        RrPixel32 *data;
+        gint k;
+
+        data = g_new(RrPixel32, 48 * 48);
+        for (k = 0; k < 48 * 48; ++k)
+            data[k] = ((k * 5) << RrDefaultAlphaOffset) |
+                (((k / 48) * 5) << RrDefaultRedOffset) |
+                (((k % 48) * 5) << RrDefaultBlueOffset);
+
+        c = g_slice_new0(BenchCase);
+        c->name = g_strdup("image");
+        c->a = bench_appearance(inst, 1, RR_SURFACE_VERTICAL);
+        c->a->texture[0].type = RR_TEXTURE_IMAGE;
+        c->a->texture[0].data.image.image =
+            RrImageNewFromData(icons, data, 48, 48);
+        c->a->texture[0].data.image.alpha = 0xff;
+        g_ptr_array_add(cases, c);
+
+        g_free(data);
+    }
+
+    return cases;
+}
+
+static void bench_cases_free(GPtrArray *cases)
+{
+    guint i;
+
+    for (i = 0; i < cases->len; ++i) {
+        BenchCase *c = g_ptr_array_index(cases, i);
+
+        if (c->a->textures &&
+            c->a->texture[0].type == RR_TEXTURE_IMAGE)
+            RrImageUnref(c->a->texture[0].data.image.image);
+        if (c->a->textures &&
+            c->a->texture[0].type == RR_TEXTURE_TEXT)
+            RrColorFree(c->a->texture[0].data.text.color);
+        RrAppearanceFree(c->a);
+        RrAppearanceFree(c->parent);
+        g_free(c->name);
+        g_slice_free(BenchCase, c);
+    }
+    g_ptr_array_free(cases, TRUE);
+}
+
+/*! Render a case once, the way RrPaintPixmap would, but without the X
+  server. */
+static void bench_render_cpu(BenchCase *c, gint w, gint h)
+{
+    RrAppearance *a = c->a;
+    RrRect area;
+
+    if (c->parent) {
+        c->parent->w = w;
+        c->parent->h = h;
+        RrRender(c->parent, w, h);
+    }
+    a->w = w;
+    a->h = h;
+    RrRender(a, w, h);
+
+    if (a->textures && a->texture[0].type == RR_TEXTURE_IMAGE) {
+        RECT_SET(area, 0, 0, MIN(w, h), MIN(w, h));
+        RrImageDrawImage(a->surface.pixel_data, &a->texture[0].data.image,
+                         w, h, &area);
+    }
+}
+
+/*! Render and upload a case once. */
+static void bench_render_x(Display *d, BenchCase *c, gint w, gint h)
+{
+    Pixmap p;
+
+    if (c->parent && (p = RrPaintPixmap(c->parent, w, h)))
+        XFreePixmap(d, p);
+    if ((p = RrPaintPixmap(c->a, w, h)))
+        XFreePixmap(d, p);
+}
+
+/*! Returns the time taken to render a case, in nanoseconds per pixel */
+static gdouble bench_run(Display *d, BenchCase *c, gint w, gint h,
+                         gboolean cpu, gint time_ms)
+{
+    gint64 start, now;
+    glong iters;
+
+    if (cpu) {
+        /* solid surfaces are drawn with X, so they need somewhere to go.
+           anything outside of it is clipped */
+        if (c->a->pixmap == None)
+            c->a->pixmap = XCreatePixmap(d, RrRootWindow(c->a->inst),
+                                         1024, 1024, RrDepth(c->a->inst));
+        c->a->surface.pixel_data = g_renew(RrPixel32,
+                                           c->a->surface.pixel_data, w * h);
+        if (c->parent)
+            c->parent->surface.pixel_data =
+                g_renew(RrPixel32, c->parent->surface.pixel_data, w * h);
+    }
+
+    /* warm up, so resized images are cached like they would be */
+    if (cpu) bench_render_cpu(c, w, h);
+    else bench_render_x(d, c, w, h);
+    XSync(d, FALSE);
+
+    iters = 0;
+    start = g_get_monotonic_time();
+    do {
+        if (cpu) bench_render_cpu(c, w, h);
+        else bench_render_x(d, c, w, h);
+        ++iters;
+        /* wait for the X server to finish too */
+        if (!cpu && iters % 16 == 0)
+            XSync(d, FALSE);
+        now = g_get_monotonic_time();
+    } while (iters < 3 || now - start < time_ms * 1000);
+    XSync(d, FALSE);
+    now = g_get_monotonic_time();
+
+    return (now - start) * 1000.0 / ((gdouble)iters * w * h);
+}
+
+/*! Read a baseline saved with --save.  Each line is a case name, a size,
+  and the nanoseconds per pixel. */
+static GHashTable* bench_load_baseline(const gchar *file)
+{
+    GHashTable *base;
+    gchar *contents, **lines, **it;
+
+    if (!g_file_get_contents(file, &contents, NULL, NULL)) {
+        fprintf(stderr, "Unable to read the baseline \"%s\"\n", file);
+        return NULL;
+    }
+
+    base = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    lines = g_strsplit(contents, "\n", 0);
+    for (it = lines; *it; ++it) {
+        gchar name[256], size[32];
+        gdouble ns;
+
+        if (sscanf(*it, "%255s %31s %lf", name, size, &ns) == 3)
+            g_hash_table_insert(base,
+                                g_strdup_printf("%s %s", name, size),
+                                g_memdup(&ns, sizeof(ns)));
+    }
+    g_strfreev(lines);
+    g_free(contents);
+    return base;
+}
+
+static void bench_usage(void)
+{
+    printf("Usage: rendertest --bench [options]\n\n"
+           "  --cpu              Render the pixel data only, without sending "
+           "it to X\n"
+           "  --sizes WxH,...    The sizes to render at (default "
+           BENCH_DEFAULT_SIZES ")\n"
+           "  --time MS          Render each case for this long "
+           "(default %d)\n"
+           "  --filter TEXT      Only run cases with TEXT in their name\n"
+           "  --save FILE        Save the results as a baseline\n"
+           "  --compare FILE     Compare the results to a baseline\n"
+           "  --threshold PCT    Fail the comparison when a case is slower "
+           "by more\n"
+           "                     than this percent (default %.0f)\n\n"
+           "The results are in nanoseconds per pixel.  Run it with Xvfb to "
+           "measure\nother depths, such as: "
+           "Xvfb :1 -screen 0 1280x1024x16\n",
+           BENCH_DEFAULT_TIME, BENCH_DEFAULT_THRESHOLD);
+}
+
+static gint bench_main(Display *d, gint screen, gint argc, gchar **argv)
+{
+    RrInstance *inst;
+    RrImageCache *icons;
+    RrFont *font;
+    GPtrArray *cases;
+    GHashTable *base = NULL;
+    GString *save = NULL;
+    gchar **sizes;
+    const gchar *sizes_arg = BENCH_DEFAULT_SIZES;
+    const gchar *save_file = NULL, *compare_file = NULL, *filter = NULL;
+    gboolean cpu = FALSE;
+    gint time_ms = BENCH_DEFAULT_TIME;
+    gdouble threshold = BENCH_DEFAULT_THRESHOLD;
+    gint i, ret = 0;
+    guint j, k;
+
+    for (i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--bench"))
+            ;
+        else if (!strcmp(argv[i], "--cpu"))
+            cpu = TRUE;
+        else if (!strcmp(argv[i], "--sizes") && i + 1 < argc)
+            sizes_arg = argv[++i];
+        else if (!strcmp(argv[i], "--time") && i + 1 < argc) {
+            time_ms = atoi(argv[++i]);
+            time_ms = MAX(1, time_ms);
+        }
+        else if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+            filter = argv[++i];
+        else if (!strcmp(argv[i], "--save") && i + 1 < argc)
+            save_file = argv[++i];
+        else if (!strcmp(argv[i], "--compare") && i + 1 < argc)
+            compare_file = argv[++i];
+        else if (!strcmp(argv[i], "--threshold") && i + 1 < argc)
+            threshold = g_ascii_strtod(argv[++i], NULL);
+        else {
+            bench_usage();
+            return 2;
+        }
+    }
+
+    if (compare_file && !(base = bench_load_baseline(compare_file)))
+        return 2;
+    if (save_file)
+        save = g_string_new(NULL);
+
+    inst = RrInstanceNew(d, screen);
+    icons = RrImageCacheNew(3);
+    font = RrFontOpenDefault(inst);
+    cases = bench_cases(inst, icons, font);
+
+    printf("# depth %d, %s\n", RrDepth(inst),
+           cpu ? "pixel data only" : "sent to the X server");
+
+    sizes = g_strsplit(sizes_arg, ",", 0);
+    for (j = 0; j < cases->len; ++j) {
+        BenchCase *c = g_ptr_array_index(cases, j);
+
+        if (filter && !strstr(c->name, filter))
+            continue;
+        if (cpu && c->x_only)
+            continue;
+
+        for (k = 0; sizes[k]; ++k) {
+            gint w, h;
+            gchar *key;
+            gdouble ns, *old;
+
+            if (sscanf(sizes[k], "%dx%d", &w, &h) != 2 || w < 1 || h < 1) {
+                fprintf(stderr, "Skipping the size \"%s\"\n", sizes[k]);
+                continue;
+            }
+
+            ns = bench_run(d, c, w, h, cpu, time_ms);
+            printf("%-28s %10s %10.3f ns/px", c->name, sizes[k], ns);
+
+            key = g_strdup_printf("%s %s", c->name, sizes[k]);
+            if (base && (old = g_hash_table_lookup(base, key))) {
+                gdouble change = (ns - *old) * 100.0 / *old;
+                printf("  %+7.1f%%", change);
+                if (change > threshold) {
+                    printf("  SLOWER");
+                    ret = 1;
+                }
+            }
+            printf("\n");
+            fflush(stdout);
+
+            if (save)
+                g_string_append_printf(save, "%s %.4f\n", key, ns);
+            g_free(key);
+        }
+    }
+    g_strfreev(sizes);
+
+    if (save) {
+        if (!g_file_set_contents(save_file, save->str, save->len, NULL)) {
+            fprintf(stderr, "Unable to save the baseline \"%s\"\n",
+                    save_file);
+            ret = 2;
+        }
+        g_string_free(save, TRUE);
+    }
+    if (base)
+        g_hash_table_destroy(base);
+
+    bench_cases_free(cases);
+    RrFontClose(font);
+    RrImageCacheUnref(icons);
+    RrInstanceFree(inst);
+    return ret;
+}
+
+gint main(gint argc, gchar **argv)
 {
     Window win;
     RrInstance *inst;
@@ -50,9 +454,20 @@ gint main()
     gint h = 500, w = 500;
 
     ob_display = XOpenDisplay(NULL);
+    if (ob_display == NULL) {
+        fprintf(stderr, "couldn't connect to X server\n");
+        return 0;
+    }
     XSetErrorHandler(x_error_handler);
     ob_screen = DefaultScreen(ob_display);
     ob_root = RootWindow(ob_display, ob_screen);
+
+    if (argc > 1) {
+        gint ret = bench_main(ob_display, ob_screen, argc, argv);
+        XCloseDisplay(ob_display);
+        return ret;
+    }
+
     win =
         XCreateWindow(ob_display, RootWindow(ob_display, 0),
                       10, 10, w, h, 10,
@@ -72,10 +487,6 @@ gint main()
     look->surface.split_primary = RrColorParse(inst, "Green");
     look->surface.primary = RrColorParse(inst, "Blue");
     look->surface.interlaced = FALSE;
-    if (ob_display == NULL) {
-        fprintf(stderr, "couldn't connect to X server :0\n");
-        return 0;
-    }
 
 #if BIGTEST
     int i;
@@ -0,0 +1,653 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   obt/icontheme.c for the Openbox window manager
+   Copyright (c) 2026        agent
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "obt/icontheme.h"
+#include "obt/paths.h"
+
+#ifdef HAVE_STDLIB_H
+#  include <stdlib.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#  include <sys/stat.h>
+#endif
+#ifdef HAVE_SYS_TYPES_H
+#  include <sys/types.h>
+#endif
+#ifdef HAVE_STRING_H
+#  include <string.h>
+#endif
+
+/* The index is made of a header, followed by arrays of IndexStamp, IndexDir,
+   IndexIcon and IndexFile, and then all the strings that they refer to.  All
+   of the numbers are in the machine's byte order, as the index is only used
+   on the machine that made it.  Strings are given as an offset from the start
+   of the strings. */
+
+#define INDEX_MAGIC "OBIT"
+/*! Change this when the layout of the index changes */
+#define INDEX_VERSION 1
+
+/*! The theme that all themes fall back to */
+#define FALLBACK_THEME "hicolor"
+
+typedef struct _IndexHeader IndexHeader;
+typedef struct _IndexStamp  IndexStamp;
+typedef struct _IndexDir    IndexDir;
+typedef struct _IndexIcon   IndexIcon;
+typedef struct _IndexFile   IndexFile;
+
+struct _IndexHeader {
+    gchar magic[4];
+    guint32 version;
+    guint32 length; /*!< The size of the whole index */
+    guint32 n_stamps;
+    guint32 n_dirs;
+    guint32 n_icons;
+    guint32 n_files;
+    guint32 stamps; /*!< Offsets of the arrays from the start of the index */
+    guint32 dirs;
+    guint32 icons;
+    guint32 files;
+    guint32 strings;
+};
+
+/*! A file or directory that the index was made from.  If its modification
+  time changes (or it is created or deleted) the index is out of date. */
+struct _IndexStamp {
+    guint32 path;
+    guint32 pad;
+    gint64 mtime; /*!< 0 if the path did not exist */
+};
+
+/*! A directory containing icons */
+struct _IndexDir {
+    guint32 path;
+    /*! The position of the directory's theme in the list of inherited
+      themes.  Smaller is more preferred. */
+    guint32 theme;
+    /*! The range of sizes that the icons in the directory can be used for
+      without being scaled */
+    gint32 min_size;
+    gint32 max_size;
+};
+
+/*! An icon name, sorted by strcmp(), and its files */
+struct _IndexIcon {
+    guint32 name;
+    guint32 first_file;
+    guint32 n_files;
+};
+
+struct _IndexFile {
+    guint32 dir;
+    guint32 ext;
+};
+
+/*! The extensions of icon files, in order of preference */
+static const gchar *const extensions[] = { "png", "svg", "xpm" };
+
+struct _ObtIconTheme {
+    gint ref;
+    /*! The index is mapped from the cache file, or is in memory if the cache
+      could not be used */
+    GMappedFile *mapped;
+    gchar *built;
+
+    const gchar *index;
+    const IndexHeader *header;
+};
+
+/*! Collects everything while scanning the icon directories */
+typedef struct _IndexBuilder {
+    GString *strings;
+    GArray *stamps;
+    GArray *dirs;
+    /*! Maps icon names to GArrays of IndexFile */
+    GHashTable *icons;
+} IndexBuilder;
+
+static guint32 builder_string(IndexBuilder *b, const gchar *s)
+{
+    guint32 off = b->strings->len;
+    g_string_append_len(b->strings, s, strlen(s) + 1);
+    return off;
+}
+
+/*! Record the modification time of a path, whether or not it exists.
+  Returns TRUE if the path is a directory. */
+static gboolean builder_stamp(IndexBuilder *b, const gchar *path)
+{
+    IndexStamp st;
+    struct stat buf;
+    gboolean ret = FALSE;
+
+    memset(&st, 0, sizeof(st));
+    st.path = builder_string(b, path);
+    if (stat(path, &buf) == 0) {
+        st.mtime = buf.st_mtime;
+        ret = S_ISDIR(buf.st_mode);
+    }
+    g_array_append_val(b->stamps, st);
+    return ret;
+}
+
+/*! Add all of the icons in a directory to the index */
+static void builder_scan_dir(IndexBuilder *b, const gchar *path,
+                             guint theme, gint min_size, gint max_size)
+{
+    GDir *dir;
+    const gchar *f;
+    IndexDir d;
+    guint32 dir_i;
+
+    if (!builder_stamp(b, path) || !(dir = g_dir_open(path, 0, NULL)))
+        return;
+
+    d.path = builder_string(b, path);
+    d.theme = theme;
+    d.min_size = min_size;
+    d.max_size = max_size;
+    dir_i = b->dirs->len;
+    g_array_append_val(b->dirs, d);
+
+    while ((f = g_dir_read_name(dir))) {
+        const gchar *dot;
+        guint i;
+
+        if (!(dot = strrchr(f, '.')) || dot == f)
+            continue;
+        for (i = 0; i < G_N_ELEMENTS(extensions); ++i)
+            if (!strcmp(dot + 1, extensions[i])) {
+                IndexFile file;
+                GArray *files;
+                gchar *name;
+
+                name = g_strndup(f, dot - f);
+                files = g_hash_table_lookup(b->icons, name);
+                if (!files) {
+                    files = g_array_new(FALSE, FALSE, sizeof(IndexFile));
+                    g_hash_table_insert(b->icons, name, files);
+                }
+                else
+                    g_free(name);
+
+                file.dir = dir_i;
+                file.ext = i;
+                g_array_append_val(files, file);
+                break;
+            }
+    }
+    g_dir_close(dir);
+}
+
+/*! Find and load the index.theme file for a theme */
+static GKeyFile* builder_load_theme(IndexBuilder *b, const gchar *theme,
+                                    GSList *base_dirs)
+{
+    GKeyFile *keys = NULL;
+    GSList *it;
+
+    /* stamp every place it could be, so that installing it in a more
+       preferred place will be noticed */
+    for (it = base_dirs; it; it = g_slist_next(it)) {
+        gchar *path;
+
+        path = g_build_filename(it->data, theme, "index.theme", NULL);
+        builder_stamp(b, path);
+        if (!keys) {
+            keys = g_key_file_new();
+            /* lists in index.theme files are separated with commas */
+            g_key_file_set_list_separator(keys, ',');
+            if (!g_key_file_load_from_file(keys, path, G_KEY_FILE_NONE,
+                                           NULL))
+            {
+                g_key_file_free(keys);
+                keys = NULL;
+            }
+        }
+        g_free(path);
+    }
+    return keys;
+}
+
+static gint chain_name_cmp(gconstpointer keys, gconstpointer name)
+{
+    gchar *n;
+    gint r;
+
+    n = g_key_file_get_string((GKeyFile*)keys, "Icon Theme", "X-Obt-Name",
+                              NULL);
+    r = strcmp(n, name);
+    g_free(n);
+    return r;
+}
+
+/*! Add a theme and all the themes it inherits from to the list of themes,
+  in the order that they should be searched */
+static GSList* builder_theme_chain(IndexBuilder *b, GSList *chain,
+                                   const gchar *theme, GSList *base_dirs)
+{
+    GKeyFile *keys;
+    gchar **parents, **it;
+
+    if (g_slist_find_custom(chain, theme, chain_name_cmp))
+        return chain;
+    if (!(keys = builder_load_theme(b, theme, base_dirs)))
+        return chain;
+
+    chain = g_slist_append(chain, keys);
+    /* remember which theme this is, for the loop check above */
+    g_key_file_set_string(keys, "Icon Theme", "X-Obt-Name", theme);
+
+    parents = g_key_file_get_string_list(keys, "Icon Theme", "Inherits",
+                                         NULL, NULL);
+    for (it = parents; it && *it; ++it)
+        chain = builder_theme_chain(b, chain, g_strstrip(*it), base_dirs);
+    g_strfreev(parents);
+    return chain;
+}
+
+/*! Add all the directories of a theme to the index */
+static void builder_scan_theme(IndexBuilder *b, GKeyFile *keys, guint theme,
+                               GSList *base_dirs)
+{
+    gchar *name, **subdirs, **sit;
+    GSList *it;
+
+    name = g_key_file_get_string(keys, "Icon Theme", "X-Obt-Name", NULL);
+    subdirs = g_key_file_get_string_list(keys, "Icon Theme", "Directories",
+                                         NULL, NULL);
+    for (sit = subdirs; sit && *sit; ++sit) {
+        gint size, min, max, threshold;
+        gchar *type;
+
+        if (!g_key_file_has_group(keys, *sit))
+            continue;
+
+        size = g_key_file_get_integer(keys, *sit, "Size", NULL);
+        if (size <= 0)
+            continue;
+        type = g_key_file_get_string(keys, *sit, "Type", NULL);
+
+        /* work out which sizes the icons in the directory fit */
+        if (type && !strcmp(type, "Fixed"))
+            min = max = size;
+        else if (type && !strcmp(type, "Scalable")) {
+            min = max = size;
+            if (g_key_file_has_key(keys, *sit, "MinSize", NULL))
+                min = g_key_file_get_integer(keys, *sit, "MinSize", NULL);
+            if (g_key_file_has_key(keys, *sit, "MaxSize", NULL))
+                max = g_key_file_get_integer(keys, *sit, "MaxSize", NULL);
+        }
+        else {
+            /* Threshold is the default type */
+            threshold = 2;
+            if (g_key_file_has_key(keys, *sit, "Threshold", NULL))
+                threshold = g_key_file_get_integer(keys, *sit, "Threshold",
+                                                   NULL);
+            min = size - threshold;
+            max = size + threshold;
+        }
+        g_free(type);
+
+        for (it = base_dirs; it; it = g_slist_next(it)) {
+            gchar *path = g_build_filename(it->data, name, *sit, NULL);
+            builder_scan_dir(b, path, theme, min, max);
+            g_free(path);
+        }
+    }
+    g_strfreev(subdirs);
+    g_free(name);
+}
+
+static gint str_ptr_cmp(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(gchar *const*)a, *(gchar *const*)b);
+}
+
+/*! Scan the icon directories for a theme and return the index for them */
+static gchar* build_index(const gchar *theme, GSList *base_dirs,
+                          gsize *length)
+{
+    IndexBuilder b;
+    IndexHeader h;
+    GSList *chain, *it;
+    GArray *files;
+    GString *out;
+    GHashTableIter iter;
+    gpointer key, value;
+    gchar **names;
+    guint n_themes, i, j;
+
+    b.strings = g_string_new(NULL);
+    b.stamps = g_array_new(FALSE, FALSE, sizeof(IndexStamp));
+    b.dirs = g_array_new(FALSE, FALSE, sizeof(IndexDir));
+    b.icons = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                    (GDestroyNotify)g_array_unref);
+
+    /* the base directories themselves hold unthemed icons, and new themes
+       appear in them */
+    for (it = base_dirs; it; it = g_slist_next(it))
+        builder_stamp(&b, it->data);
+
+    chain = NULL;
+    if (theme)
+        chain = builder_theme_chain(&b, chain, theme, base_dirs);
+    if (!g_slist_find_custom(chain, FALLBACK_THEME, chain_name_cmp))
+        chain = builder_theme_chain(&b, chain, FALLBACK_THEME, base_dirs);
+
+    n_themes = 0;
+    for (it = chain; it; it = g_slist_next(it)) {
+        builder_scan_theme(&b, it->data, n_themes++, base_dirs);
+        g_key_file_free(it->data);
+    }
+    g_slist_free(chain);
+
+    /* unthemed icons come last and fit any size */
+    for (it = base_dirs; it; it = g_slist_next(it))
+        builder_scan_dir(&b, it->data, n_themes, 0, G_MAXINT32);
+
+    /* write out the index */
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, INDEX_MAGIC, sizeof(h.magic));
+    h.version = INDEX_VERSION;
+    h.n_stamps = b.stamps->len;
+    h.n_dirs = b.dirs->len;
+    h.n_icons = g_hash_table_size(b.icons);
+    h.n_files = 0;
+
+    names = g_new(gchar*, h.n_icons);
+    i = 0;
+    g_hash_table_iter_init(&iter, b.icons);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        names[i++] = key;
+        h.n_files += ((GArray*)value)->len;
+    }
+    qsort(names, h.n_icons, sizeof(gchar*), str_ptr_cmp);
+
+    h.stamps = sizeof(IndexHeader);
+    h.dirs = h.stamps + h.n_stamps * sizeof(IndexStamp);
+    h.icons = h.dirs + h.n_dirs * sizeof(IndexDir);
+    h.files = h.icons + h.n_icons * sizeof(IndexIcon);
+    h.strings = h.files + h.n_files * sizeof(IndexFile);
+
+    out = g_string_sized_new(h.strings + b.strings->len);
+    g_string_append_len(out, (gchar*)&h, sizeof(h));
+    g_string_append_len(out, b.stamps->data,
+                        h.n_stamps * sizeof(IndexStamp));
+    g_string_append_len(out, b.dirs->data, h.n_dirs * sizeof(IndexDir));
+    for (i = 0, j = 0; i < h.n_icons; ++i) {
+        IndexIcon icon;
+
+        files = g_hash_table_lookup(b.icons, names[i]);
+        icon.name = builder_string(&b, names[i]);
+        icon.first_file = j;
+        icon.n_files = files->len;
+        g_string_append_len(out, (gchar*)&icon, sizeof(icon));
+        j += files->len;
+    }
+    for (i = 0; i < h.n_icons; ++i) {
+        files = g_hash_table_lookup(b.icons, names[i]);
+        g_string_append_len(out, files->data, files->len * sizeof(IndexFile));
+    }
+    g_string_append_len(out, b.strings->str, b.strings->len);
+
+    /* now that all the strings are added, fill in the total length */
+    ((IndexHeader*)out->str)->length = out->len;
+
+    g_free(names);
+    g_hash_table_destroy(b.icons);
+    g_array_free(b.dirs, TRUE);
+    g_array_free(b.stamps, TRUE);
+    g_string_free(b.strings, TRUE);
+
+    *length = out->len;
+    return g_string_free(out, FALSE);
+}
+
+/*! Returns TRUE if the index is well formed, so that nothing in it points
+  outside of it, and all the paths it was made from are unchanged. */
+static gboolean index_valid(const gchar *index, gsize length)
+{
+    const IndexHeader *h = (const IndexHeader*)index;
+    const IndexStamp *stamps;
+    const IndexDir *dirs;
+    const IndexIcon *icons;
+    const IndexFile *files;
+    guint32 i, n_strings;
+
+    if (length < sizeof(IndexHeader) ||
+        memcmp(h->magic, INDEX_MAGIC, sizeof(h->magic)) ||
+        h->version != INDEX_VERSION ||
+        h->length != length ||
+        h->stamps != sizeof(IndexHeader) ||
+        h->dirs != h->stamps + h->n_stamps * sizeof(IndexStamp) ||
+        h->icons != h->dirs + h->n_dirs * sizeof(IndexDir) ||
+        h->files != h->icons + h->n_icons * sizeof(IndexIcon) ||
+        h->strings != h->files + h->n_files * sizeof(IndexFile) ||
+        h->strings >= length ||
+        index[length-1] != '\0')
+    {
+        return FALSE;
+    }
+    /* the last string ends at the end of the index, so any offset inside
+       the strings is the start of a terminated string */
+    n_strings = length - h->strings;
+
+    dirs = (const IndexDir*)(index + h->dirs);
+    for (i = 0; i < h->n_dirs; ++i)
+        if (dirs[i].path >= n_strings)
+            return FALSE;
+
+    icons = (const IndexIcon*)(index + h->icons);
+    for (i = 0; i < h->n_icons; ++i)
+        if (icons[i].name >= n_strings ||
+            icons[i].n_files == 0 ||
+            icons[i].first_file > h->n_files ||
+            icons[i].n_files > h->n_files - icons[i].first_file)
+        {
+            return FALSE;
+        }
+
+    files = (const IndexFile*)(index + h->files);
+    for (i = 0; i < h->n_files; ++i)
+        if (files[i].dir >= h->n_dirs ||
+            files[i].ext >= G_N_ELEMENTS(extensions))
+        {
+            return FALSE;
+        }
+
+    /* check the stamps last, as they have to look at the disk */
+    stamps = (const IndexStamp*)(index + h->stamps);
+    for (i = 0; i < h->n_stamps; ++i) {
+        struct stat buf;
+        gint64 mtime;
+
+        if (stamps[i].path >= n_strings)
+            return FALSE;
+        mtime = 0;
+        if (stat(index + h->strings + stamps[i].path, &buf) == 0)
+            mtime = buf.st_mtime;
+        if (mtime != stamps[i].mtime)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+ObtIconTheme* obt_icon_theme_new(struct _ObtPaths *p, const gchar *name)
+{
+    ObtIconTheme *t;
+    GSList *base_dirs, *it;
+    gchar *dir, *file, *c;
+
+    /* the places to look for icons, from the icon theme spec */
+    base_dirs = g_slist_append(NULL, g_build_filename(g_get_home_dir(),
+                                                      ".icons", NULL));
+    for (it = obt_paths_data_dirs(p); it; it = g_slist_next(it))
+        base_dirs = g_slist_append(base_dirs,
+                                   g_build_filename(it->data, "icons", NULL));
+    base_dirs = g_slist_append(base_dirs,
+                               g_build_filename(G_DIR_SEPARATOR_S, "usr",
+                                                "share", "pixmaps", NULL));
+
+    dir = g_build_filename(obt_paths_cache_home(p), "openbox", NULL);
+    c = g_strdup_printf("icons-%s.cache", name ? name : FALLBACK_THEME);
+    g_strdelimit(c, G_DIR_SEPARATOR_S, '_');
+    file = NULL;
+    if (obt_paths_mkdir_path(dir, 0700))
+        file = g_build_filename(dir, c, NULL);
+
+    t = obt_icon_theme_new_full(name, base_dirs, file);
+
+    g_free(c);
+    g_free(file);
+    g_free(dir);
+    for (it = base_dirs; it; it = g_slist_next(it))
+        g_free(it->data);
+    g_slist_free(base_dirs);
+    return t;
+}
+
+ObtIconTheme* obt_icon_theme_new_full(const gchar *name, GSList *base_dirs,
+                                      const gchar *cache_file)
+{
+    ObtIconTheme *t;
+    gsize length;
+
+    t = g_slice_new0(ObtIconTheme);
+    t->ref = 1;
+
+    /* use the saved index if it is still good */
+    if (cache_file && (t->mapped = g_mapped_file_new(cache_file, FALSE, NULL)))
+    {
+        t->index = g_mapped_file_get_contents(t->mapped);
+        length = g_mapped_file_get_length(t->mapped);
+        if (!t->index || !index_valid(t->index, length)) {
+            g_mapped_file_unref(t->mapped);
+            t->mapped = NULL;
+        }
+    }
+
+    if (!t->mapped) {
+        t->built = build_index(name, base_dirs, &length);
+        t->index = t->built;
+
+        /* save it for next time, and use it from the disk so that the memory
+           can be shared and paged out */
+        if (cache_file &&
+            g_file_set_contents(cache_file, t->built, length, NULL) &&
+            (t->mapped = g_mapped_file_new(cache_file, FALSE, NULL)))
+        {
+            if (g_mapped_file_get_length(t->mapped) == length) {
+                t->index = g_mapped_file_get_contents(t->mapped);
+                g_free(t->built);
+                t->built = NULL;
+            }
+            else {
+                g_mapped_file_unref(t->mapped);
+                t->mapped = NULL;
+            }
+        }
+    }
+
+    t->header = (const IndexHeader*)t->index;
+    return t;
+}
+
+void obt_icon_theme_ref(ObtIconTheme *t)
+{
+    ++t->ref;
+}
+
+void obt_icon_theme_unref(ObtIconTheme *t)
+{
+    if (t && --t->ref == 0) {
+        if (t->mapped)
+            g_mapped_file_unref(t->mapped);
+        g_free(t->built);
+        g_slice_free(ObtIconTheme, t);
+    }
+}
+
+gchar* obt_icon_theme_lookup(ObtIconTheme *t, const gchar *name, gint size)
+{
+    const IndexIcon *icons, *icon;
+    const IndexFile *files, *best;
+    const IndexDir *dirs;
+    const gchar *strings;
+    guint l, r, m, i;
+    gint c;
+    guint best_theme;
+    gint64 best_score;
+
+    g_return_val_if_fail(name != NULL, NULL);
+
+    icons = (const IndexIcon*)(t->index + t->header->icons);
+    files = (const IndexFile*)(t->index + t->header->files);
+    dirs = (const IndexDir*)(t->index + t->header->dirs);
+    strings = t->index + t->header->strings;
+
+    /* find the icon's name */
+    icon = NULL;
+    l = 0;
+    r = t->header->n_icons;
+    while (l < r) {
+        m = l + (r - l) / 2;
+        c = strcmp(name, strings + icons[m].name);
+        if (c == 0) {
+            icon = &icons[m];
+            break;
+        }
+        else if (c < 0)
+            r = m;
+        else
+            l = m + 1;
+    }
+    if (!icon)
+        return NULL;
+
+    /* only the most preferred theme with the icon in it is used.  in that
+       theme, pick the file closest to the size, and then by extension */
+    best = NULL;
+    best_theme = G_MAXUINT32;
+    best_score = 0;
+    for (i = icon->first_file; i < icon->first_file + icon->n_files; ++i) {
+        const IndexDir *d = &dirs[files[i].dir];
+        gint64 dist, score;
+
+        if (d->theme > best_theme)
+            continue;
+
+        if (size < d->min_size)
+            dist = d->min_size - size;
+        else if (size > d->max_size)
+            dist = size - d->max_size;
+        else
+            dist = 0;
+        score = dist * G_N_ELEMENTS(extensions) + files[i].ext;
+
+        if (d->theme < best_theme || score < best_score) {
+            best = &files[i];
+            best_theme = d->theme;
+            best_score = score;
+        }
+    }
+
+    return g_strdup_printf("%s/%s.%s", strings + dirs[best->dir].path, name,
+                           extensions[best->ext]);
+}
@@ -0,0 +1,65 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   obt/icontheme.h for the Openbox window manager
+   Copyright (c) 2026        agent
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef __obt_icontheme_h
+#define __obt_icontheme_h
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+struct _ObtPaths;
+
+typedef struct _ObtIconTheme ObtIconTheme;
+
+/*! Open an icon theme, following the freedesktop.org icon theme spec.
+  Icons are looked for in the theme, the themes it inherits from, the
+  "hicolor" theme, and then outside of any theme.
+
+  The icon directories are scanned once, and an index of them is saved under
+  the XDG cache home.  The next time the theme is opened, the index is mapped
+  into memory instead, unless one of the directories has been modified since
+  the index was made.
+  @param name The name of the icon theme, such as "gnome".  If NULL, only
+    "hicolor" and unthemed icons are used.
+*/
+ObtIconTheme* obt_icon_theme_new(struct _ObtPaths *p, const gchar *name);
+
+/*! Open an icon theme, as obt_icon_theme_new() does.
+  @param base_dirs A list of directories (gchar*) in which to look for themes
+    and unthemed icons, in order of preference.
+  @param cache_file The file to save the index to.  If it is NULL then the
+    index is only kept in memory.
+*/
+ObtIconTheme* obt_icon_theme_new_full(const gchar *name, GSList *base_dirs,
+                                      const gchar *cache_file);
+
+void obt_icon_theme_ref(ObtIconTheme *t);
+void obt_icon_theme_unref(ObtIconTheme *t);
+
+/*! Find the file for an icon.
+  @param name The name of the icon, without any extension, such as "firefox".
+  @param size The size in pixels that the icon will be shown at.
+  @return A newly allocated path to the file which best fits the size, or NULL
+    if the icon is not found.
+*/
+gchar* obt_icon_theme_lookup(ObtIconTheme *t, const gchar *name, gint size);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,246 @@
+#include "obt/unittest_base.h"
+
+#include "obt/icontheme.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <utime.h>
+
+static gchar *base_dir = NULL;
+
+static void write_file(const gchar *rel, const gchar *contents)
+{
+    gchar *path, *dir;
+
+    path = g_build_filename(base_dir, rel, NULL);
+    dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0700);
+    g_file_set_contents(path, contents, -1, NULL);
+    g_free(dir);
+    g_free(path);
+}
+
+static void set_up()
+{
+    base_dir = g_dir_make_tmp("obt-icontheme-XXXXXX", NULL);
+
+    write_file("hicolor/index.theme",
+               "[Icon Theme]\n"
+               "Name=Hicolor\n"
+               "Directories=16x16/apps,48x48/apps,scalable/apps\n"
+               "\n"
+               "[16x16/apps]\n"
+               "Size=16\n"
+               "Type=Fixed\n"
+               "\n"
+               "[48x48/apps]\n"
+               "Size=48\n"
+               "Type=Fixed\n"
+               "\n"
+               "[scalable/apps]\n"
+               "Size=48\n"
+               "Type=Scalable\n"
+               "MinSize=8\n"
+               "MaxSize=512\n");
+    write_file("hicolor/16x16/apps/term.png", "");
+    write_file("hicolor/48x48/apps/term.png", "");
+    write_file("hicolor/scalable/apps/editor.svg", "");
+
+    write_file("mytheme/index.theme",
+               "[Icon Theme]\n"
+               "Name=Mine\n"
+               "Inherits=hicolor\n"
+               "Directories=24x24/apps\n"
+               "\n"
+               "[24x24/apps]\n"
+               "Size=24\n");
+    write_file("mytheme/24x24/apps/term.png", "");
+
+    write_file("unthemed.xpm", "");
+}
+
+static void remove_tree(const gchar *path)
+{
+    GDir *dir;
+    const gchar *f;
+
+    if ((dir = g_dir_open(path, 0, NULL))) {
+        while ((f = g_dir_read_name(dir))) {
+            gchar *sub = g_build_filename(path, f, NULL);
+            remove_tree(sub);
+            g_free(sub);
+        }
+        g_dir_close(dir);
+    }
+    g_remove(path);
+}
+
+static void tear_down()
+{
+    remove_tree(base_dir);
+    g_free(base_dir);
+    base_dir = NULL;
+}
+
+static void expect_lookup(ObtIconTheme *t, const gchar *name, gint size,
+                          const gchar *expected_rel)
+{
+    gchar *expected, *actual;
+
+    expected = expected_rel ?
+        g_build_filename(base_dir, expected_rel, NULL) : NULL;
+    actual = obt_icon_theme_lookup(t, name, size);
+    if (!expected || !actual) {
+        EXPECT_BOOL_EQ(!!expected, !!actual);
+    }
+    else {
+        EXPECT_BOOL_EQ(TRUE, strcmp(expected, actual) == 0);
+    }
+    g_free(expected);
+    g_free(actual);
+}
+
+static void hicolor_sizes() {
+    ObtIconTheme *t;
+    GSList *dirs;
+
+    TEST_START();
+
+    set_up();
+    dirs = g_slist_append(NULL, base_dir);
+    t = obt_icon_theme_new_full(NULL, dirs, NULL);
+
+    /* exact and nearest fixed sizes */
+    expect_lookup(t, "term", 16, "hicolor/16x16/apps/term.png");
+    expect_lookup(t, "term", 20, "hicolor/16x16/apps/term.png");
+    expect_lookup(t, "term", 40, "hicolor/48x48/apps/term.png");
+    /* scalable */
+    expect_lookup(t, "editor", 128, "hicolor/scalable/apps/editor.svg");
+    /* unthemed */
+    expect_lookup(t, "unthemed", 16, "unthemed.xpm");
+    /* missing */
+    expect_lookup(t, "nothing", 16, NULL);
+
+    obt_icon_theme_unref(t);
+    g_slist_free(dirs);
+    tear_down();
+
+    TEST_END();
+}
+
+static void inherited() {
+    ObtIconTheme *t;
+    GSList *dirs;
+
+    TEST_START();
+
+    set_up();
+    dirs = g_slist_append(NULL, base_dir);
+    t = obt_icon_theme_new_full("mytheme", dirs, NULL);
+
+    /* the theme's own icon wins even at a size its parent has exactly */
+    expect_lookup(t, "term", 16, "mytheme/24x24/apps/term.png");
+    /* icons only in the parent theme are found */
+    expect_lookup(t, "editor", 16, "hicolor/scalable/apps/editor.svg");
+
+    obt_icon_theme_unref(t);
+    g_slist_free(dirs);
+    tear_down();
+
+    TEST_END();
+}
+
+static void cache_file() {
+    ObtIconTheme *t;
+    GSList *dirs;
+    gchar *cache_dir, *cache, *dir;
+    struct utimbuf times;
+
+    TEST_START();
+
+    set_up();
+    dirs = g_slist_append(NULL, base_dir);
+    /* keep the cache out of the icon directories, or writing it would make
+       the index out of date */
+    cache_dir = g_dir_make_tmp("obt-icontheme-cache-XXXXXX", NULL);
+    cache = g_build_filename(cache_dir, "test.cache", NULL);
+
+    t = obt_icon_theme_new_full(NULL, dirs, cache);
+    EXPECT_BOOL_EQ(TRUE, g_file_test(cache, G_FILE_TEST_IS_REGULAR));
+    expect_lookup(t, "term", 48, "hicolor/48x48/apps/term.png");
+    obt_icon_theme_unref(t);
+
+    /* the saved index is used again */
+    t = obt_icon_theme_new_full(NULL, dirs, cache);
+    expect_lookup(t, "term", 48, "hicolor/48x48/apps/term.png");
+    obt_icon_theme_unref(t);
+
+    /* a new icon is noticed once its directory's mtime changes */
+    write_file("hicolor/48x48/apps/new.png", "");
+    dir = g_build_filename(base_dir, "hicolor", "48x48", "apps", NULL);
+    times.actime = times.modtime = 1;
+    utime(dir, &times);
+    t = obt_icon_theme_new_full(NULL, dirs, cache);
+    expect_lookup(t, "new", 48, "hicolor/48x48/apps/new.png");
+    obt_icon_theme_unref(t);
+
+    g_free(dir);
+    g_remove(cache);
+    g_remove(cache_dir);
+    g_free(cache);
+    g_free(cache_dir);
+    g_slist_free(dirs);
+    tear_down();
+
+    TEST_END();
+}
+
+static void corrupt_cache_file() {
+    ObtIconTheme *t;
+    GSList *dirs;
+    gchar *cache_dir, *cache, *contents;
+    gsize length;
+
+    TEST_START();
+
+    set_up();
+    dirs = g_slist_append(NULL, base_dir);
+    cache_dir = g_dir_make_tmp("obt-icontheme-cache-XXXXXX", NULL);
+    cache = g_build_filename(cache_dir, "test.cache", NULL);
+
+    t = obt_icon_theme_new_full(NULL, dirs, cache);
+    obt_icon_theme_unref(t);
+
+    /* keep the header but fill everything after it with junk offsets */
+    g_file_get_contents(cache, &contents, &length, NULL);
+    memset(contents + 64, 0xff, length - 65);
+    g_file_set_contents(cache, contents, length, NULL);
+    g_free(contents);
+
+    /* the index is made again instead of being read */
+    t = obt_icon_theme_new_full(NULL, dirs, cache);
+    expect_lookup(t, "term", 48, "hicolor/48x48/apps/term.png");
+    expect_lookup(t, "editor", 16, "hicolor/scalable/apps/editor.svg");
+    obt_icon_theme_unref(t);
+
+    g_remove(cache);
+    g_remove(cache_dir);
+    g_free(cache);
+    g_free(cache_dir);
+    g_slist_free(dirs);
+    tear_down();
+
+    TEST_END();
+}
+
+void run_icontheme_unittest() {
+    unittest_start_suite("icontheme");
+
+    hicolor_sizes();
+    inherited();
+    cache_file();
+    corrupt_cache_file();
+
+    unittest_end_suite();
+}
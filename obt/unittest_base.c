@@ -9,11 +9,15 @@ const gchar* g_active_test_name = NULL;
 
 /* Add all test suites here. Keep them sorted. */
 extern void run_bsearch_unittest();
+extern void run_diskcache_unittest();
+extern void run_icontheme_unittest();
 
 gint main(gint argc, gchar **argv)
 {
     /* Add all test suites here. Keep them sorted. */
     run_bsearch_unittest();
+    run_diskcache_unittest();
+    run_icontheme_unittest();
 
     return g_test_failures == 0 ? 0 : 1;
 }
@@ -30,6 +30,8 @@
 #include "event.h"
 #include "grab.h"
 #include "prompt.h"
+#include "rootprops.h"
+#include "spatial.h"
 #include "focus.h"
 #include "focus_cycle.h"
 #include "stacking.h"
@@ -63,6 +65,12 @@
 #define CLIENT_NOPROPAGATEMASK (ButtonPressMask | ButtonReleaseMask | \
                                 ButtonMotionMask)
 
+/*! The largest size a client's icon is ever drawn at.  Window list icons are
+  limited to 96 pixels in the config, and titlebar and menu icons follow the
+  font size, so this leaves some room to spare.  Larger icons are scaled down
+  to this size when they are loaded. */
+#define CLIENT_ICON_MAX_SIZE 128
+
 typedef struct
 {
     ObClientCallback func;
@@ -183,6 +191,12 @@ void client_remove_destroy_notify_data(ObClientCallback func, gpointer data)
 }
 
 void client_set_list(void)
+{
+    root_props_dirty(OB_ROOT_PROP_CLIENT_LIST);
+    stacking_set_list();
+}
+
+void client_write_list(void)
 {
     Window *windows, *win_it;
     GList *it;
@@ -202,8 +216,6 @@ void client_set_list(void)
 
     if (windows)
         g_free(windows);
-
-    stacking_set_list();
 }
 
 void client_manage(Window window, ObPrompt *prompt)
@@ -380,15 +392,14 @@ void client_manage(Window window, ObPrompt *prompt)
             /* oldschool fullscreen windows are allowed */
             !client_is_oldfullscreen(self, &place))
         {
-            Rect *r;
+            Rect r;
 
-            r = screen_area(self->desktop, SCREEN_AREA_ALL_MONITORS, NULL);
-            if (r->x || r->y) {
-                place.x = r->x;
-                place.y = r->y;
-                ob_debug("Moving buggy app from (0,0) to (%d,%d)", r->x, r->y);
+            screen_area(self->desktop, SCREEN_AREA_ALL_MONITORS, NULL, &r);
+            if (r.x || r.y) {
+                place.x = r.x;
+                place.y = r.y;
+                ob_debug("Moving buggy app from (0,0) to (%d,%d)", r.x, r.y);
             }
-            g_slice_free(Rect, r);
         }
 
         /* make sure the window is visible. */
@@ -442,23 +453,23 @@ void client_manage(Window window, ObPrompt *prompt)
              fit the screen but it is not USSize'd or USPosition'd) */
           !client_is_oldfullscreen(self, &place))))
     {
-        Rect *a = screen_area(self->desktop, SCREEN_AREA_ONE_MONITOR, &place);
+        Rect a;
+
+        screen_area(self->desktop, SCREEN_AREA_ONE_MONITOR, &place, &a);
 
         /* get the size of the frame */
         place.width += self->frame->size.left + self->frame->size.right;
         place.height += self->frame->size.top + self->frame->size.bottom;
 
         /* fit the window inside the area */
-        place.width = MIN(place.width, a->width);
-        place.height = MIN(place.height, a->height);
+        place.width = MIN(place.width, a.width);
+        place.height = MIN(place.height, a.height);
 
         ob_debug("setting window size to %dx%d", place.width, place.height);
 
         /* get the size of the client back */
         place.width -= self->frame->size.left + self->frame->size.right;
         place.height -= self->frame->size.top + self->frame->size.bottom;
-
-        g_slice_free(Rect, a);
     }
 
     ob_debug("placing window 0x%x at %d, %d with size %d x %d. "
@@ -528,7 +539,7 @@ void client_manage(Window window, ObPrompt *prompt)
 
     /* this has to happen after we're in the client_list */
     if (STRUT_EXISTS(self->strut))
-        screen_update_areas();
+        screen_update_strut(self, self->desktop, TRUE);
 
     /* update the list hints */
     client_set_list();
@@ -626,13 +637,13 @@ void client_unmanage(ObClient *self)
     self->kill_prompt = NULL;
 
     client_list = g_list_remove(client_list, self);
-    stacking_remove(self);
+    stacking_remove(CLIENT_AS_WINDOW(self));
     window_remove(self->window);
 
     /* once the client is out of the list, update the struts to remove its
        influence */
     if (STRUT_EXISTS(self->strut))
-        screen_update_areas();
+        screen_update_strut(self, self->desktop, FALSE);
 
     client_call_notifies(self, client_destroy_notifies);
 
@@ -1147,7 +1158,7 @@ gboolean client_find_onscreen(ObClient *self, gint *x, gint *y, gint w, gint h,
     */
     found_mon = FALSE;
     for (i = 0; i < screen_num_monitors; ++i) {
-        Rect *a;
+        Rect a;
 
         if (!screen_physical_area_monitor_contains(i, &desired)) {
             if (i < screen_num_monitors - 1 || found_mon)
@@ -1155,10 +1166,10 @@ gboolean client_find_onscreen(ObClient *self, gint *x, gint *y, gint w, gint h,
 
             /* the window is not inside any monitor! so just use the first
                one */
-            a = screen_area(self->desktop, 0, NULL);
+            screen_area(self->desktop, 0, NULL, &a);
         } else {
             found_mon = TRUE;
-            a = screen_area(self->desktop, SCREEN_AREA_ONE_MONITOR, &desired);
+            screen_area(self->desktop, SCREEN_AREA_ONE_MONITOR, &desired, &a);
         }
 
         /* This makes sure windows aren't entirely outside of the screen so you
@@ -1169,14 +1180,14 @@ gboolean client_find_onscreen(ObClient *self, gint *x, gint *y, gint w, gint h,
            only limiting the application.
         */
         if (client_normal(self)) {
-            if (!self->strut.right && *x + fw/10 >= a->x + a->width - 1)
-                *x = a->x + a->width - fw/10;
-            if (!self->strut.bottom && *y + fh/10 >= a->y + a->height - 1)
-                *y = a->y + a->height - fh/10;
-            if (!self->strut.left && *x + fw*9/10 - 1 < a->x)
-                *x = a->x - fw*9/10;
-            if (!self->strut.top && *y + fh*9/10 - 1 < a->y)
-                *y = a->y - fh*9/10;
+            if (!self->strut.right && *x + fw/10 >= a.x + a.width - 1)
+                *x = a.x + a.width - fw/10;
+            if (!self->strut.bottom && *y + fh/10 >= a.y + a.height - 1)
+                *y = a.y + a.height - fh/10;
+            if (!self->strut.left && *x + fw*9/10 - 1 < a.x)
+                *x = a.x - fw*9/10;
+            if (!self->strut.top && *y + fh*9/10 - 1 < a.y)
+                *y = a.y - fh*9/10;
         }
 
         /* This here doesn't let windows even a pixel outside the
@@ -1185,15 +1196,14 @@ gboolean client_find_onscreen(ObClient *self, gint *x, gint *y, gint w, gint h,
            xterm -geometry resolution-width/2 will work fine. Trying to
            place it completely offscreen will be handled in the above code.
            Sorry for this confused comment, i am tired. */
-        if (rudel && !self->strut.left && *x < a->x) *x = a->x;
-        if (ruder && !self->strut.right && *x + fw > a->x + a->width)
-            *x = a->x + MAX(0, a->width - fw);
+        if (rudel && !self->strut.left && *x < a.x) *x = a.x;
+        if (ruder && !self->strut.right && *x + fw > a.x + a.width)
+            *x = a.x + MAX(0, a.width - fw);
 
-        if (rudet && !self->strut.top && *y < a->y) *y = a->y;
-        if (rudeb && !self->strut.bottom && *y + fh > a->y + a->height)
-            *y = a->y + MAX(0, a->height - fh);
+        if (rudet && !self->strut.top && *y < a.y) *y = a.y;
+        if (rudeb && !self->strut.bottom && *y + fh > a.y + a.height)
+            *y = a.y + MAX(0, a.height - fh);
 
-        g_slice_free(Rect, a);
     }
 
     /* get where the client should be */
@@ -2224,8 +2234,30 @@ void client_update_strut(ObClient *self)
         /* updating here is pointless while we're being mapped cuz we're not in
            the client list yet */
         if (self->frame)
-            screen_update_areas();
+            screen_update_strut(self, self->desktop, TRUE);
+    }
+}
+
+/*! Convert icon pixels from the _NET_WM_ICON byte order to ObRender's */
+static void client_icon_to_rgba(guint32 *data, guint n)
+{
+#if RrDefaultAlphaOffset == 24 && RrDefaultRedOffset == 16 && \
+    RrDefaultGreenOffset == 8 && RrDefaultBlueOffset == 0
+    /* _NET_WM_ICON is ARGB, which is exactly how ObRender stores pixels, so
+       there is nothing to convert */
+    (void)data; (void)n;
+#else
+    guint j;
+
+    /* keep the loop body free of branches so it can be vectorized */
+    for (j = 0; j < n; ++j) {
+        const guint32 p = data[j];
+        data[j] = (((p >> 24) & 0xff) << RrDefaultAlphaOffset) |
+            (((p >> 16) & 0xff) << RrDefaultRedOffset)   |
+            (((p >>  8) & 0xff) << RrDefaultGreenOffset) |
+            (((p >>  0) & 0xff) << RrDefaultBlueOffset);
     }
+#endif
 }
 
 void client_update_icons(ObClient *self)
@@ -2233,6 +2265,7 @@ void client_update_icons(ObClient *self)
     guint num;
     guint32 *data;
     guint w, h, i, j;
+    guint *offs, noffs, master;
     RrImage *img;
 
     img = NULL;
@@ -2243,7 +2276,10 @@ void client_update_icons(ObClient *self)
     grab_server(TRUE);
 
     if (OBT_PROP_GETA32(self->window, NET_WM_ICON, CARDINAL, &data, &num)) {
-        /* figure out how many valid icons are in here */
+        /* figure out how many valid icons are in here, and remember where
+           each of them starts */
+        offs = g_new(guint, num / 3 + 1);
+        noffs = 0;
         i = 0;
         while (i + 2 < num) { /* +2 is to make sure there is a w and h */
             w = data[i++];
@@ -2254,24 +2290,58 @@ void client_update_icons(ObClient *self)
                 i += w*h;
                 continue;
             }
+            offs[noffs++] = i;
+            i += w*h;
+        }
+
+        /* we never draw an icon larger than CLIENT_ICON_MAX_SIZE, so out of
+           all the icons bigger than that only keep the smallest one, to be
+           used as the master copy for scaling */
+        master = noffs;
+        for (j = 0; j < noffs; ++j) {
+            w = data[offs[j]-2];
+            h = data[offs[j]-1];
+            if (w > CLIENT_ICON_MAX_SIZE || h > CLIENT_ICON_MAX_SIZE)
+                if (master == noffs ||
+                    w*h < data[offs[master]-2] * data[offs[master]-1])
+                    master = j;
+        }
+
+        for (j = 0; j < noffs; ++j) {
+            RrPixel32 *pic;
+            gint pw, ph;
+
+            i = offs[j];
+            w = data[i-2];
+            h = data[i-1];
+            if ((w > CLIENT_ICON_MAX_SIZE || h > CLIENT_ICON_MAX_SIZE) &&
+                j != master)
+                continue;
 
             /* convert it to the right bit order for ObRender */
-            for (j = 0; j < w*h; ++j)
-                data[i+j] =
-                    (((data[i+j] >> 24) & 0xff) << RrDefaultAlphaOffset) +
-                    (((data[i+j] >> 16) & 0xff) << RrDefaultRedOffset)   +
-                    (((data[i+j] >>  8) & 0xff) << RrDefaultGreenOffset) +
-                    (((data[i+j] >>  0) & 0xff) << RrDefaultBlueOffset);
+            client_icon_to_rgba(&data[i], w*h);
+
+            /* box filter the master down to the largest size we will ever
+               need before it goes into the image cache */
+            pw = w;
+            ph = h;
+            pic = NULL;
+            if (j == master) {
+                pw = ph = CLIENT_ICON_MAX_SIZE;
+                pic = RrImageScaleData(&data[i], w, h, &pw, &ph);
+            }
 
             /* add it to the image cache as an original */
             if (!img)
-                img = RrImageNewFromData(ob_rr_icons, &data[i], w, h);
+                img = RrImageNewFromData(ob_rr_icons,
+                                         pic ? pic : &data[i], pw, ph);
             else
-                RrImageAddFromData(img, &data[i], w, h);
+                RrImageAddFromData(img, pic ? pic : &data[i], pw, ph);
 
-            i += w*h;
+            g_free(pic);
         }
 
+        g_free(offs);
         g_free(data);
     }
 
@@ -2711,8 +2781,7 @@ void client_calc_layer(ObClient *self)
     GList *it;
 
     /* skip over stuff above fullscreen layer */
-    for (it = stacking_list; it; it = g_list_next(it))
-        if (window_layer(it->data) <= OB_STACKING_LAYER_FULLSCREEN) break;
+    it = stacking_layer_top(OB_STACKING_LAYER_FULLSCREEN);
 
     /* find the windows in the fullscreen layer, and mark them not-visited */
     for (; it; it = g_list_next(it)) {
@@ -2724,8 +2793,7 @@ void client_calc_layer(ObClient *self)
     client_calc_layer_internal(self);
 
     /* skip over stuff above fullscreen layer */
-    for (it = stacking_list; it; it = g_list_next(it))
-        if (window_layer(it->data) <= OB_STACKING_LAYER_FULLSCREEN) break;
+    it = stacking_layer_top(OB_STACKING_LAYER_FULLSCREEN);
 
     /* now recalc any windows in the fullscreen layer which have not
        had their layer recalced already */
@@ -3025,28 +3093,26 @@ void client_try_configure(ObClient *self, gint *x, gint *y, gint *w, gint *h,
         user = FALSE; /* ignore if the client can't be moved/resized when it
                          is fullscreening */
     } else if (self->max_horz || self->max_vert) {
-        Rect *a;
+        Rect a;
         guint i;
 
         /* use all possible struts when maximizing to the full screen */
         i = screen_find_monitor(&desired);
-        a = screen_area(self->desktop, i,
-                        (self->max_horz && self->max_vert ? NULL : &desired));
+        screen_area(self->desktop, i,
+                    (self->max_horz && self->max_vert ? NULL : &desired), &a);
 
         /* set the size and position if maximized */
         if (self->max_horz) {
-            *x = a->x;
-            *w = a->width - self->frame->size.left - self->frame->size.right;
+            *x = a.x;
+            *w = a.width - self->frame->size.left - self->frame->size.right;
         }
         if (self->max_vert) {
-            *y = a->y;
-            *h = a->height - self->frame->size.top - self->frame->size.bottom;
+            *y = a.y;
+            *h = a.height - self->frame->size.top - self->frame->size.bottom;
         }
 
         user = FALSE; /* ignore if the client can't be moved/resized when it
                          is maximizing */
-
-        g_slice_free(Rect, a);
     }
 
     /* gets the client's position */
@@ -3770,7 +3836,7 @@ static void client_set_desktop_recursive(ObClient *self,
         if (old != DESKTOP_ALL && !dontraise)
             stacking_raise(CLIENT_AS_WINDOW(self));
         if (STRUT_EXISTS(self->strut))
-            screen_update_areas();
+            screen_update_strut(self, old, TRUE);
         else
             /* the new desktop's geometry may be different, so we may need to
                resize, for example if we are maximized */
@@ -4212,7 +4278,17 @@ void client_set_undecorated(ObClient *self, gboolean undecorated)
 
 guint client_monitor(ObClient *self)
 {
-    return screen_find_monitor(&self->frame->area);
+    if (self->monitor_serial != screen_monitors_serial ||
+        !RECT_EQUAL(self->monitor_area, self->frame->area))
+    {
+        self->monitor = screen_find_monitor(&self->frame->area);
+        self->monitor_area = self->frame->area;
+        self->monitor_serial = screen_monitors_serial;
+    }
+#ifdef DEBUG
+    g_assert(self->monitor == screen_find_monitor(&self->frame->area));
+#endif
+    return self->monitor;
 }
 
 ObClient *client_direct_parent(ObClient *self)
@@ -4417,27 +4493,27 @@ void client_find_edge_directional(ObClient *self, ObDirection dir,
                                   gint my_edge_start, gint my_edge_size,
                                   gint *dest, gboolean *near_edge)
 {
-    GList *it;
-    Rect *a;
+    GSList *targets, *it;
+    Rect a;
     Rect dock_area;
     gint edge;
     guint i;
 
-    a = screen_area(self->desktop, SCREEN_AREA_ALL_MONITORS,
-                    &self->frame->area);
+    screen_area(self->desktop, SCREEN_AREA_ALL_MONITORS,
+                &self->frame->area, &a);
 
     switch (dir) {
     case OB_DIRECTION_NORTH:
-        edge = RECT_TOP(*a) - 1;
+        edge = RECT_TOP(a) - 1;
         break;
     case OB_DIRECTION_SOUTH:
-        edge = RECT_BOTTOM(*a) + 1;
+        edge = RECT_BOTTOM(a) + 1;
         break;
     case OB_DIRECTION_EAST:
-        edge = RECT_RIGHT(*a) + 1;
+        edge = RECT_RIGHT(a) + 1;
         break;
     case OB_DIRECTION_WEST:
-        edge = RECT_LEFT(*a) - 1;
+        edge = RECT_LEFT(a) - 1;
         break;
     default:
         g_assert_not_reached();
@@ -4448,14 +4524,45 @@ void client_find_edge_directional(ObClient *self, ObDirection dir,
 
     /* search for edges of monitors */
     for (i = 0; i < screen_num_monitors; ++i) {
-        Rect *area = screen_area(self->desktop, i, NULL);
-        detect_edge(*area, dir, my_head, my_size, my_edge_start,
+        Rect area;
+        screen_area(self->desktop, i, NULL, &area);
+        detect_edge(area, dir, my_head, my_size, my_edge_start,
                     my_edge_size, dest, near_edge);
-        g_slice_free(Rect, area);
+    }
+
+    /* only clients with an edge between here and the edge found so far can
+       be bumped into */
+    switch (dir) {
+    case OB_DIRECTION_NORTH:
+        targets = spatial_find_edges(NULL, OB_SPATIAL_EDGE_BOTTOM,
+                                     *dest - my_size, my_head + my_size);
+        targets = spatial_find_edges(targets, OB_SPATIAL_EDGE_TOP,
+                                     *dest - my_size, my_head + my_size);
+        break;
+    case OB_DIRECTION_SOUTH:
+        targets = spatial_find_edges(NULL, OB_SPATIAL_EDGE_TOP,
+                                     my_head - my_size, *dest + my_size);
+        targets = spatial_find_edges(targets, OB_SPATIAL_EDGE_BOTTOM,
+                                     my_head - my_size, *dest + my_size);
+        break;
+    case OB_DIRECTION_WEST:
+        targets = spatial_find_edges(NULL, OB_SPATIAL_EDGE_RIGHT,
+                                     *dest - my_size, my_head + my_size);
+        targets = spatial_find_edges(targets, OB_SPATIAL_EDGE_LEFT,
+                                     *dest - my_size, my_head + my_size);
+        break;
+    case OB_DIRECTION_EAST:
+        targets = spatial_find_edges(NULL, OB_SPATIAL_EDGE_LEFT,
+                                     my_head - my_size, *dest + my_size);
+        targets = spatial_find_edges(targets, OB_SPATIAL_EDGE_RIGHT,
+                                     my_head - my_size, *dest + my_size);
+        break;
+    default:
+        g_assert_not_reached();
     }
 
     /* search for edges of clients */
-    for (it = client_list; it; it = g_list_next(it)) {
+    for (it = targets; it; it = g_slist_next(it)) {
         ObClient *cur = it->data;
 
         /* skip windows to not bump into */
@@ -4472,11 +4579,10 @@ void client_find_edge_directional(ObClient *self, ObDirection dir,
         detect_edge(cur->frame->area, dir, my_head, my_size, my_edge_start,
                     my_edge_size, dest, near_edge);
     }
+    g_slist_free(targets);
     dock_get_area(&dock_area);
     detect_edge(dock_area, dir, my_head, my_size, my_edge_start,
                 my_edge_size, dest, near_edge);
-
-    g_slice_free(Rect, a);
 }
 
 void client_find_move_directional(ObClient *self, ObDirection dir,
@@ -4681,33 +4787,44 @@ void client_find_resize_directional(ObClient *self,
     *h -= self->frame->size.top + self->frame->size.bottom;
 }
 
-ObClient* client_under_pointer(void)
-{
+typedef struct _ObPointSearch {
     gint x, y;
-    GList *it;
-    ObClient *ret = NULL;
+    ObClient *top;
+} ObPointSearch;
 
-    if (screen_pointer_pos(&x, &y)) {
-        for (it = stacking_list; it; it = g_list_next(it)) {
-            if (WINDOW_IS_CLIENT(it->data)) {
-                ObClient *c = WINDOW_AS_CLIENT(it->data);
-                if (c->frame->visible &&
-                    /* check the desktop, this is done during desktop
-                       switching and windows are shown/hidden status is not
-                       reliable */
-                    (c->desktop == screen_desktop ||
-                     c->desktop == DESKTOP_ALL) &&
-                    /* ignore all animating windows */
-                    !frame_iconify_animating(c->frame) &&
-                    RECT_CONTAINS(c->frame->area, x, y))
-                {
-                    ret = c;
-                    break;
-                }
-            }
-        }
+static gboolean under_point(ObClient *c, gint ring, gpointer data)
+{
+    ObPointSearch *d = data;
+
+    /* only the cell holding the point can have windows under it */
+    if (ring > 0)
+        return FALSE;
+
+    if (c->frame->visible &&
+        /* check the desktop, this is done during desktop
+           switching and windows are shown/hidden status is not
+           reliable */
+        (c->desktop == screen_desktop ||
+         c->desktop == DESKTOP_ALL) &&
+        /* ignore all animating windows */
+        !frame_iconify_animating(c->frame) &&
+        RECT_CONTAINS(c->frame->area, d->x, d->y) &&
+        (!d->top || stacking_is_above(CLIENT_AS_WINDOW(c),
+                                      CLIENT_AS_WINDOW(d->top))))
+    {
+        d->top = c;
     }
-    return ret;
+    return TRUE;
+}
+
+ObClient* client_under_pointer(void)
+{
+    ObPointSearch d;
+
+    d.top = NULL;
+    if (screen_pointer_pos(&d.x, &d.y))
+        spatial_search(d.x, d.y, under_point, &d);
+    return d.top;
 }
 
 gboolean client_has_group_siblings(ObClient *self)
@@ -82,6 +82,14 @@ struct _ObClient
     /*! The window's decorations. NULL while the window is being managed! */
     struct _ObFrame *frame;
 
+    /*! The monitor the frame was last found to be on, for client_monitor() */
+    guint monitor;
+    /*! The frame's area when the monitor was found */
+    Rect monitor_area;
+    /*! The screen_monitors_serial when the monitor was found, or 0 if it has
+      not been found yet */
+    guint monitor_serial;
+
     /*! The number of unmap events to ignore on the window */
     gint ignore_unmaps;
 
@@ -350,8 +358,11 @@ ObClient *client_fake_manage(Window win);
 /*! Free the stuff created by client_fake_manage() */
 void client_fake_unmanage(ObClient *self);
 
-/*! Sets the client list on the root window from the client_list */
+/*! Sets the client list on the root window from the client_list, the next
+  time the main loop is idle */
 void client_set_list(void);
+/*! Writes the _NET_CLIENT_LIST property, called through root_props_flush() */
+void client_write_list(void);
 
 /*! Determines if the client should be shown or hidden currently.
   @return TRUE if it should be visible; otherwise, FALSE.
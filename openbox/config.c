@@ -48,12 +48,16 @@ ObPlaceMonitor config_primary_monitor;
 StrutPartial config_margins;
 
 gchar   *config_theme;
+gchar   *config_icon_theme;
 gboolean config_theme_keepborder;
+gboolean config_theme_keep_pixels;
 guint    config_theme_window_list_icon_size;
 
 gchar   *config_title_layout;
 
 gboolean config_animate_iconify;
+guint    config_animation_rate;
+ObEasing config_animation_easing;
 
 RrFont *config_font_activewindow;
 RrFont *config_font_inactivewindow;
@@ -709,6 +713,10 @@ static void parse_theme(xmlNodePtr node, gpointer d)
         config_theme = obt_paths_expand_tilde(c);
         g_free(c);
     }
+    if ((n = obt_xml_find_node(node, "iconTheme"))) {
+        g_free(config_icon_theme);
+        config_icon_theme = obt_xml_node_string(n);
+    }
     if ((n = obt_xml_find_node(node, "titleLayout"))) {
         gchar *c, *d;
 
@@ -722,8 +730,20 @@ static void parse_theme(xmlNodePtr node, gpointer d)
     }
     if ((n = obt_xml_find_node(node, "keepBorder")))
         config_theme_keepborder = obt_xml_node_bool(n);
+    if ((n = obt_xml_find_node(node, "keepPixels")))
+        config_theme_keep_pixels = obt_xml_node_bool(n);
     if ((n = obt_xml_find_node(node, "animateIconify")))
         config_animate_iconify = obt_xml_node_bool(n);
+    if ((n = obt_xml_find_node(node, "animationRate")))
+        config_animation_rate = CLAMP(obt_xml_node_int(n), 10, 240);
+    if ((n = obt_xml_find_node(node, "animationEasing"))) {
+        if (obt_xml_node_contains(n, "EaseOut"))
+            config_animation_easing = OB_EASING_EASE_OUT;
+        else if (obt_xml_node_contains(n, "EaseInOut"))
+            config_animation_easing = OB_EASING_EASE_IN_OUT;
+        else
+            config_animation_easing = OB_EASING_LINEAR;
+    }
     if ((n = obt_xml_find_node(node, "windowListIconSize"))) {
         config_theme_window_list_icon_size = obt_xml_node_int(n);
         if (config_theme_window_list_icon_size < 16)
@@ -1111,10 +1131,14 @@ void config_startup(ObtXmlInst *i)
     obt_xml_register(i, "margins", parse_margins, NULL);
 
     config_theme = NULL;
+    config_icon_theme = g_strdup("hicolor");
 
     config_animate_iconify = TRUE;
+    config_animation_rate = 60;
+    config_animation_easing = OB_EASING_LINEAR;
     config_title_layout = g_strdup("NLIMC");
     config_theme_keepborder = TRUE;
+    config_theme_keep_pixels = FALSE;
     config_theme_window_list_icon_size = 36;
 
     config_font_activewindow = NULL;
@@ -1198,6 +1222,7 @@ void config_shutdown(void)
     GSList *it;
 
     g_free(config_theme);
+    g_free(config_icon_theme);
 
     g_free(config_title_layout);
 
@@ -147,13 +147,22 @@ extern guint config_dock_app_move_modifiers;
 
 /*! The name of the theme */
 extern gchar *config_theme;
+/*! The name of the icon theme to find menu icons in */
+extern gchar *config_icon_theme;
 
 /*! Show the one-pixel border after toggleDecor */
 extern gboolean config_theme_keepborder;
+/*! Keep the rendered pixels of decorations in memory after they are shown,
+  instead of rendering them again when they are needed */
+extern gboolean config_theme_keep_pixels;
 /*! Titlebar button layout */
 extern gchar *config_title_layout;
 /*! Animate windows iconifying and restoring */
 extern gboolean config_animate_iconify;
+/*! How many times a second animations are drawn */
+extern guint config_animation_rate;
+/*! How animations speed up and slow down */
+extern ObEasing config_animation_easing;
 /*! Size of icons in focus switching dialogs */
 extern guint config_theme_window_list_icon_size;
 
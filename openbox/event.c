@@ -1312,14 +1312,14 @@ static void event_handle_client(ObClient *client, XEvent *e)
 
             /* oldschool fullscreen windows are allowed */
             if (!client_is_oldfullscreen(client, &to)) {
-                Rect *r;
+                Rect r;
 
-                r = screen_area(client->desktop, SCREEN_AREA_ALL_MONITORS,
-                                NULL);
-                if (r->x || r->y) {
+                screen_area(client->desktop, SCREEN_AREA_ALL_MONITORS,
+                            NULL, &r);
+                if (r.x || r.y) {
                     /* move the window only to the corner outside struts */
-                    x = r->x;
-                    y = r->y;
+                    x = r.x;
+                    y = r.y;
 
                     ob_debug_type(OB_DEBUG_APP_BUGS,
                                   "Application %s is trying to move via "
@@ -1327,11 +1327,9 @@ static void event_handle_client(ObClient *client, XEvent *e)
                                   "NorthWestGravity, while there is a "
                                   "strut there. "
                                   "Moving buggy app from (0,0) to (%d,%d)",
-                                  client->title, r->x, r->y);
+                                  client->title, r.x, r.y);
                 }
 
-                g_slice_free(Rect, r);
-
                 /* they still requested a move, so don't change whether a
                    notify is sent or not */
             }
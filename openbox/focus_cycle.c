@@ -26,6 +26,7 @@
 #include "openbox.h"
 #include "debug.h"
 #include "config.h"
+#include "spatial.h"
 
 #include <X11/Xlib.h>
 #include <glib.h>
@@ -174,99 +175,138 @@ done_cycle:
 }
 
 /* this be mostly ripped from fvwm */
-static ObClient *focus_find_directional(ObClient *c, ObDirection dir,
-                                        gboolean dock_windows,
-                                        gboolean desktop_windows)
+/*! Scores how good a window is to move to from another in a direction.  The
+  smaller the better.  Returns FALSE if it is not in that direction. */
+static gboolean directional_score(ObClient *c, ObClient *cur, ObDirection dir,
+                                  gint *score)
 {
     gint my_cx, my_cy, his_cx, his_cy;
     gint offset = 0;
     gint distance = 0;
-    gint score, best_score;
-    ObClient *best_client, *cur;
-    GList *it;
-
-    if (!client_list)
-        return NULL;
 
     /* first, find the centre coords of the currently focused window */
     my_cx = c->frame->area.x + c->frame->area.width / 2;
     my_cy = c->frame->area.y + c->frame->area.height / 2;
 
-    best_score = -1;
-    best_client = c;
-
-    for (it = g_list_first(client_list); it; it = g_list_next(it)) {
-        cur = it->data;
-
-        /* the currently selected window isn't interesting */
-        if (cur == c)
-            continue;
-        if (!focus_cycle_valid(it->data))
-            continue;
-
-        /* find the centre coords of this window, from the
-         * currently focused window's point of view */
-        his_cx = (cur->frame->area.x - my_cx)
-            + cur->frame->area.width / 2;
-        his_cy = (cur->frame->area.y - my_cy)
-            + cur->frame->area.height / 2;
-
-        if (dir == OB_DIRECTION_NORTHEAST || dir == OB_DIRECTION_SOUTHEAST ||
-            dir == OB_DIRECTION_SOUTHWEST || dir == OB_DIRECTION_NORTHWEST)
-        {
-            gint tx;
-            /* Rotate the diagonals 45 degrees counterclockwise.
-             * To do this, multiply the matrix /+h +h\ with the
-             * vector (x y).                   \-h +h/
-             * h = sqrt(0.5). We can set h := 1 since absolute
-             * distance doesn't matter here. */
-            tx = his_cx + his_cy;
-            his_cy = -his_cx + his_cy;
-            his_cx = tx;
-        }
+    /* find the centre coords of this window, from the
+     * currently focused window's point of view */
+    his_cx = (cur->frame->area.x - my_cx)
+        + cur->frame->area.width / 2;
+    his_cy = (cur->frame->area.y - my_cy)
+        + cur->frame->area.height / 2;
+
+    if (dir == OB_DIRECTION_NORTHEAST || dir == OB_DIRECTION_SOUTHEAST ||
+        dir == OB_DIRECTION_SOUTHWEST || dir == OB_DIRECTION_NORTHWEST)
+    {
+        gint tx;
+        /* Rotate the diagonals 45 degrees counterclockwise.
+         * To do this, multiply the matrix /+h +h\ with the
+         * vector (x y).                   \-h +h/
+         * h = sqrt(0.5). We can set h := 1 since absolute
+         * distance doesn't matter here. */
+        tx = his_cx + his_cy;
+        his_cy = -his_cx + his_cy;
+        his_cx = tx;
+    }
 
-        switch (dir) {
-        case OB_DIRECTION_NORTH:
-        case OB_DIRECTION_SOUTH:
-        case OB_DIRECTION_NORTHEAST:
-        case OB_DIRECTION_SOUTHWEST:
-            offset = (his_cx < 0) ? -his_cx : his_cx;
-            distance = ((dir == OB_DIRECTION_NORTH ||
-                         dir == OB_DIRECTION_NORTHEAST) ?
-                        -his_cy : his_cy);
-            break;
-        case OB_DIRECTION_EAST:
-        case OB_DIRECTION_WEST:
-        case OB_DIRECTION_SOUTHEAST:
-        case OB_DIRECTION_NORTHWEST:
-            offset = (his_cy < 0) ? -his_cy : his_cy;
-            distance = ((dir == OB_DIRECTION_WEST ||
-                         dir == OB_DIRECTION_NORTHWEST) ?
-                        -his_cx : his_cx);
-            break;
-        }
+    switch (dir) {
+    case OB_DIRECTION_NORTH:
+    case OB_DIRECTION_SOUTH:
+    case OB_DIRECTION_NORTHEAST:
+    case OB_DIRECTION_SOUTHWEST:
+        offset = (his_cx < 0) ? -his_cx : his_cx;
+        distance = ((dir == OB_DIRECTION_NORTH ||
+                     dir == OB_DIRECTION_NORTHEAST) ?
+                    -his_cy : his_cy);
+        break;
+    case OB_DIRECTION_EAST:
+    case OB_DIRECTION_WEST:
+    case OB_DIRECTION_SOUTHEAST:
+    case OB_DIRECTION_NORTHWEST:
+        offset = (his_cy < 0) ? -his_cy : his_cy;
+        distance = ((dir == OB_DIRECTION_WEST ||
+                     dir == OB_DIRECTION_NORTHWEST) ?
+                    -his_cx : his_cx);
+        break;
+    }
 
-        /* the target must be in the requested direction */
-        if (distance <= 0)
-            continue;
+    /* the target must be in the requested direction */
+    if (distance <= 0)
+        return FALSE;
 
-        /* Calculate score for this window.  The smaller the better. */
-        score = (distance * config_directional_distance_weight
-                 + offset * config_directional_angle_weight);
+    /* Calculate score for this window.  The smaller the better. */
+    *score = (distance * config_directional_distance_weight
+              + offset * config_directional_angle_weight);
 
-        /* windows more than 45 degrees off the direction are
-         * heavily penalized and will only be chosen if nothing
-         * else within a million pixels */
-        if (offset > distance)
-            score += 1000000;
+    /* windows more than 45 degrees off the direction are
+     * heavily penalized and will only be chosen if nothing
+     * else within a million pixels */
+    if (offset > distance)
+        *score += 1000000;
 
-        if (best_score == -1 || score < best_score) {
-            best_client = cur;
-            best_score = score;
-        }
+    return TRUE;
+}
+
+typedef struct _ObDirectionalSearch {
+    ObClient *c;
+    ObDirection dir;
+    gint best_score;
+    ObClient *best_client;
+} ObDirectionalSearch;
+
+static gboolean directional_visit(ObClient *cur, gint ring, gpointer data)
+{
+    ObDirectionalSearch *d = data;
+    gint score;
+
+    /* a window is first reported at the ring of the nearest cell its frame
+       covers, so no part of it, and so not its centre, is in the rings
+       inside this one.  its centre is then at least this far from the
+       centre of the focused window, and if it is within 45 degrees of the
+       direction, at least this far in that direction.  the windows in
+       later rings are no closer, so once the best window found scores
+       this well, none of them can beat it, and ones further off the
+       direction score worse than it anyway */
+    if (d->best_score != -1 && d->best_score < 1000000 &&
+        d->best_score <= (gint64)config_directional_distance_weight *
+        MAX(ring - 1, 0) * SPATIAL_CELL_SIZE)
+    {
+        return FALSE;
     }
 
-    return best_client;
+    /* the currently selected window isn't interesting */
+    if (cur == d->c || !focus_cycle_valid(cur))
+        return TRUE;
+
+    if (directional_score(d->c, cur, d->dir, &score) &&
+        (d->best_score == -1 || score < d->best_score))
+    {
+        d->best_client = cur;
+        d->best_score = score;
+    }
+    return TRUE;
+}
+
+static ObClient *focus_find_directional(ObClient *c, ObDirection dir,
+                                        gboolean dock_windows,
+                                        gboolean desktop_windows)
+{
+    ObDirectionalSearch d;
+
+    if (!client_list)
+        return NULL;
+
+    d.c = c;
+    d.dir = dir;
+    d.best_score = -1;
+    d.best_client = c;
+
+    /* look at the windows nearest to the centre of this one first */
+    spatial_search(c->frame->area.x + c->frame->area.width / 2,
+                   c->frame->area.y + c->frame->area.height / 2,
+                   directional_visit, &d);
+
+    return d.best_client;
 }
 
 ObClient* focus_directional_cycle(ObDirection dir, gboolean dock_windows,
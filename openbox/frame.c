@@ -28,6 +28,7 @@
 #include "focus_cycle_indicator.h"
 #include "moveresize.h"
 #include "screen.h"
+#include "spatial.h"
 #include "obrender/theme.h"
 #include "obt/display.h"
 #include "obt/xqueue.h"
@@ -41,19 +42,113 @@
                            EnterWindowMask | LeaveWindowMask)
 
 #define FRAME_ANIMATE_ICONIFY_TIME 150000 /* .15 seconds */
-#define FRAME_ANIMATE_ICONIFY_STEP_TIME (1000 / 60) /* 60 Hz */
+#define FRAME_FLASH_TIME 600000 /* .6 seconds */
 
 #define FRAME_HANDLE_Y(f) (f->size.top + f->client->area.height + f->cbwidth_b)
 
-static void flash_done(gpointer data);
-static gboolean flash_timeout(gpointer data);
+static gboolean flash_step(ObFrame *self, const GTimeVal *now);
 
 static void layout_title(ObFrame *self);
 static void set_theme_statics(ObFrame *self);
 static void free_theme_statics(ObFrame *self);
-static gboolean frame_animate_iconify(gpointer self);
+static gboolean frame_animate_iconify(ObFrame *self, const GTimeVal *now);
+static void iconify_animation_done(ObFrame *self);
+static void clock_remove(ObFrame *self);
 static void frame_adjust_cursors(ObFrame *self);
 
+/*! What the X server has for one of the frame's windows, so that requests
+  which would not change anything are not sent */
+typedef struct _ObFrameWinState {
+    Window win;
+    gint x, y, w, h;
+    gboolean pos_known;
+    gboolean size_known;
+    gboolean map_known;
+    gboolean mapped;
+} ObFrameWinState;
+
+static guint win_hash(Window *w) { return *w; }
+static gboolean win_comp(Window *w1, Window *w2) { return *w1 == *w2; }
+
+static void win_state_free(gpointer data)
+{
+    g_slice_free(ObFrameWinState, data);
+}
+
+static ObFrameWinState* win_state(ObFrame *self, Window win)
+{
+    ObFrameWinState *s;
+
+    if (!(s = g_hash_table_lookup(self->layout, &win))) {
+        s = g_slice_new0(ObFrameWinState);
+        s->win = win;
+        g_hash_table_insert(self->layout, &s->win, s);
+    }
+    return s;
+}
+
+static void win_move_resize(ObFrame *self, Window win,
+                            gint x, gint y, gint w, gint h)
+{
+    ObFrameWinState *s = win_state(self, win);
+
+    if (!s->pos_known || !s->size_known ||
+        s->x != x || s->y != y || s->w != w || s->h != h)
+    {
+        XMoveResizeWindow(obt_display, win, x, y, w, h);
+        s->x = x;
+        s->y = y;
+        s->w = w;
+        s->h = h;
+        s->pos_known = s->size_known = TRUE;
+    }
+}
+
+static void win_move(ObFrame *self, Window win, gint x, gint y)
+{
+    ObFrameWinState *s = win_state(self, win);
+
+    if (!s->pos_known || s->x != x || s->y != y) {
+        XMoveWindow(obt_display, win, x, y);
+        s->x = x;
+        s->y = y;
+        s->pos_known = TRUE;
+    }
+}
+
+static void win_resize(ObFrame *self, Window win, gint w, gint h)
+{
+    ObFrameWinState *s = win_state(self, win);
+
+    if (!s->size_known || s->w != w || s->h != h) {
+        XResizeWindow(obt_display, win, w, h);
+        s->w = w;
+        s->h = h;
+        s->size_known = TRUE;
+    }
+}
+
+static void win_map(ObFrame *self, Window win)
+{
+    ObFrameWinState *s = win_state(self, win);
+
+    if (!s->map_known || !s->mapped) {
+        XMapWindow(obt_display, win);
+        s->mapped = s->map_known = TRUE;
+    }
+}
+
+static void win_unmap(ObFrame *self, Window win)
+{
+    ObFrameWinState *s = win_state(self, win);
+
+    if (!s->map_known || s->mapped) {
+        XUnmapWindow(obt_display, win);
+        s->mapped = FALSE;
+        s->map_known = TRUE;
+    }
+}
+
 static Window createWindow(Window parent, Visual *visual,
                            gulong mask, XSetWindowAttributes *attrib)
 {
@@ -92,6 +187,9 @@ ObFrame *frame_new(ObClient *client)
 
     self = g_slice_new0(ObFrame);
     self->client = client;
+    self->layout = g_hash_table_new_full((GHashFunc)win_hash,
+                                         (GEqualFunc)win_comp,
+                                         NULL, win_state_free);
 
     visual = check_32bit_client(client);
 
@@ -179,9 +277,9 @@ ObFrame *frame_new(ObClient *client)
     self->focused = FALSE;
 
     /* the other stuff is shown based on decor settings */
-    XMapWindow(obt_display, self->label);
-    XMapWindow(obt_display, self->backback);
-    XMapWindow(obt_display, self->backfront);
+    win_map(self, self->label);
+    win_map(self, self->backback);
+    win_map(self, self->backfront);
 
     self->max_press = self->close_press = self->desk_press =
         self->iconify_press = self->shade_press = FALSE;
@@ -200,26 +298,29 @@ ObFrame *frame_new(ObClient *client)
 static void set_theme_statics(ObFrame *self)
 {
     /* set colors/appearance/sizes for stuff that doesn't change */
-    XResizeWindow(obt_display, self->max,
-                  ob_rr_theme->button_size, ob_rr_theme->button_size);
-    XResizeWindow(obt_display, self->iconify,
-                  ob_rr_theme->button_size, ob_rr_theme->button_size);
-    XResizeWindow(obt_display, self->icon,
-                  ob_rr_theme->button_size + 2, ob_rr_theme->button_size + 2);
-    XResizeWindow(obt_display, self->close,
-                  ob_rr_theme->button_size, ob_rr_theme->button_size);
-    XResizeWindow(obt_display, self->desk,
-                  ob_rr_theme->button_size, ob_rr_theme->button_size);
-    XResizeWindow(obt_display, self->shade,
-                  ob_rr_theme->button_size, ob_rr_theme->button_size);
-    XResizeWindow(obt_display, self->tltresize,
-                  ob_rr_theme->grip_width, ob_rr_theme->paddingy + 1);
-    XResizeWindow(obt_display, self->trtresize,
-                  ob_rr_theme->grip_width, ob_rr_theme->paddingy + 1);
-    XResizeWindow(obt_display, self->tllresize,
-                  ob_rr_theme->paddingx + 1, ob_rr_theme->title_height);
-    XResizeWindow(obt_display, self->trrresize,
-                  ob_rr_theme->paddingx + 1, ob_rr_theme->title_height);
+    win_resize(self, self->max,
+               ob_rr_theme->button_size, ob_rr_theme->button_size);
+    win_resize(self, self->iconify,
+               ob_rr_theme->button_size, ob_rr_theme->button_size);
+    win_resize(self, self->icon,
+               ob_rr_theme->button_size + 2, ob_rr_theme->button_size + 2);
+    win_resize(self, self->close,
+               ob_rr_theme->button_size, ob_rr_theme->button_size);
+    win_resize(self, self->desk,
+               ob_rr_theme->button_size, ob_rr_theme->button_size);
+    win_resize(self, self->shade,
+               ob_rr_theme->button_size, ob_rr_theme->button_size);
+    win_resize(self, self->tltresize,
+               ob_rr_theme->grip_width, ob_rr_theme->paddingy + 1);
+    win_resize(self, self->trtresize,
+               ob_rr_theme->grip_width, ob_rr_theme->paddingy + 1);
+    win_resize(self, self->tllresize,
+               ob_rr_theme->paddingx + 1, ob_rr_theme->title_height);
+    win_resize(self, self->trrresize,
+               ob_rr_theme->paddingx + 1, ob_rr_theme->title_height);
+
+    /* set the solid colors again, as the theme's colors are new */
+    self->pixels_set = FALSE;
 }
 
 static void free_theme_statics(ObFrame *self)
@@ -233,6 +334,7 @@ void frame_free(ObFrame *self)
     XDestroyWindow(obt_display, self->window);
     if (self->colormap)
         XFreeColormap(obt_display, self->colormap);
+    g_hash_table_destroy(self->layout);
 
     g_slice_free(ObFrame, self);
 }
@@ -284,12 +386,16 @@ void frame_adjust_shape_kind(ObFrame *self, int kind)
 #endif
 
     if (!shaped) {
-        /* clear the shape on the frame window */
-        XShapeCombineMask(obt_display, self->window, kind,
-                          self->size.left,
-                          self->size.top,
-                          None, ShapeSet);
+        /* clear the shape on the frame window, unless it is already clear */
+        if (!(self->shape_cleared & (1 << kind)))
+            XShapeCombineMask(obt_display, self->window, kind,
+                              self->size.left,
+                              self->size.top,
+                              None, ShapeSet);
+        self->shape_cleared |= 1 << kind;
     } else {
+        self->shape_cleared &= ~(1 << kind);
+
         /* make the frame's shape match the clients */
         XShapeCombineShape(obt_display, self->window, kind,
                            self->size.left,
@@ -406,90 +512,90 @@ void frame_adjust_area(ObFrame *self, gboolean moved,
                 ob_rr_theme->grip_width - self->size.bottom;
 
             if (self->cbwidth_l) {
-                XMoveResizeWindow(obt_display, self->innerleft,
-                                  self->size.left - self->cbwidth_l,
-                                  self->size.top,
-                                  self->cbwidth_l, self->client->area.height);
+                win_move_resize(self, self->innerleft,
+                                self->size.left - self->cbwidth_l,
+                                self->size.top,
+                                self->cbwidth_l, self->client->area.height);
 
-                XMapWindow(obt_display, self->innerleft);
+                win_map(self, self->innerleft);
             } else
-                XUnmapWindow(obt_display, self->innerleft);
+                win_unmap(self, self->innerleft);
 
             if (self->cbwidth_l && innercornerheight > 0) {
-                XMoveResizeWindow(obt_display, self->innerbll,
-                                  0,
-                                  self->client->area.height - 
-                                  (ob_rr_theme->grip_width -
-                                   self->size.bottom),
-                                  self->cbwidth_l,
-                                  ob_rr_theme->grip_width - self->size.bottom);
-
-                XMapWindow(obt_display, self->innerbll);
+                win_move_resize(self, self->innerbll,
+                                0,
+                                self->client->area.height - 
+                                (ob_rr_theme->grip_width -
+                                 self->size.bottom),
+                                self->cbwidth_l,
+                                ob_rr_theme->grip_width - self->size.bottom);
+
+                win_map(self, self->innerbll);
             } else
-                XUnmapWindow(obt_display, self->innerbll);
+                win_unmap(self, self->innerbll);
 
             if (self->cbwidth_r) {
-                XMoveResizeWindow(obt_display, self->innerright,
-                                  self->size.left + self->client->area.width,
-                                  self->size.top,
-                                  self->cbwidth_r, self->client->area.height);
+                win_move_resize(self, self->innerright,
+                                self->size.left + self->client->area.width,
+                                self->size.top,
+                                self->cbwidth_r, self->client->area.height);
 
-                XMapWindow(obt_display, self->innerright);
+                win_map(self, self->innerright);
             } else
-                XUnmapWindow(obt_display, self->innerright);
+                win_unmap(self, self->innerright);
 
             if (self->cbwidth_r && innercornerheight > 0) {
-                XMoveResizeWindow(obt_display, self->innerbrr,
-                                  0,
-                                  self->client->area.height - 
-                                  (ob_rr_theme->grip_width -
-                                   self->size.bottom),
-                                  self->cbwidth_r,
-                                  ob_rr_theme->grip_width - self->size.bottom);
-
-                XMapWindow(obt_display, self->innerbrr);
+                win_move_resize(self, self->innerbrr,
+                                0,
+                                self->client->area.height - 
+                                (ob_rr_theme->grip_width -
+                                 self->size.bottom),
+                                self->cbwidth_r,
+                                ob_rr_theme->grip_width - self->size.bottom);
+
+                win_map(self, self->innerbrr);
             } else
-                XUnmapWindow(obt_display, self->innerbrr);
+                win_unmap(self, self->innerbrr);
 
             if (self->cbwidth_t) {
-                XMoveResizeWindow(obt_display, self->innertop,
-                                  self->size.left - self->cbwidth_l,
-                                  self->size.top - self->cbwidth_t,
-                                  self->client->area.width +
-                                  self->cbwidth_l + self->cbwidth_r,
-                                  self->cbwidth_t);
-
-                XMapWindow(obt_display, self->innertop);
+                win_move_resize(self, self->innertop,
+                                self->size.left - self->cbwidth_l,
+                                self->size.top - self->cbwidth_t,
+                                self->client->area.width +
+                                self->cbwidth_l + self->cbwidth_r,
+                                self->cbwidth_t);
+
+                win_map(self, self->innertop);
             } else
-                XUnmapWindow(obt_display, self->innertop);
+                win_unmap(self, self->innertop);
 
             if (self->cbwidth_b) {
-                XMoveResizeWindow(obt_display, self->innerbottom,
-                                  self->size.left - self->cbwidth_l,
-                                  self->size.top + self->client->area.height,
-                                  self->client->area.width +
-                                  self->cbwidth_l + self->cbwidth_r,
-                                  self->cbwidth_b);
-
-                XMoveResizeWindow(obt_display, self->innerblb,
-                                  0, 0,
-                                  ob_rr_theme->grip_width + self->bwidth,
-                                  self->cbwidth_b);
-                XMoveResizeWindow(obt_display, self->innerbrb,
-                                  self->client->area.width +
-                                  self->cbwidth_l + self->cbwidth_r -
-                                  (ob_rr_theme->grip_width + self->bwidth),
-                                  0,
-                                  ob_rr_theme->grip_width + self->bwidth,
-                                  self->cbwidth_b);
-
-                XMapWindow(obt_display, self->innerbottom);
-                XMapWindow(obt_display, self->innerblb);
-                XMapWindow(obt_display, self->innerbrb);
+                win_move_resize(self, self->innerbottom,
+                                self->size.left - self->cbwidth_l,
+                                self->size.top + self->client->area.height,
+                                self->client->area.width +
+                                self->cbwidth_l + self->cbwidth_r,
+                                self->cbwidth_b);
+
+                win_move_resize(self, self->innerblb,
+                                0, 0,
+                                ob_rr_theme->grip_width + self->bwidth,
+                                self->cbwidth_b);
+                win_move_resize(self, self->innerbrb,
+                                self->client->area.width +
+                                self->cbwidth_l + self->cbwidth_r -
+                                (ob_rr_theme->grip_width + self->bwidth),
+                                0,
+                                ob_rr_theme->grip_width + self->bwidth,
+                                self->cbwidth_b);
+
+                win_map(self, self->innerbottom);
+                win_map(self, self->innerblb);
+                win_map(self, self->innerbrb);
             } else {
-                XUnmapWindow(obt_display, self->innerbottom);
-                XUnmapWindow(obt_display, self->innerblb);
-                XUnmapWindow(obt_display, self->innerbrb);
+                win_unmap(self, self->innerbottom);
+                win_unmap(self, self->innerblb);
+                win_unmap(self, self->innerbrb);
             }
 
             if (self->bwidth) {
@@ -498,103 +604,103 @@ void frame_adjust_area(ObFrame *self, gboolean moved,
                 /* height of titleleft and titleright */
                 titlesides = (!self->max_horz ? ob_rr_theme->grip_width : 0);
 
-                XMoveResizeWindow(obt_display, self->titletop,
-                                  ob_rr_theme->grip_width + self->bwidth, 0,
-                                  /* width + bwidth*2 - bwidth*2 - grips*2 */
-                                  self->width - ob_rr_theme->grip_width * 2,
-                                  self->bwidth);
-                XMoveResizeWindow(obt_display, self->titletopleft,
-                                  0, 0,
-                                  ob_rr_theme->grip_width + self->bwidth,
-                                  self->bwidth);
-                XMoveResizeWindow(obt_display, self->titletopright,
-                                  self->client->area.width +
-                                  self->size.left + self->size.right -
-                                  ob_rr_theme->grip_width - self->bwidth,
-                                  0,
-                                  ob_rr_theme->grip_width + self->bwidth,
-                                  self->bwidth);
+                win_move_resize(self, self->titletop,
+                                ob_rr_theme->grip_width + self->bwidth, 0,
+                                /* width + bwidth*2 - bwidth*2 - grips*2 */
+                                self->width - ob_rr_theme->grip_width * 2,
+                                self->bwidth);
+                win_move_resize(self, self->titletopleft,
+                                0, 0,
+                                ob_rr_theme->grip_width + self->bwidth,
+                                self->bwidth);
+                win_move_resize(self, self->titletopright,
+                                self->client->area.width +
+                                self->size.left + self->size.right -
+                                ob_rr_theme->grip_width - self->bwidth,
+                                0,
+                                ob_rr_theme->grip_width + self->bwidth,
+                                self->bwidth);
 
                 if (titlesides > 0) {
-                    XMoveResizeWindow(obt_display, self->titleleft,
-                                      0, self->bwidth,
-                                      self->bwidth,
-                                      titlesides);
-                    XMoveResizeWindow(obt_display, self->titleright,
-                                      self->client->area.width +
-                                      self->size.left + self->size.right -
-                                      self->bwidth,
-                                      self->bwidth,
-                                      self->bwidth,
-                                      titlesides);
-
-                    XMapWindow(obt_display, self->titleleft);
-                    XMapWindow(obt_display, self->titleright);
+                    win_move_resize(self, self->titleleft,
+                                    0, self->bwidth,
+                                    self->bwidth,
+                                    titlesides);
+                    win_move_resize(self, self->titleright,
+                                    self->client->area.width +
+                                    self->size.left + self->size.right -
+                                    self->bwidth,
+                                    self->bwidth,
+                                    self->bwidth,
+                                    titlesides);
+
+                    win_map(self, self->titleleft);
+                    win_map(self, self->titleright);
                 } else {
-                    XUnmapWindow(obt_display, self->titleleft);
-                    XUnmapWindow(obt_display, self->titleright);
+                    win_unmap(self, self->titleleft);
+                    win_unmap(self, self->titleright);
                 }
 
-                XMapWindow(obt_display, self->titletop);
-                XMapWindow(obt_display, self->titletopleft);
-                XMapWindow(obt_display, self->titletopright);
+                win_map(self, self->titletop);
+                win_map(self, self->titletopleft);
+                win_map(self, self->titletopright);
 
                 if (self->decorations & OB_FRAME_DECOR_TITLEBAR) {
-                    XMoveResizeWindow(obt_display, self->titlebottom,
-                                      (self->max_horz ? 0 : self->bwidth),
-                                      ob_rr_theme->title_height + self->bwidth,
-                                      self->width,
-                                      self->bwidth);
+                    win_move_resize(self, self->titlebottom,
+                                    (self->max_horz ? 0 : self->bwidth),
+                                    ob_rr_theme->title_height + self->bwidth,
+                                    self->width,
+                                    self->bwidth);
 
-                    XMapWindow(obt_display, self->titlebottom);
+                    win_map(self, self->titlebottom);
                 } else
-                    XUnmapWindow(obt_display, self->titlebottom);
+                    win_unmap(self, self->titlebottom);
             } else {
-                XUnmapWindow(obt_display, self->titlebottom);
+                win_unmap(self, self->titlebottom);
 
-                XUnmapWindow(obt_display, self->titletop);
-                XUnmapWindow(obt_display, self->titletopleft);
-                XUnmapWindow(obt_display, self->titletopright);
-                XUnmapWindow(obt_display, self->titleleft);
-                XUnmapWindow(obt_display, self->titleright);
+                win_unmap(self, self->titletop);
+                win_unmap(self, self->titletopleft);
+                win_unmap(self, self->titletopright);
+                win_unmap(self, self->titleleft);
+                win_unmap(self, self->titleright);
             }
 
             if (self->decorations & OB_FRAME_DECOR_TITLEBAR) {
-                XMoveResizeWindow(obt_display, self->title,
-                                  (self->max_horz ? 0 : self->bwidth),
-                                  self->bwidth,
-                                  self->width, ob_rr_theme->title_height);
+                win_move_resize(self, self->title,
+                                (self->max_horz ? 0 : self->bwidth),
+                                self->bwidth,
+                                self->width, ob_rr_theme->title_height);
 
-                XMapWindow(obt_display, self->title);
+                win_map(self, self->title);
 
                 if (self->decorations & OB_FRAME_DECOR_GRIPS) {
-                    XMoveResizeWindow(obt_display, self->topresize,
-                                      ob_rr_theme->grip_width,
-                                      0,
-                                      self->width - ob_rr_theme->grip_width *2,
-                                      ob_rr_theme->paddingy + 1);
-
-                    XMoveWindow(obt_display, self->tltresize, 0, 0);
-                    XMoveWindow(obt_display, self->tllresize, 0, 0);
-                    XMoveWindow(obt_display, self->trtresize,
-                                self->width - ob_rr_theme->grip_width, 0);
-                    XMoveWindow(obt_display, self->trrresize,
-                                self->width - ob_rr_theme->paddingx - 1, 0);
-
-                    XMapWindow(obt_display, self->topresize);
-                    XMapWindow(obt_display, self->tltresize);
-                    XMapWindow(obt_display, self->tllresize);
-                    XMapWindow(obt_display, self->trtresize);
-                    XMapWindow(obt_display, self->trrresize);
+                    win_move_resize(self, self->topresize,
+                                    ob_rr_theme->grip_width,
+                                    0,
+                                    self->width - ob_rr_theme->grip_width *2,
+                                    ob_rr_theme->paddingy + 1);
+
+                    win_move(self, self->tltresize, 0, 0);
+                    win_move(self, self->tllresize, 0, 0);
+                    win_move(self, self->trtresize,
+                             self->width - ob_rr_theme->grip_width, 0);
+                    win_move(self, self->trrresize,
+                             self->width - ob_rr_theme->paddingx - 1, 0);
+
+                    win_map(self, self->topresize);
+                    win_map(self, self->tltresize);
+                    win_map(self, self->tllresize);
+                    win_map(self, self->trtresize);
+                    win_map(self, self->trrresize);
                 } else {
-                    XUnmapWindow(obt_display, self->topresize);
-                    XUnmapWindow(obt_display, self->tltresize);
-                    XUnmapWindow(obt_display, self->tllresize);
-                    XUnmapWindow(obt_display, self->trtresize);
-                    XUnmapWindow(obt_display, self->trrresize);
+                    win_unmap(self, self->topresize);
+                    win_unmap(self, self->tltresize);
+                    win_unmap(self, self->tllresize);
+                    win_unmap(self, self->trtresize);
+                    win_unmap(self, self->trrresize);
                 }
             } else
-                XUnmapWindow(obt_display, self->title);
+                win_unmap(self, self->title);
         }
 
         if ((self->decorations & OB_FRAME_DECOR_TITLEBAR))
@@ -605,215 +711,215 @@ void frame_adjust_area(ObFrame *self, gboolean moved,
             gint sidebwidth = self->max_horz ? 0 : self->bwidth;
 
             if (self->bwidth && self->size.bottom) {
-                XMoveResizeWindow(obt_display, self->handlebottom,
-                                  ob_rr_theme->grip_width +
-                                  self->bwidth + sidebwidth,
-                                  self->size.top + self->client->area.height +
-                                  self->size.bottom - self->bwidth,
-                                  self->width - (ob_rr_theme->grip_width +
-                                                 sidebwidth) * 2,
-                                  self->bwidth);
+                win_move_resize(self, self->handlebottom,
+                                ob_rr_theme->grip_width +
+                                self->bwidth + sidebwidth,
+                                self->size.top + self->client->area.height +
+                                self->size.bottom - self->bwidth,
+                                self->width - (ob_rr_theme->grip_width +
+                                               sidebwidth) * 2,
+                                self->bwidth);
 
 
                 if (sidebwidth) {
-                    XMoveResizeWindow(obt_display, self->lgripleft,
-                                      0,
-                                      self->size.top +
-                                      self->client->area.height +
-                                      self->size.bottom -
-                                      (!self->max_horz ?
-                                       ob_rr_theme->grip_width :
-                                       self->size.bottom - self->cbwidth_b),
-                                      self->bwidth,
-                                      (!self->max_horz ?
-                                       ob_rr_theme->grip_width :
-                                       self->size.bottom - self->cbwidth_b));
-                    XMoveResizeWindow(obt_display, self->rgripright,
-                                  self->size.left +
-                                      self->client->area.width +
-                                      self->size.right - self->bwidth,
-                                      self->size.top +
-                                      self->client->area.height +
-                                      self->size.bottom -
-                                      (!self->max_horz ?
-                                       ob_rr_theme->grip_width :
-                                       self->size.bottom - self->cbwidth_b),
-                                      self->bwidth,
-                                      (!self->max_horz ?
-                                       ob_rr_theme->grip_width :
-                                       self->size.bottom - self->cbwidth_b));
-
-                    XMapWindow(obt_display, self->lgripleft);
-                    XMapWindow(obt_display, self->rgripright);
+                    win_move_resize(self, self->lgripleft,
+                                    0,
+                                    self->size.top +
+                                    self->client->area.height +
+                                    self->size.bottom -
+                                    (!self->max_horz ?
+                                     ob_rr_theme->grip_width :
+                                     self->size.bottom - self->cbwidth_b),
+                                    self->bwidth,
+                                    (!self->max_horz ?
+                                     ob_rr_theme->grip_width :
+                                     self->size.bottom - self->cbwidth_b));
+                    win_move_resize(self, self->rgripright,
+                                self->size.left +
+                                    self->client->area.width +
+                                    self->size.right - self->bwidth,
+                                    self->size.top +
+                                    self->client->area.height +
+                                    self->size.bottom -
+                                    (!self->max_horz ?
+                                     ob_rr_theme->grip_width :
+                                     self->size.bottom - self->cbwidth_b),
+                                    self->bwidth,
+                                    (!self->max_horz ?
+                                     ob_rr_theme->grip_width :
+                                     self->size.bottom - self->cbwidth_b));
+
+                    win_map(self, self->lgripleft);
+                    win_map(self, self->rgripright);
                 } else {
-                    XUnmapWindow(obt_display, self->lgripleft);
-                    XUnmapWindow(obt_display, self->rgripright);
+                    win_unmap(self, self->lgripleft);
+                    win_unmap(self, self->rgripright);
                 }
 
-                XMoveResizeWindow(obt_display, self->lgripbottom,
-                                  sidebwidth,
-                                  self->size.top + self->client->area.height +
-                                  self->size.bottom - self->bwidth,
-                                  ob_rr_theme->grip_width + self->bwidth,
-                                  self->bwidth);
-                XMoveResizeWindow(obt_display, self->rgripbottom,
-                                  self->size.left + self->client->area.width +
-                                  self->size.right - self->bwidth - sidebwidth-
-                                  ob_rr_theme->grip_width,
-                                  self->size.top + self->client->area.height +
-                                  self->size.bottom - self->bwidth,
-                                  ob_rr_theme->grip_width + self->bwidth,
-                                  self->bwidth);
-
-                XMapWindow(obt_display, self->handlebottom);
-                XMapWindow(obt_display, self->lgripbottom);
-                XMapWindow(obt_display, self->rgripbottom);
+                win_move_resize(self, self->lgripbottom,
+                                sidebwidth,
+                                self->size.top + self->client->area.height +
+                                self->size.bottom - self->bwidth,
+                                ob_rr_theme->grip_width + self->bwidth,
+                                self->bwidth);
+                win_move_resize(self, self->rgripbottom,
+                                self->size.left + self->client->area.width +
+                                self->size.right - self->bwidth - sidebwidth-
+                                ob_rr_theme->grip_width,
+                                self->size.top + self->client->area.height +
+                                self->size.bottom - self->bwidth,
+                                ob_rr_theme->grip_width + self->bwidth,
+                                self->bwidth);
+
+                win_map(self, self->handlebottom);
+                win_map(self, self->lgripbottom);
+                win_map(self, self->rgripbottom);
 
                 if (self->decorations & OB_FRAME_DECOR_HANDLE &&
                     ob_rr_theme->handle_height > 0)
                 {
-                    XMoveResizeWindow(obt_display, self->handletop,
-                                      ob_rr_theme->grip_width +
-                                      self->bwidth + sidebwidth,
-                                      FRAME_HANDLE_Y(self),
-                                      self->width - (ob_rr_theme->grip_width +
-                                                     sidebwidth) * 2,
-                                      self->bwidth);
-                    XMapWindow(obt_display, self->handletop);
+                    win_move_resize(self, self->handletop,
+                                    ob_rr_theme->grip_width +
+                                    self->bwidth + sidebwidth,
+                                    FRAME_HANDLE_Y(self),
+                                    self->width - (ob_rr_theme->grip_width +
+                                                   sidebwidth) * 2,
+                                    self->bwidth);
+                    win_map(self, self->handletop);
 
                     if (self->decorations & OB_FRAME_DECOR_GRIPS) {
-                        XMoveResizeWindow(obt_display, self->handleleft,
-                                          ob_rr_theme->grip_width,
-                                          0,
-                                          self->bwidth,
-                                          ob_rr_theme->handle_height);
-                        XMoveResizeWindow(obt_display, self->handleright,
-                                          self->width -
-                                          ob_rr_theme->grip_width -
-                                          self->bwidth,
-                                          0,
-                                          self->bwidth,
-                                          ob_rr_theme->handle_height);
-
-                        XMoveResizeWindow(obt_display, self->lgriptop,
-                                          sidebwidth,
-                                          FRAME_HANDLE_Y(self),
-                                          ob_rr_theme->grip_width +
-                                          self->bwidth,
-                                          self->bwidth);
-                        XMoveResizeWindow(obt_display, self->rgriptop,
-                                          self->size.left +
-                                          self->client->area.width +
-                                          self->size.right - self->bwidth -
-                                          sidebwidth - ob_rr_theme->grip_width,
-                                          FRAME_HANDLE_Y(self),
-                                          ob_rr_theme->grip_width +
-                                          self->bwidth,
-                                          self->bwidth);
-
-                        XMapWindow(obt_display, self->handleleft);
-                        XMapWindow(obt_display, self->handleright);
-                        XMapWindow(obt_display, self->lgriptop);
-                        XMapWindow(obt_display, self->rgriptop);
+                        win_move_resize(self, self->handleleft,
+                                        ob_rr_theme->grip_width,
+                                        0,
+                                        self->bwidth,
+                                        ob_rr_theme->handle_height);
+                        win_move_resize(self, self->handleright,
+                                        self->width -
+                                        ob_rr_theme->grip_width -
+                                        self->bwidth,
+                                        0,
+                                        self->bwidth,
+                                        ob_rr_theme->handle_height);
+
+                        win_move_resize(self, self->lgriptop,
+                                        sidebwidth,
+                                        FRAME_HANDLE_Y(self),
+                                        ob_rr_theme->grip_width +
+                                        self->bwidth,
+                                        self->bwidth);
+                        win_move_resize(self, self->rgriptop,
+                                        self->size.left +
+                                        self->client->area.width +
+                                        self->size.right - self->bwidth -
+                                        sidebwidth - ob_rr_theme->grip_width,
+                                        FRAME_HANDLE_Y(self),
+                                        ob_rr_theme->grip_width +
+                                        self->bwidth,
+                                        self->bwidth);
+
+                        win_map(self, self->handleleft);
+                        win_map(self, self->handleright);
+                        win_map(self, self->lgriptop);
+                        win_map(self, self->rgriptop);
                     } else {
-                        XUnmapWindow(obt_display, self->handleleft);
-                        XUnmapWindow(obt_display, self->handleright);
-                        XUnmapWindow(obt_display, self->lgriptop);
-                        XUnmapWindow(obt_display, self->rgriptop);
+                        win_unmap(self, self->handleleft);
+                        win_unmap(self, self->handleright);
+                        win_unmap(self, self->lgriptop);
+                        win_unmap(self, self->rgriptop);
                     }
                 } else {
-                    XUnmapWindow(obt_display, self->handleleft);
-                    XUnmapWindow(obt_display, self->handleright);
-                    XUnmapWindow(obt_display, self->lgriptop);
-                    XUnmapWindow(obt_display, self->rgriptop);
+                    win_unmap(self, self->handleleft);
+                    win_unmap(self, self->handleright);
+                    win_unmap(self, self->lgriptop);
+                    win_unmap(self, self->rgriptop);
 
-                    XUnmapWindow(obt_display, self->handletop);
+                    win_unmap(self, self->handletop);
                 }
             } else {
-                XUnmapWindow(obt_display, self->handleleft);
-                XUnmapWindow(obt_display, self->handleright);
-                XUnmapWindow(obt_display, self->lgriptop);
-                XUnmapWindow(obt_display, self->rgriptop);
-
-                XUnmapWindow(obt_display, self->handletop);
-
-                XUnmapWindow(obt_display, self->handlebottom);
-                XUnmapWindow(obt_display, self->lgripleft);
-                XUnmapWindow(obt_display, self->rgripright);
-                XUnmapWindow(obt_display, self->lgripbottom);
-                XUnmapWindow(obt_display, self->rgripbottom);
+                win_unmap(self, self->handleleft);
+                win_unmap(self, self->handleright);
+                win_unmap(self, self->lgriptop);
+                win_unmap(self, self->rgriptop);
+
+                win_unmap(self, self->handletop);
+
+                win_unmap(self, self->handlebottom);
+                win_unmap(self, self->lgripleft);
+                win_unmap(self, self->rgripright);
+                win_unmap(self, self->lgripbottom);
+                win_unmap(self, self->rgripbottom);
             }
 
             if (self->decorations & OB_FRAME_DECOR_HANDLE &&
                 ob_rr_theme->handle_height > 0)
             {
-                XMoveResizeWindow(obt_display, self->handle,
-                                  sidebwidth,
-                                  FRAME_HANDLE_Y(self) + self->bwidth,
-                                  self->width, ob_rr_theme->handle_height);
-                XMapWindow(obt_display, self->handle);
+                win_move_resize(self, self->handle,
+                                sidebwidth,
+                                FRAME_HANDLE_Y(self) + self->bwidth,
+                                self->width, ob_rr_theme->handle_height);
+                win_map(self, self->handle);
 
                 if (self->decorations & OB_FRAME_DECOR_GRIPS) {
-                    XMoveResizeWindow(obt_display, self->lgrip,
-                                      0, 0,
-                                      ob_rr_theme->grip_width,
-                                      ob_rr_theme->handle_height);
-                    XMoveResizeWindow(obt_display, self->rgrip,
-                                      self->width - ob_rr_theme->grip_width,
-                                      0,
-                                      ob_rr_theme->grip_width,
-                                      ob_rr_theme->handle_height);
-
-                    XMapWindow(obt_display, self->lgrip);
-                    XMapWindow(obt_display, self->rgrip);
+                    win_move_resize(self, self->lgrip,
+                                    0, 0,
+                                    ob_rr_theme->grip_width,
+                                    ob_rr_theme->handle_height);
+                    win_move_resize(self, self->rgrip,
+                                    self->width - ob_rr_theme->grip_width,
+                                    0,
+                                    ob_rr_theme->grip_width,
+                                    ob_rr_theme->handle_height);
+
+                    win_map(self, self->lgrip);
+                    win_map(self, self->rgrip);
                 } else {
-                    XUnmapWindow(obt_display, self->lgrip);
-                    XUnmapWindow(obt_display, self->rgrip);
+                    win_unmap(self, self->lgrip);
+                    win_unmap(self, self->rgrip);
                 }
             } else {
-                XUnmapWindow(obt_display, self->lgrip);
-                XUnmapWindow(obt_display, self->rgrip);
+                win_unmap(self, self->lgrip);
+                win_unmap(self, self->rgrip);
 
-                XUnmapWindow(obt_display, self->handle);
+                win_unmap(self, self->handle);
             }
 
             if (self->bwidth && !self->max_horz &&
                 (self->client->area.height + self->size.top +
                  self->size.bottom) > ob_rr_theme->grip_width * 2)
             {
-                XMoveResizeWindow(obt_display, self->left,
-                                  0,
-                                  self->bwidth + ob_rr_theme->grip_width,
-                                  self->bwidth,
-                                  self->client->area.height +
-                                  self->size.top + self->size.bottom -
-                                  ob_rr_theme->grip_width * 2);
-
-                XMapWindow(obt_display, self->left);
+                win_move_resize(self, self->left,
+                                0,
+                                self->bwidth + ob_rr_theme->grip_width,
+                                self->bwidth,
+                                self->client->area.height +
+                                self->size.top + self->size.bottom -
+                                ob_rr_theme->grip_width * 2);
+
+                win_map(self, self->left);
             } else
-                XUnmapWindow(obt_display, self->left);
+                win_unmap(self, self->left);
 
             if (self->bwidth && !self->max_horz &&
                 (self->client->area.height + self->size.top +
                  self->size.bottom) > ob_rr_theme->grip_width * 2)
             {
-                XMoveResizeWindow(obt_display, self->right,
-                                  self->client->area.width + self->cbwidth_l +
-                                  self->cbwidth_r + self->bwidth,
-                                  self->bwidth + ob_rr_theme->grip_width,
-                                  self->bwidth,
-                                  self->client->area.height +
-                                  self->size.top + self->size.bottom -
-                                  ob_rr_theme->grip_width * 2);
-
-                XMapWindow(obt_display, self->right);
+                win_move_resize(self, self->right,
+                                self->client->area.width + self->cbwidth_l +
+                                self->cbwidth_r + self->bwidth,
+                                self->bwidth + ob_rr_theme->grip_width,
+                                self->bwidth,
+                                self->client->area.height +
+                                self->size.top + self->size.bottom -
+                                ob_rr_theme->grip_width * 2);
+
+                win_map(self, self->right);
             } else
-                XUnmapWindow(obt_display, self->right);
+                win_unmap(self, self->right);
 
-            XMoveResizeWindow(obt_display, self->backback,
-                              self->size.left, self->size.top,
-                              self->client->area.width,
-                              self->client->area.height);
+            win_move_resize(self, self->backback,
+                            self->size.left, self->size.top,
+                            self->client->area.width,
+                            self->client->area.height);
         }
     }
 
@@ -835,6 +941,8 @@ void frame_adjust_area(ObFrame *self, gboolean moved,
     }
 
     if (!fake) {
+        spatial_update(self->client);
+
         if (!frame_iconify_animating(self))
             /* move and resize the top level frame.
                shading can change without being moved or resized.
@@ -882,8 +990,8 @@ void frame_adjust_area(ObFrame *self, gboolean moved,
     if (resized && (self->decorations & OB_FRAME_DECOR_TITLEBAR) &&
         self->label_width)
     {
-        XResizeWindow(obt_display, self->label, self->label_width,
-                      ob_rr_theme->label_height);
+        win_resize(self, self->label, self->label_width,
+                   ob_rr_theme->label_height);
     }
 }
 
@@ -955,9 +1063,9 @@ static void frame_adjust_cursors(ObFrame *self)
 void frame_adjust_client_area(ObFrame *self)
 {
     /* adjust the window which is there to prevent flashing on unmap */
-    XMoveResizeWindow(obt_display, self->backfront, 0, 0,
-                      self->client->area.width,
-                      self->client->area.height);
+    win_move_resize(self, self->backfront, 0, 0,
+                    self->client->area.width,
+                    self->client->area.height);
 }
 
 void frame_adjust_state(ObFrame *self)
@@ -1073,8 +1181,9 @@ static gboolean find_reparent(XEvent *e, gpointer data)
 void frame_release_client(ObFrame *self)
 {
     /* if there was any animation going on, kill it */
-    if (self->iconify_animation_timer)
-        g_source_remove(self->iconify_animation_timer);
+    clock_remove(self);
+
+    spatial_remove(self->client);
 
     /* check if the app has already reparented its window away */
     if (!xqueue_exists_local(find_reparent, self)) {
@@ -1130,8 +1239,6 @@ void frame_release_client(ObFrame *self)
     window_remove(self->rgripright);
     window_remove(self->rgriptop);
     window_remove(self->rgripbottom);
-
-    if (self->flash_timer) g_source_remove(self->flash_timer);
 }
 
 /* is there anything present between us and the label? */
@@ -1249,53 +1356,53 @@ static void layout_title(ObFrame *self)
 
     /* position and map the elements */
     if (self->icon_on) {
-        XMapWindow(obt_display, self->icon);
-        XMoveWindow(obt_display, self->icon, self->icon_x,
-                    ob_rr_theme->paddingy);
+        win_map(self, self->icon);
+        win_move(self, self->icon, self->icon_x,
+                 ob_rr_theme->paddingy);
     } else
-        XUnmapWindow(obt_display, self->icon);
+        win_unmap(self, self->icon);
 
     if (self->desk_on) {
-        XMapWindow(obt_display, self->desk);
-        XMoveWindow(obt_display, self->desk, self->desk_x,
-                    ob_rr_theme->paddingy + 1);
+        win_map(self, self->desk);
+        win_move(self, self->desk, self->desk_x,
+                 ob_rr_theme->paddingy + 1);
     } else
-        XUnmapWindow(obt_display, self->desk);
+        win_unmap(self, self->desk);
 
     if (self->shade_on) {
-        XMapWindow(obt_display, self->shade);
-        XMoveWindow(obt_display, self->shade, self->shade_x,
-                    ob_rr_theme->paddingy + 1);
+        win_map(self, self->shade);
+        win_move(self, self->shade, self->shade_x,
+                 ob_rr_theme->paddingy + 1);
     } else
-        XUnmapWindow(obt_display, self->shade);
+        win_unmap(self, self->shade);
 
     if (self->iconify_on) {
-        XMapWindow(obt_display, self->iconify);
-        XMoveWindow(obt_display, self->iconify, self->iconify_x,
-                    ob_rr_theme->paddingy + 1);
+        win_map(self, self->iconify);
+        win_move(self, self->iconify, self->iconify_x,
+                 ob_rr_theme->paddingy + 1);
     } else
-        XUnmapWindow(obt_display, self->iconify);
+        win_unmap(self, self->iconify);
 
     if (self->max_on) {
-        XMapWindow(obt_display, self->max);
-        XMoveWindow(obt_display, self->max, self->max_x,
-                    ob_rr_theme->paddingy + 1);
+        win_map(self, self->max);
+        win_move(self, self->max, self->max_x,
+                 ob_rr_theme->paddingy + 1);
     } else
-        XUnmapWindow(obt_display, self->max);
+        win_unmap(self, self->max);
 
     if (self->close_on) {
-        XMapWindow(obt_display, self->close);
-        XMoveWindow(obt_display, self->close, self->close_x,
-                    ob_rr_theme->paddingy + 1);
+        win_map(self, self->close);
+        win_move(self, self->close, self->close_x,
+                 ob_rr_theme->paddingy + 1);
     } else
-        XUnmapWindow(obt_display, self->close);
+        win_unmap(self, self->close);
 
     if (self->label_on && self->label_width > 0) {
-        XMapWindow(obt_display, self->label);
-        XMoveWindow(obt_display, self->label, self->label_x,
-                    ob_rr_theme->paddingy);
+        win_map(self, self->label);
+        win_move(self, self->label, self->label_x,
+                 ob_rr_theme->paddingy);
     } else
-        XUnmapWindow(obt_display, self->label);
+        win_unmap(self, self->label);
 }
 
 gboolean frame_next_context_from_string(gchar *names, ObFrameContext *cx)
@@ -1660,79 +1767,198 @@ void frame_rect_to_client(ObFrame *self, Rect *r)
     frame_frame_gravity(self, &r->x, &r->y);
 }
 
-static void flash_done(gpointer data)
+/*! Returns how many microseconds it is from now until the given time */
+static glong time_until(const GTimeVal *t, const GTimeVal *now)
 {
-    ObFrame *self = data;
+    return (t->tv_sec - now->tv_sec) * G_USEC_PER_SEC +
+        (t->tv_usec - now->tv_usec);
+}
+
+/*! The timer which moves all of the frames' animations along together */
+static guint clock_timer = 0;
+/*! How often clock_timer fires, in milliseconds */
+static guint clock_interval = 0;
+/*! The frames which are animating (ObFrame*) */
+static GSList *clock_frames = NULL;
+
+static void clock_schedule(const GTimeVal *now);
+
+static gboolean clock_tick(gpointer data)
+{
+    GTimeVal now;
+    GSList *it, *next;
 
-    self->flash_timer = 0;
+    g_get_current_time(&now);
+
+    for (it = clock_frames; it; it = next) {
+        ObFrame *self = it->data;
+        gboolean more = FALSE;
+
+        next = g_slist_next(it);
+
+        if (self->iconify_animation_going) {
+            if (frame_animate_iconify(self, &now))
+                more = TRUE;
+            else
+                iconify_animation_done(self);
+        }
+        if (self->flash_on != self->focused || self->flashing) {
+            if (flash_step(self, &now))
+                more = TRUE;
+        }
+
+        if (!more)
+            clock_frames = g_slist_delete_link(clock_frames, it);
+    }
+
+    /* send everything for this frame of the animations at once */
+    XFlush(obt_display);
+
+    clock_schedule(&now);
+    /* clock_schedule replaces this timer if the interval changed */
+    return g_source_get_id(g_main_current_source()) == clock_timer;
 }
 
-static gboolean flash_timeout(gpointer data)
+/*! Make the clock tick as often as the animating frames need it to, or stop
+  it if nothing is animating */
+static void clock_schedule(const GTimeVal *now)
+{
+    GSList *it;
+    glong wait = G_MAXLONG;
+    guint interval;
+
+    for (it = clock_frames; it; it = g_slist_next(it)) {
+        ObFrame *f = it->data;
+
+        if (f->iconify_animation_going) {
+            wait = 0;
+            break;
+        }
+        /* flashing only needs to wake up when it is time for the next
+           flash */
+        wait = MIN(wait, MAX(time_until(&f->flash_next, now), 0));
+    }
+
+    if (!clock_frames)
+        interval = 0;
+    else
+        interval = MAX((guint)(wait / 1000),
+                       1000 / config_animation_rate);
+
+    if (interval != clock_interval || !clock_timer) {
+        if (clock_timer)
+            g_source_remove(clock_timer);
+        clock_timer = 0;
+        clock_interval = interval;
+        if (clock_frames)
+            clock_timer = g_timeout_add(interval, clock_tick, NULL);
+    }
+}
+
+static void clock_add(ObFrame *self)
+{
+    GTimeVal now;
+
+    if (!g_slist_find(clock_frames, self))
+        clock_frames = g_slist_prepend(clock_frames, self);
+    g_get_current_time(&now);
+    clock_schedule(&now);
+}
+
+static void clock_remove(ObFrame *self)
 {
-    ObFrame *self = data;
     GTimeVal now;
 
+    clock_frames = g_slist_remove(clock_frames, self);
     g_get_current_time(&now);
-    if (now.tv_sec > self->flash_end.tv_sec ||
-        (now.tv_sec == self->flash_end.tv_sec &&
-         now.tv_usec >= self->flash_end.tv_usec))
+    clock_schedule(&now);
+}
+
+/*! Returns TRUE if the frame needs to keep flashing */
+static gboolean flash_step(ObFrame *self, const GTimeVal *now)
+{
+    if (time_until(&self->flash_end, now) <= 0)
         self->flashing = FALSE;
 
     if (!self->flashing) {
-        if (self->focused != self->flash_on)
+        if (self->focused != self->flash_on) {
             frame_adjust_focus(self, self->focused);
-
+            self->flash_on = self->focused;
+        }
         return FALSE; /* we are done */
     }
 
+    /* not time for the next flash yet */
+    if (time_until(&self->flash_next, now) > 0)
+        return TRUE;
+
     self->flash_on = !self->flash_on;
     if (!self->focused) {
         frame_adjust_focus(self, self->flash_on);
         self->focused = FALSE;
     }
 
+    self->flash_next = *now;
+    g_time_val_add(&self->flash_next, FRAME_FLASH_TIME);
     return TRUE; /* go again */
 }
 
 void frame_flash_start(ObFrame *self)
 {
-    self->flash_on = self->focused;
+    GTimeVal now;
 
-    if (!self->flashing)
-        self->flash_timer = g_timeout_add_full(G_PRIORITY_DEFAULT,
-                                               600, flash_timeout, self,
-                                               flash_done);
-    g_get_current_time(&self->flash_end);
+    g_get_current_time(&now);
+    if (!self->flashing) {
+        self->flash_on = self->focused;
+        /* the first flash happens after one period, as it did when each
+           frame had its own timer */
+        self->flash_next = now;
+        g_time_val_add(&self->flash_next, FRAME_FLASH_TIME);
+    }
+    self->flash_end = now;
     g_time_val_add(&self->flash_end, G_USEC_PER_SEC * 5);
 
     self->flashing = TRUE;
+    clock_add(self);
 }
 
 void frame_flash_stop(ObFrame *self)
 {
     self->flashing = FALSE;
+    /* put the focus back the way it belongs on the next tick */
+    if (self->flash_on != self->focused) {
+        g_get_current_time(&self->flash_next);
+        clock_add(self);
+    }
+}
+
+/*! Returns how far along the animation should appear to be, for the fraction
+  of its time that has passed */
+static gdouble ease(gdouble t)
+{
+    switch (config_animation_easing) {
+    case OB_EASING_LINEAR:
+        return t;
+    case OB_EASING_EASE_OUT:
+        return 1.0 - (1.0 - t) * (1.0 - t);
+    case OB_EASING_EASE_IN_OUT:
+        return t < 0.5 ? 2.0 * t * t : 1.0 - 2.0 * (1.0 - t) * (1.0 - t);
+    }
+    g_assert_not_reached();
+    return t;
 }
 
 static gulong frame_animate_iconify_time_left(ObFrame *self,
                                               const GTimeVal *now)
 {
-    glong sec, usec;
-    sec = self->iconify_animation_end.tv_sec - now->tv_sec;
-    usec = self->iconify_animation_end.tv_usec - now->tv_usec;
-    if (usec < 0) {
-        usec += G_USEC_PER_SEC;
-        sec--;
-    }
     /* no negative values */
-    return MAX(sec * G_USEC_PER_SEC + usec, 0);
+    return MAX(time_until(&self->iconify_animation_end, now), 0);
 }
 
-static gboolean frame_animate_iconify(gpointer p)
+static gboolean frame_animate_iconify(ObFrame *self, const GTimeVal *now)
 {
-    ObFrame *self = p;
     gint x, y, w, h;
     gint iconx, icony, iconw;
-    GTimeVal now;
     gulong time;
     gboolean iconifying;
 
@@ -1753,8 +1979,7 @@ static gboolean frame_animate_iconify(gpointer p)
     iconifying = self->iconify_animation_going > 0;
 
     /* how far do we have left to go ? */
-    g_get_current_time(&now);
-    time = frame_animate_iconify_time_left(self, &now);
+    time = frame_animate_iconify_time_left(self, now);
 
     if ((time > 0 && iconifying) || (time == 0 && !iconifying)) {
         /* start where the frame is supposed to be */
@@ -1772,7 +1997,7 @@ static gboolean frame_animate_iconify(gpointer p)
 
     if (time > 0) {
         glong dx, dy, dw;
-        glong elapsed;
+        gdouble done;
 
         dx = self->area.x - iconx;
         dy = self->area.y - icony;
@@ -1780,25 +2005,21 @@ static gboolean frame_animate_iconify(gpointer p)
          /* if restoring, we move in the opposite direction */
         if (!iconifying) { dx = -dx; dy = -dy; dw = -dw; }
 
-        elapsed = FRAME_ANIMATE_ICONIFY_TIME - time;
-        x = x - (dx * elapsed) / FRAME_ANIMATE_ICONIFY_TIME;
-        y = y - (dy * elapsed) / FRAME_ANIMATE_ICONIFY_TIME;
-        w = w - (dw * elapsed) / FRAME_ANIMATE_ICONIFY_TIME;
+        done = ease((gdouble)(FRAME_ANIMATE_ICONIFY_TIME - time) /
+                    FRAME_ANIMATE_ICONIFY_TIME);
+        x = x - dx * done;
+        y = y - dy * done;
+        w = w - dw * done;
         h = self->size.top; /* just the titlebar */
     }
 
     XMoveResizeWindow(obt_display, self->window, x, y, w, h);
-    XFlush(obt_display);
 
     return time > 0; /* repeat until we're out of time */
 }
 
-void frame_end_iconify_animation(gpointer data)
+static void iconify_animation_done(ObFrame *self)
 {
-    ObFrame *self = data;
-    /* see if there is an animation going */
-    if (self->iconify_animation_going == 0) return;
-
     if (!self->visible)
         XUnmapWindow(obt_display, self->window);
     else {
@@ -1812,13 +2033,23 @@ void frame_end_iconify_animation(gpointer data)
 
     /* we're not animating any more ! */
     self->iconify_animation_going = 0;
-    self->iconify_animation_timer = 0;
 
     XMoveResizeWindow(obt_display, self->window,
                       self->area.x, self->area.y,
                       self->area.width, self->area.height);
     /* we delay re-rendering until after we're done animating */
     framerender_frame(self);
+}
+
+void frame_end_iconify_animation(gpointer data)
+{
+    ObFrame *self = data;
+    /* see if there is an animation going */
+    if (self->iconify_animation_going == 0) return;
+
+    iconify_animation_done(self);
+    if (!self->flashing && self->flash_on == self->focused)
+        clock_remove(self);
     XFlush(obt_display);
 }
 
@@ -1858,20 +2089,14 @@ void frame_begin_iconify_animation(ObFrame *self, gboolean iconifying)
     }
 
     if (new_anim) {
-        if (self->iconify_animation_timer)
-            g_source_remove(self->iconify_animation_timer);
-        self->iconify_animation_timer =
-            g_timeout_add_full(G_PRIORITY_DEFAULT,
-                               FRAME_ANIMATE_ICONIFY_STEP_TIME,
-                               frame_animate_iconify, self,
-                               frame_end_iconify_animation);
-                               
+        clock_add(self);
 
         /* do the first step */
-        frame_animate_iconify(self);
+        frame_animate_iconify(self, &now);
 
         /* show it during the animation even if it is not "visible" */
         if (!self->visible)
             XMapWindow(obt_display, self->window);
+        XFlush(obt_display);
     }
 }
@@ -145,6 +145,13 @@ struct _ObFrame
 
     Colormap  colormap;
 
+    /*! The geometry and mapped state of the frame's windows, as they were
+      last sent to the X server (ObFrameWinState*) */
+    GHashTable *layout;
+    /*! The shape kinds which are known to be cleared on the frame window, as
+      bits of (1 << kind) */
+    guint     shape_cleared;
+
     gint      icon_on;    /* if the window icon button is on */
     gint      label_on;   /* if the window title is on */
     gint      iconify_on; /* if the window iconify button is on */
@@ -189,17 +196,23 @@ struct _ObFrame
     gboolean  focused;
     gboolean  need_render;
 
+    /* the colors last given to the solid border windows, so they are only
+       set again when they change */
+    gboolean  pixels_set;
+    gulong    cb_pixel;
+    gulong    border_pixel;
+    gulong    separator_pixel;
+
     gboolean  flashing;
     gboolean  flash_on;
     GTimeVal  flash_end;
-    guint     flash_timer;
+    GTimeVal  flash_next; /*!< When the frame flashes next */
 
     /*! Is the frame currently in an animation for iconify or restore.
       0 means that it is not animating. > 0 means it is animating an iconify.
       < 0 means it is animating a restore.
     */
     gint iconify_animation_going;
-    guint iconify_animation_timer;
     GTimeVal  iconify_animation_end;
 };
 
@@ -24,16 +24,57 @@
 #include "framerender.h"
 #include "obrender/theme.h"
 
-static void framerender_label(ObFrame *self, RrAppearance *a);
-static void framerender_icon(ObFrame *self, RrAppearance *a);
-static void framerender_max(ObFrame *self, RrAppearance *a);
-static void framerender_iconify(ObFrame *self, RrAppearance *a);
-static void framerender_desk(ObFrame *self, RrAppearance *a);
-static void framerender_shade(ObFrame *self, RrAppearance *a);
-static void framerender_close(ObFrame *self, RrAppearance *a);
+static void framerender_label(ObFrame *self, RrPaintBatch *b,
+                              RrAppearance *a);
+static void framerender_icon(ObFrame *self, RrPaintBatch *b,
+                             RrAppearance *a);
+static void framerender_max(ObFrame *self, RrPaintBatch *b,
+                            RrAppearance *a);
+static void framerender_iconify(ObFrame *self, RrPaintBatch *b,
+                                RrAppearance *a);
+static void framerender_desk(ObFrame *self, RrPaintBatch *b,
+                             RrAppearance *a);
+static void framerender_shade(ObFrame *self, RrPaintBatch *b,
+                              RrAppearance *a);
+static void framerender_close(ObFrame *self, RrPaintBatch *b,
+                              RrAppearance *a);
+
+/*! The batch that frames are being painted into, while one is open */
+static RrPaintBatch *batch = NULL;
+static guint batch_depth = 0;
+
+void framerender_batch_begin(void)
+{
+    if (batch_depth++ == 0)
+        batch = RrPaintBatchNew(ob_rr_inst);
+}
+
+void framerender_batch_end(void)
+{
+    g_assert(batch_depth > 0);
+
+    if (--batch_depth == 0) {
+        RrPaintBatchRun(batch);
+        batch = NULL;
+        XFlush(obt_display);
+    }
+}
+
+/*! Set the background color of some windows and show it */
+static void framerender_solid(Window *w, guint n, gulong px)
+{
+    guint i;
+
+    for (i = 0; i < n; ++i) {
+        XSetWindowBackground(obt_display, w[i], px);
+        XClearWindow(obt_display, w[i]);
+    }
+}
 
 void framerender_frame(ObFrame *self)
 {
+    RrPaintBatch *b;
+
     if (frame_iconify_animating(self))
         return; /* delay redrawing until the animation is done */
     if (!self->need_render)
@@ -49,24 +90,18 @@ void framerender_frame(ObFrame *self)
               RrColorPixel(ob_rr_theme->cb_focused_color) :
               RrColorPixel(ob_rr_theme->cb_unfocused_color));
 
-        XSetWindowBackground(obt_display, self->backback, px);
-        XClearWindow(obt_display, self->backback);
-        XSetWindowBackground(obt_display, self->innerleft, px);
-        XClearWindow(obt_display, self->innerleft);
-        XSetWindowBackground(obt_display, self->innertop, px);
-        XClearWindow(obt_display, self->innertop);
-        XSetWindowBackground(obt_display, self->innerright, px);
-        XClearWindow(obt_display, self->innerright);
-        XSetWindowBackground(obt_display, self->innerbottom, px);
-        XClearWindow(obt_display, self->innerbottom);
-        XSetWindowBackground(obt_display, self->innerbll, px);
-        XClearWindow(obt_display, self->innerbll);
-        XSetWindowBackground(obt_display, self->innerbrr, px);
-        XClearWindow(obt_display, self->innerbrr);
-        XSetWindowBackground(obt_display, self->innerblb, px);
-        XClearWindow(obt_display, self->innerblb);
-        XSetWindowBackground(obt_display, self->innerbrb, px);
-        XClearWindow(obt_display, self->innerbrb);
+        /* the solid pieces keep their color on the X server, so they are only
+           set when it changes */
+        if (!self->pixels_set || px != self->cb_pixel) {
+            Window w[] = { self->backback,
+                           self->innerleft, self->innertop,
+                           self->innerright, self->innerbottom,
+                           self->innerbll, self->innerbrr,
+                           self->innerblb, self->innerbrb };
+
+            framerender_solid(w, sizeof(w) / sizeof(w[0]), px);
+            self->cb_pixel = px;
+        }
 
         px = RrColorPixel(self->focused ?
             (self->client->undecorated ?
@@ -76,44 +111,21 @@ void framerender_frame(ObFrame *self)
              ob_rr_theme->frame_undecorated_unfocused_border_color :
              ob_rr_theme->frame_unfocused_border_color));
 
-        XSetWindowBackground(obt_display, self->left, px);
-        XClearWindow(obt_display, self->left);
-        XSetWindowBackground(obt_display, self->right, px);
-        XClearWindow(obt_display, self->right);
-
-        XSetWindowBackground(obt_display, self->titleleft, px);
-        XClearWindow(obt_display, self->titleleft);
-        XSetWindowBackground(obt_display, self->titletop, px);
-        XClearWindow(obt_display, self->titletop);
-        XSetWindowBackground(obt_display, self->titletopleft, px);
-        XClearWindow(obt_display, self->titletopleft);
-        XSetWindowBackground(obt_display, self->titletopright, px);
-        XClearWindow(obt_display, self->titletopright);
-        XSetWindowBackground(obt_display, self->titleright, px);
-        XClearWindow(obt_display, self->titleright);
-
-        XSetWindowBackground(obt_display, self->handleleft, px);
-        XClearWindow(obt_display, self->handleleft);
-        XSetWindowBackground(obt_display, self->handletop, px);
-        XClearWindow(obt_display, self->handletop);
-        XSetWindowBackground(obt_display, self->handleright, px);
-        XClearWindow(obt_display, self->handleright);
-        XSetWindowBackground(obt_display, self->handlebottom, px);
-        XClearWindow(obt_display, self->handlebottom);
-
-        XSetWindowBackground(obt_display, self->lgripleft, px);
-        XClearWindow(obt_display, self->lgripleft);
-        XSetWindowBackground(obt_display, self->lgriptop, px);
-        XClearWindow(obt_display, self->lgriptop);
-        XSetWindowBackground(obt_display, self->lgripbottom, px);
-        XClearWindow(obt_display, self->lgripbottom);
-
-        XSetWindowBackground(obt_display, self->rgripright, px);
-        XClearWindow(obt_display, self->rgripright);
-        XSetWindowBackground(obt_display, self->rgriptop, px);
-        XClearWindow(obt_display, self->rgriptop);
-        XSetWindowBackground(obt_display, self->rgripbottom, px);
-        XClearWindow(obt_display, self->rgripbottom);
+        if (!self->pixels_set || px != self->border_pixel) {
+            Window w[] = { self->left, self->right,
+                           self->titleleft, self->titletop,
+                           self->titletopleft, self->titletopright,
+                           self->titleright,
+                           self->handleleft, self->handletop,
+                           self->handleright, self->handlebottom,
+                           self->lgripleft, self->lgriptop,
+                           self->lgripbottom,
+                           self->rgripright, self->rgriptop,
+                           self->rgripbottom };
+
+            framerender_solid(w, sizeof(w) / sizeof(w[0]), px);
+            self->border_pixel = px;
+        }
 
         /* don't use the separator color for shaded windows */
         if (!self->client->shaded)
@@ -121,10 +133,20 @@ void framerender_frame(ObFrame *self)
                   RrColorPixel(ob_rr_theme->title_separator_focused_color) :
                   RrColorPixel(ob_rr_theme->title_separator_unfocused_color));
 
-        XSetWindowBackground(obt_display, self->titlebottom, px);
-        XClearWindow(obt_display, self->titlebottom);
+        if (!self->pixels_set || px != self->separator_pixel) {
+            framerender_solid(&self->titlebottom, 1, px);
+            self->separator_pixel = px;
+        }
+
+        self->pixels_set = TRUE;
     }
 
+    /* the title, handle and their pieces are rendered together, and sent to
+       the X server once they are all done.  if other frames are being
+       painted at the same time then they all go in one batch */
+    framerender_batch_begin();
+    b = batch;
+
     if (self->decorations & OB_FRAME_DECOR_TITLEBAR) {
         RrAppearance *t, *l, *m, *n, *i, *d, *s, *c, *clear;
         if (self->focused) {
@@ -244,37 +266,42 @@ void framerender_frame(ObFrame *self)
         }
         clear = ob_rr_theme->a_clear;
 
-        RrPaint(t, self->title, self->width, ob_rr_theme->title_height);
+        RrPaintBatchAdd(b, t, self->title,
+                        self->width, ob_rr_theme->title_height);
 
         clear->surface.parent = t;
         clear->surface.parenty = 0;
 
         clear->surface.parentx = ob_rr_theme->grip_width;
 
-        RrPaint(clear, self->topresize,
-                self->width - ob_rr_theme->grip_width * 2,
-                ob_rr_theme->paddingy + 1);
+        RrPaintBatchAdd(b, clear, self->topresize,
+                        self->width - ob_rr_theme->grip_width * 2,
+                        ob_rr_theme->paddingy + 1);
 
         clear->surface.parentx = 0;
 
         if (ob_rr_theme->grip_width > 0)
-            RrPaint(clear, self->tltresize,
-                    ob_rr_theme->grip_width, ob_rr_theme->paddingy + 1);
+            RrPaintBatchAdd(b, clear, self->tltresize,
+                            ob_rr_theme->grip_width,
+                            ob_rr_theme->paddingy + 1);
         if (ob_rr_theme->title_height > 0)
-            RrPaint(clear, self->tllresize,
-                    ob_rr_theme->paddingx + 1, ob_rr_theme->title_height);
+            RrPaintBatchAdd(b, clear, self->tllresize,
+                            ob_rr_theme->paddingx + 1,
+                            ob_rr_theme->title_height);
 
         clear->surface.parentx = self->width - ob_rr_theme->grip_width;
 
         if (ob_rr_theme->grip_width > 0)
-            RrPaint(clear, self->trtresize,
-                    ob_rr_theme->grip_width, ob_rr_theme->paddingy + 1);
+            RrPaintBatchAdd(b, clear, self->trtresize,
+                            ob_rr_theme->grip_width,
+                            ob_rr_theme->paddingy + 1);
 
         clear->surface.parentx = self->width - (ob_rr_theme->paddingx + 1);
 
         if (ob_rr_theme->title_height > 0)
-            RrPaint(clear, self->trrresize,
-                    ob_rr_theme->paddingx + 1, ob_rr_theme->title_height);
+            RrPaintBatchAdd(b, clear, self->trrresize,
+                            ob_rr_theme->paddingx + 1,
+                            ob_rr_theme->title_height);
 
         /* set parents for any parent relative guys */
         l->surface.parent = t;
@@ -305,13 +332,13 @@ void framerender_frame(ObFrame *self)
         c->surface.parentx = self->close_x;
         c->surface.parenty = ob_rr_theme->paddingy + 1;
 
-        framerender_label(self, l);
-        framerender_max(self, m);
-        framerender_icon(self, n);
-        framerender_iconify(self, i);
-        framerender_desk(self, d);
-        framerender_shade(self, s);
-        framerender_close(self, c);
+        framerender_label(self, b, l);
+        framerender_max(self, b, m);
+        framerender_icon(self, b, n);
+        framerender_iconify(self, b, i);
+        framerender_desk(self, b, d);
+        framerender_shade(self, b, s);
+        framerender_close(self, b, c);
     }
 
     if (self->decorations & OB_FRAME_DECOR_HANDLE &&
@@ -322,7 +349,8 @@ void framerender_frame(ObFrame *self)
         h = (self->focused ?
              ob_rr_theme->a_focused_handle : ob_rr_theme->a_unfocused_handle);
 
-        RrPaint(h, self->handle, self->width, ob_rr_theme->handle_height);
+        RrPaintBatchAdd(b, h, self->handle,
+                        self->width, ob_rr_theme->handle_height);
 
         if (self->decorations & OB_FRAME_DECOR_GRIPS) {
             g = (self->focused ?
@@ -334,29 +362,34 @@ void framerender_frame(ObFrame *self)
             g->surface.parentx = 0;
             g->surface.parenty = 0;
 
-            RrPaint(g, self->lgrip,
-                    ob_rr_theme->grip_width, ob_rr_theme->handle_height);
+            RrPaintBatchAdd(b, g, self->lgrip,
+                            ob_rr_theme->grip_width,
+                            ob_rr_theme->handle_height);
 
             g->surface.parentx = self->width - ob_rr_theme->grip_width;
             g->surface.parenty = 0;
 
-            RrPaint(g, self->rgrip,
-                    ob_rr_theme->grip_width, ob_rr_theme->handle_height);
+            RrPaintBatchAdd(b, g, self->rgrip,
+                            ob_rr_theme->grip_width,
+                            ob_rr_theme->handle_height);
         }
     }
 
-    XFlush(obt_display);
+    framerender_batch_end();
 }
 
-static void framerender_label(ObFrame *self, RrAppearance *a)
+static void framerender_label(ObFrame *self, RrPaintBatch *b,
+                              RrAppearance *a)
 {
     if (!self->label_on) return;
     /* set the texture's text! */
     a->texture[0].data.text.string = self->client->title;
-    RrPaint(a, self->label, self->label_width, ob_rr_theme->label_height);
+    RrPaintBatchAdd(b, a, self->label,
+                    self->label_width, ob_rr_theme->label_height);
 }
 
-static void framerender_icon(ObFrame *self, RrAppearance *a)
+static void framerender_icon(ObFrame *self, RrPaintBatch *b,
+                             RrAppearance *a)
 {
     RrImage *icon;
 
@@ -374,39 +407,47 @@ static void framerender_icon(ObFrame *self, RrAppearance *a)
         a->texture[0].type = RR_TEXTURE_NONE;
     }
 
-    RrPaint(a, self->icon,
-            ob_rr_theme->button_size + 2, ob_rr_theme->button_size + 2);
+    RrPaintBatchAdd(b, a, self->icon,
+                    ob_rr_theme->button_size + 2,
+                    ob_rr_theme->button_size + 2);
 }
 
-static void framerender_max(ObFrame *self, RrAppearance *a)
+static void framerender_max(ObFrame *self, RrPaintBatch *b,
+                            RrAppearance *a)
 {
     if (!self->max_on) return;
-    RrPaint(a, self->max, ob_rr_theme->button_size, ob_rr_theme->button_size);
+    RrPaintBatchAddStatic(b, a, self->max,
+                          ob_rr_theme->button_size, ob_rr_theme->button_size);
 }
 
-static void framerender_iconify(ObFrame *self, RrAppearance *a)
+static void framerender_iconify(ObFrame *self, RrPaintBatch *b,
+                                RrAppearance *a)
 {
     if (!self->iconify_on) return;
-    RrPaint(a, self->iconify,
-            ob_rr_theme->button_size, ob_rr_theme->button_size);
+    RrPaintBatchAddStatic(b, a, self->iconify,
+                          ob_rr_theme->button_size, ob_rr_theme->button_size);
 }
 
-static void framerender_desk(ObFrame *self, RrAppearance *a)
+static void framerender_desk(ObFrame *self, RrPaintBatch *b,
+                             RrAppearance *a)
 {
     if (!self->desk_on) return;
-    RrPaint(a, self->desk, ob_rr_theme->button_size, ob_rr_theme->button_size);
+    RrPaintBatchAddStatic(b, a, self->desk,
+                          ob_rr_theme->button_size, ob_rr_theme->button_size);
 }
 
-static void framerender_shade(ObFrame *self, RrAppearance *a)
+static void framerender_shade(ObFrame *self, RrPaintBatch *b,
+                              RrAppearance *a)
 {
     if (!self->shade_on) return;
-    RrPaint(a, self->shade,
-            ob_rr_theme->button_size, ob_rr_theme->button_size);
+    RrPaintBatchAddStatic(b, a, self->shade,
+                          ob_rr_theme->button_size, ob_rr_theme->button_size);
 }
 
-static void framerender_close(ObFrame *self, RrAppearance *a)
+static void framerender_close(ObFrame *self, RrPaintBatch *b,
+                              RrAppearance *a)
 {
     if (!self->close_on) return;
-    RrPaint(a, self->close,
-            ob_rr_theme->button_size, ob_rr_theme->button_size);
+    RrPaintBatchAddStatic(b, a, self->close,
+                          ob_rr_theme->button_size, ob_rr_theme->button_size);
 }
@@ -23,4 +23,12 @@ struct _ObFrame;
 
 void framerender_frame(struct _ObFrame *self);
 
+/*! Paint the frames drawn from now until framerender_batch_end() together.
+  The title and handle of a single frame are not big enough to keep many
+  threads busy, so when lots of frames are redrawn at once they should all
+  be rendered in one go.  These calls can be nested. */
+void framerender_batch_begin(void);
+/*! Finish painting the frames drawn since framerender_batch_begin() */
+void framerender_batch_end(void);
+
 #endif
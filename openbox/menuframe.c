@@ -51,6 +51,7 @@ static guint submenu_hide_timer = 0;
 static ObMenuEntryFrame* menu_entry_frame_new(ObMenuEntry *entry,
                                               ObMenuFrame *frame);
 static void menu_entry_frame_free(ObMenuEntryFrame *self);
+static void menu_entry_frame_render(ObMenuEntryFrame *self);
 static void menu_frame_update(ObMenuFrame *self);
 static gboolean submenu_show_timeout(gpointer data);
 static void menu_frame_hide(ObMenuFrame *self);
@@ -78,6 +79,28 @@ static void client_dest(ObClient *client, gpointer data)
     }
 }
 
+static void icon_loaded(RrImage *image, gpointer data)
+{
+    GList *it, *eit;
+
+    /* redraw any visible menu entries that show the image which was just
+       loaded */
+    for (it = menu_frame_visible; it; it = g_list_next(it)) {
+        ObMenuFrame *f = it->data;
+        for (eit = f->entries; eit; eit = g_list_next(eit)) {
+            ObMenuEntryFrame *e = eit->data;
+            RrImage *icon = NULL;
+
+            if (e->entry->type == OB_MENU_ENTRY_TYPE_NORMAL)
+                icon = e->entry->data.normal.icon;
+            else if (e->entry->type == OB_MENU_ENTRY_TYPE_SUBMENU)
+                icon = e->entry->data.submenu.icon;
+            if (icon && icon->set == image->set)
+                menu_entry_frame_render(e);
+        }
+    }
+}
+
 void menu_frame_startup(gboolean reconfig)
 {
     gint i;
@@ -93,6 +116,7 @@ void menu_frame_startup(gboolean reconfig)
     if (reconfig) return;
 
     client_add_destroy_notify(client_dest, NULL);
+    RrImageCacheSetLoadedFunc(ob_rr_icons, icon_loaded, NULL);
     menu_frame_map = g_hash_table_new(g_int_hash, g_int_equal);
 }
 
@@ -103,6 +127,7 @@ void menu_frame_shutdown(gboolean reconfig)
     if (reconfig) return;
 
     client_remove_destroy_notify(client_dest);
+    RrImageCacheSetLoadedFunc(ob_rr_icons, NULL, NULL);
     g_hash_table_destroy(menu_frame_map);
 }
 
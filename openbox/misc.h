@@ -63,6 +63,13 @@ typedef enum
     OB_DIRECTION_NORTHWEST
 } ObDirection;
 
+typedef enum
+{
+    OB_EASING_LINEAR,
+    OB_EASING_EASE_OUT,
+    OB_EASING_EASE_IN_OUT
+} ObEasing;
+
 typedef enum
 {
     OB_ORIENTATION_HORZ,
@@ -42,6 +42,8 @@
 #include "config.h"
 #include "ping.h"
 #include "prompt.h"
+#include "rootprops.h"
+#include "spatial.h"
 #include "gettext.h"
 #include "obrender/render.h"
 #include "obrender/theme.h"
@@ -51,6 +53,7 @@
 #include "obt/prop.h"
 #include "obt/keyboard.h"
 #include "obt/xml.h"
+#include "obt/paths.h"
 
 #ifdef HAVE_FCNTL_H
 #  include <fcntl.h>
@@ -185,6 +188,22 @@ gint main(gint argc, gchar **argv)
        and the alt-tab icon
     */
     ob_rr_icons = RrImageCacheNew(3);
+    /* keep decoded icons on disk so they don't need decoding at startup */
+    {
+        ObtPaths *p;
+        gchar *dir, *file;
+
+        p = obt_paths_new();
+        dir = g_build_filename(obt_paths_cache_home(p), "openbox", NULL);
+        obt_paths_unref(p);
+
+        if (obt_paths_mkdir_path(dir, 0700)) {
+            file = g_build_filename(dir, "images.cache", NULL);
+            RrImageCacheSetDiskCache(ob_rr_icons, file);
+            g_free(file);
+        }
+        g_free(dir);
+    }
 
     XSynchronize(obt_display, xsync);
 
@@ -296,6 +315,12 @@ gint main(gint argc, gchar **argv)
 
                 OBT_PROP_SETS(obt_root(ob_screen), OB_THEME,
                               ob_rr_theme->name);
+
+                RrSetReleasePixelData(ob_rr_inst, !config_theme_keep_pixels);
+
+                /* menu icons are shown at the height of the menu's text */
+                RrImageCacheSetIconTheme(ob_rr_icons, config_icon_theme,
+                                         ob_rr_theme->menu_font_height);
             }
 
             if (reconfigure) {
@@ -311,11 +336,14 @@ gint main(gint argc, gchar **argv)
             /* focus_backup is used for stacking, so this needs to come before
                anything that calls stacking_add */
             sn_startup(reconfigure);
+            root_props_startup(reconfigure);
             window_startup(reconfigure);
             focus_startup(reconfigure);
             focus_cycle_startup(reconfigure);
             focus_cycle_indicator_startup(reconfigure);
             focus_cycle_popup_startup(reconfigure);
+            /* screen_startup sets the size of the spatial grid */
+            spatial_startup(reconfigure);
             screen_startup(reconfigure);
             grab_startup(reconfigure);
             group_startup(reconfigure);
@@ -351,6 +379,7 @@ gint main(gint argc, gchar **argv)
                 GList *it;
 
                 /* redecorate all existing windows */
+                framerender_batch_begin();
                 for (it = client_list; it; it = g_list_next(it)) {
                     ObClient *c = it->data;
 
@@ -362,6 +391,7 @@ gint main(gint argc, gchar **argv)
                        end up in new positions */
                     client_reconfigure(c, FALSE);
                 }
+                framerender_batch_end();
             }
 
             ob_set_state(OB_STATE_RUNNING);
@@ -388,9 +418,16 @@ gint main(gint argc, gchar **argv)
                 xmlprompt = NULL;
             }
 
+            ob_debug("Not keeping %lu KB of rendered pixels in memory",
+                     (gulong)(RrPixelDataReleased(ob_rr_inst) / 1024));
+
             if (!reconfigure)
                 window_unmanage_all();
 
+            /* save the menu icons before the menus are destroyed */
+            RrImageCacheSave(ob_rr_icons);
+
+            root_props_shutdown(reconfigure);
             prompt_shutdown(reconfigure);
             menu_shutdown(reconfigure);
             menu_frame_shutdown(reconfigure);
@@ -403,6 +440,7 @@ gint main(gint argc, gchar **argv)
             group_shutdown(reconfigure);
             grab_shutdown(reconfigure);
             screen_shutdown(reconfigure);
+            spatial_shutdown(reconfigure);
             focus_cycle_popup_shutdown(reconfigure);
             focus_cycle_indicator_shutdown(reconfigure);
             focus_cycle_shutdown(reconfigure);
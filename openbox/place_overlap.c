@@ -24,6 +24,118 @@
 #include <glib.h>
 #include <stdlib.h>
 
+/* The client rects are summed up in tables over the distinct coordinates
+   of their edges, so that the overlap of a proposed rect with all of them
+   can be found with a few binary searches instead of by looking at each
+   one.  The area is found from a summed-area table of how many client
+   rects cover each point, and the number of client rects overlapped is
+   found by counting the ones which are entirely to one side of the
+   proposed rect.
+
+   The whole tables would grow with the square of the number of client
+   rects, so only a few rows of them are kept at a time.  The proposed
+   rects are tried from left to right, so each row that is looked at is
+   made by sweeping on from the one before it, which only needs the
+   corners of the client rects at the x edges in between. */
+
+typedef enum {
+    CORNER_TOP_LEFT,
+    CORNER_TOP_RIGHT,
+    CORNER_BOTTOM_LEFT,
+    CORNER_BOTTOM_RIGHT,
+    NUM_CORNERS
+} Corner;
+
+/* A corner of a client rect, at one of the x edges */
+typedef struct _CornerEvent {
+    /* The index of its y edge */
+    int y;
+    Corner corner;
+} CornerEvent;
+
+/* The row of the tables for the x edge at index x, which sums up the
+   corners of the client rects at it and at every x edge left of it.  Each
+   array has an entry for each y edge, except for corners, which has one
+   more. */
+typedef struct _TableRow {
+    /* -1 before the first x edge */
+    int x;
+    /* The client rects that start minus the ones that stop covering cells
+       at each y edge, summed over the x edges so far */
+    int* column;
+    /* cover is the number of client rects covering the cell to the bottom
+       right of the point (x_edges[x], y_edges[j]), area is the sum of the
+       client rects' areas above and to the left of it, and area_dx and
+       area_dy are how fast area grows when moving right or down from it. */
+    int* cover;
+    gint64* area;
+    gint64* area_dx;
+    gint64* area_dy;
+    /* The number of client rects whose corner c is at or left of
+       x_edges[x] and at each y edge, and corners[c][j] is the number which
+       are also above y_edges[j]. */
+    int* corner_column[NUM_CORNERS];
+    int* corners[NUM_CORNERS];
+} TableRow;
+
+/* The rows of the tables which the proposed rects over a Span of x need,
+   for the edges before its past_start, before_end and past_end */
+typedef struct _SpanRows {
+    TableRow past_start;
+    TableRow before_end;
+    TableRow past_end;
+} SpanRows;
+
+typedef struct _OverlapTables {
+    /* All of the client rects, for looking at them one by one */
+    const Rect* rects;
+    int n_all;
+    /* Client rects with a positive width and height */
+    int n_rects;
+    /* The distinct x and y coordinates of their edges, sorted */
+    int n_x;
+    int n_y;
+    int* x_edges;
+    int* y_edges;
+    /* The corners of the client rects at x_edges[i] are events[k] for
+       first_event[i] <= k < first_event[i + 1] */
+    CornerEvent* events;
+    int* first_event;
+    /* The row for the last x edge, which sums up all of them */
+    TableRow all;
+    /* Client rects which are checked one by one, because they have no
+       area */
+    Rect* flat;
+    int n_flat;
+} OverlapTables;
+
+/* Where the sides of a proposed rect fall among the edges of the client
+   rects on one axis.  The same spans are proposed many times over, so
+   they are found once up front. */
+typedef struct _Span {
+    int start;
+    int end;
+    /* The number of edges less than start + 1, end and end + 1 */
+    int past_start;
+    int before_end;
+    int past_end;
+} Span;
+
+static void make_tables(const Rect* client_rects,
+                        int n_client_rects,
+                        OverlapTables* t);
+
+static void free_tables(OverlapTables* t);
+
+static void make_span_rows(const OverlapTables* t,
+                           SpanRows* rows);
+
+static void sweep_span_rows(const OverlapTables* t,
+                            const Span* x,
+                            SpanRows* rows);
+
+static void free_span_rows(SpanRows* rows);
+
 static void make_grid(const Rect* client_rects,
                       int n_client_rects,
                       const Rect* monitor,
@@ -31,22 +143,35 @@ static void make_grid(const Rect* client_rects,
                       int* y_edges,
                       int max_edges);
 
+static void make_spans(const OverlapTables* t,
+                       const int* edges,
+                       int n_edges,
+                       int size,
+                       gboolean x_axis,
+                       Span* spans);
+
 static int best_direction(const Point* grid_point,
-                          const Rect* client_rects,
-                          int n_client_rects,
+                          const OverlapTables* tables,
+                          const Span* x_spans,
+                          const SpanRows* x_rows,
+                          const Span* y_spans,
                           const Rect* monitor,
                           const Size* req_size,
                           Point* best_top_left);
 
-static int total_overlap(const Rect* client_rects,
-                         int n_client_rects,
+static int total_overlap(const OverlapTables* tables,
+                         const Span* x_span,
+                         const SpanRows* x_rows,
+                         const Span* y_span,
                          const Rect* proposed_rect);
 
+static int rect_overlap(const OverlapTables* tables,
+                        const Rect* proposed_rect);
+
 static void center_in_field(Point* grid_point,
                             const Size* req_size,
                             const Rect *monitor,
-                            const Rect* client_rects,
-                            int n_client_rects,
+                            const OverlapTables* tables,
                             const int* x_edges,
                             const int* y_edges,
                             int max_edges);
@@ -67,10 +192,24 @@ void place_overlap_find_least_placement(const Rect* client_rects,
     int y_edges[max_edges];
     make_grid(client_rects, n_client_rects, monitor,
             x_edges, y_edges, max_edges);
+    OverlapTables tables;
+    make_tables(client_rects, n_client_rects, &tables);
+    /* the rects proposed at each grid edge start at it or end at it */
+    Span x_spans[2 * max_edges];
+    Span y_spans[2 * max_edges];
+    make_spans(&tables, x_edges, max_edges, req_size->width, TRUE, x_spans);
+    make_spans(&tables, y_edges, max_edges, req_size->height, FALSE,
+               y_spans);
+    /* and both kinds of spans move right with the grid edge */
+    SpanRows x_rows[2];
+    make_span_rows(&tables, &x_rows[0]);
+    make_span_rows(&tables, &x_rows[1]);
     int i;
     for (i = 0; i < max_edges; ++i) {
         if (x_edges[i] == G_MAXINT)
             break;
+        sweep_span_rows(&tables, &x_spans[2 * i], &x_rows[0]);
+        sweep_span_rows(&tables, &x_spans[2 * i + 1], &x_rows[1]);
         int j;
         for (j = 0; j < max_edges; ++j) {
             if (y_edges[j] == G_MAXINT)
@@ -78,7 +217,8 @@ void place_overlap_find_least_placement(const Rect* client_rects,
             Point grid_point = {.x = x_edges[i], .y = y_edges[j]};
             Point best_top_left;
             int this_overlap =
-                best_direction(&grid_point, client_rects, n_client_rects,
+                best_direction(&grid_point, &tables,
+                        &x_spans[2 * i], x_rows, &y_spans[2 * j],
                         monitor, req_size, &best_top_left);
             if (this_overlap < overlap) {
                 overlap = this_overlap;
@@ -90,16 +230,18 @@ void place_overlap_find_least_placement(const Rect* client_rects,
         if (overlap == 0)
             break;
     }
+    free_span_rows(&x_rows[0]);
+    free_span_rows(&x_rows[1]);
     if (config_place_center && overlap == 0) {
         center_in_field(result,
                         req_size,
                         monitor,
-                        client_rects,
-                        n_client_rects,
+                        &tables,
                         x_edges,
                         y_edges,
                         max_edges);
     }
+    free_tables(&tables);
 }
 
 static int compare_ints(const void* a,
@@ -110,8 +252,9 @@ static int compare_ints(const void* a,
     return *ia - *ib;
 }
 
-static void uniquify(int* edges,
-                     int n_edges)
+/* Returns the number of distinct edges */
+static int uniquify(int* edges,
+                    int n_edges)
 {
     int i = 0;
     int j = 0;
@@ -122,9 +265,11 @@ static void uniquify(int* edges,
         while (j < n_edges && edges[j] == last)
             ++j;
     }
+    int n_unique = i;
     /* fill the rest with nonsense */
     for (; i < n_edges; ++i)
         edges[i] = G_MAXINT;
+    return n_unique;
 }
 
 static void make_grid(const Rect* client_rects,
@@ -156,22 +301,376 @@ static void make_grid(const Rect* client_rects,
     uniquify(y_edges, n_edges);
 }
 
-static int total_overlap(const Rect* client_rects,
-                         int n_client_rects,
+/* Returns the number of edges less than VALUE, which is also the index of
+   VALUE if it is one of the edges. */
+static int count_less(const int* edges,
+                      int n_edges,
+                      int value)
+{
+    BSEARCH_SETUP();
+    BSEARCH(int, edges, 0, n_edges, value);
+
+    if (BSEARCH_FOUND())
+        return BSEARCH_AT();
+    if (BSEARCH_FOUND_NEAREST_SMALLER())
+        return BSEARCH_AT() + 1;
+    return 0;
+}
+
+static void make_row(const OverlapTables* t,
+                     TableRow* row)
+{
+    int c;
+
+    row->x = -1;
+    row->column = g_new0(int, t->n_y);
+    row->cover = g_new0(int, t->n_y);
+    row->area = g_new0(gint64, t->n_y);
+    row->area_dx = g_new0(gint64, t->n_y);
+    row->area_dy = g_new0(gint64, t->n_y);
+    for (c = 0; c < NUM_CORNERS; ++c) {
+        row->corner_column[c] = g_new0(int, t->n_y);
+        row->corners[c] = g_new0(int, t->n_y + 1);
+    }
+}
+
+static void free_row(TableRow* row)
+{
+    int c;
+
+    g_free(row->column);
+    g_free(row->cover);
+    g_free(row->area);
+    g_free(row->area_dx);
+    g_free(row->area_dy);
+    for (c = 0; c < NUM_CORNERS; ++c) {
+        g_free(row->corner_column[c]);
+        g_free(row->corners[c]);
+    }
+}
+
+/* Move ROW on to the x edge at index X, which must not be left of it */
+static void sweep_row(const OverlapTables* t,
+                      TableRow* row,
+                      int x)
+{
+    const int n_y = t->n_y;
+    int j, k, c;
+
+    while (row->x < x) {
+        int i = ++row->x;
+
+        /* the area grows down by what was covered between the edges */
+        if (i > 0) {
+            gint64 dx = t->x_edges[i] - t->x_edges[i - 1];
+            for (j = 0; j < n_y; ++j)
+                row->area_dy[j] += row->cover[j] * dx;
+        }
+
+        for (k = t->first_event[i]; k < t->first_event[i + 1]; ++k) {
+            const CornerEvent* e = &t->events[k];
+            /* a rect starts covering cells at its top left corner and
+               stops at the others, this marks where and is summed up
+               below */
+            if (e->corner == CORNER_TOP_LEFT ||
+                e->corner == CORNER_BOTTOM_RIGHT)
+                row->column[e->y] += 1;
+            else
+                row->column[e->y] -= 1;
+            row->corner_column[e->corner][e->y] += 1;
+        }
+
+        for (j = 0; j < n_y; ++j) {
+            row->cover[j] = row->column[j];
+            if (j > 0)
+                row->cover[j] += row->cover[j - 1];
+
+            row->area_dx[j] = j == 0 ? 0 :
+                row->area_dx[j - 1] + (gint64)row->cover[j - 1] *
+                (t->y_edges[j] - t->y_edges[j - 1]);
+            row->area[j] = j == 0 ? 0 :
+                row->area[j - 1] + row->area_dy[j - 1] *
+                (t->y_edges[j] - t->y_edges[j - 1]);
+        }
+
+        for (c = 0; c < NUM_CORNERS; ++c)
+            for (j = 0; j < n_y; ++j)
+                row->corners[c][j + 1] =
+                    row->corners[c][j] + row->corner_column[c][j];
+    }
+}
+
+static void make_tables(const Rect* client_rects,
+                        int n_client_rects,
+                        OverlapTables* t)
+{
+    int i, c;
+
+    t->rects = client_rects;
+    t->n_all = n_client_rects;
+    t->n_rects = 0;
+    t->x_edges = g_new(int, 2 * n_client_rects + 1);
+    t->y_edges = g_new(int, 2 * n_client_rects + 1);
+    t->flat = g_new(Rect, n_client_rects + 1);
+    t->n_flat = 0;
+    for (i = 0; i < n_client_rects; ++i) {
+        const Rect* r = &client_rects[i];
+        if (r->width <= 0 || r->height <= 0) {
+            t->flat[t->n_flat++] = *r;
+            continue;
+        }
+        t->x_edges[2 * t->n_rects] = r->x;
+        t->x_edges[2 * t->n_rects + 1] = r->x + r->width;
+        t->y_edges[2 * t->n_rects] = r->y;
+        t->y_edges[2 * t->n_rects + 1] = r->y + r->height;
+        ++t->n_rects;
+    }
+    qsort(t->x_edges, 2 * t->n_rects, sizeof(int), compare_ints);
+    t->n_x = uniquify(t->x_edges, 2 * t->n_rects);
+    qsort(t->y_edges, 2 * t->n_rects, sizeof(int), compare_ints);
+    t->n_y = uniquify(t->y_edges, 2 * t->n_rects);
+
+    /* sort the corners by their x edge, first counting how many are at
+       each one */
+    t->events = g_new(CornerEvent, NUM_CORNERS * t->n_rects + 1);
+    t->first_event = g_new0(int, t->n_x + 2);
+    for (i = 0; i < n_client_rects; ++i) {
+        const Rect* r = &client_rects[i];
+        if (r->width <= 0 || r->height <= 0)
+            continue;
+        int x1 = count_less(t->x_edges, t->n_x, r->x);
+        int x2 = count_less(t->x_edges, t->n_x, r->x + r->width);
+        t->first_event[x1 + 2] += 2;
+        t->first_event[x2 + 2] += 2;
+    }
+    for (i = 2; i <= t->n_x + 1; ++i)
+        t->first_event[i] += t->first_event[i - 1];
+    for (i = 0; i < n_client_rects; ++i) {
+        const Rect* r = &client_rects[i];
+        if (r->width <= 0 || r->height <= 0)
+            continue;
+        int x[NUM_CORNERS], y[NUM_CORNERS];
+        x[CORNER_TOP_LEFT] = x[CORNER_BOTTOM_LEFT] =
+            count_less(t->x_edges, t->n_x, r->x);
+        x[CORNER_TOP_RIGHT] = x[CORNER_BOTTOM_RIGHT] =
+            count_less(t->x_edges, t->n_x, r->x + r->width);
+        y[CORNER_TOP_LEFT] = y[CORNER_TOP_RIGHT] =
+            count_less(t->y_edges, t->n_y, r->y);
+        y[CORNER_BOTTOM_LEFT] = y[CORNER_BOTTOM_RIGHT] =
+            count_less(t->y_edges, t->n_y, r->y + r->height);
+        for (c = 0; c < NUM_CORNERS; ++c) {
+            CornerEvent* e = &t->events[t->first_event[x[c] + 1]++];
+            e->y = y[c];
+            e->corner = c;
+        }
+    }
+
+    make_row(t, &t->all);
+    sweep_row(t, &t->all, t->n_x - 1);
+}
+
+static void free_tables(OverlapTables* t)
+{
+    g_free(t->flat);
+    g_free(t->x_edges);
+    g_free(t->y_edges);
+    g_free(t->events);
+    g_free(t->first_event);
+    free_row(&t->all);
+}
+
+static void make_span_rows(const OverlapTables* t,
+                           SpanRows* rows)
+{
+    make_row(t, &rows->past_start);
+    make_row(t, &rows->before_end);
+    make_row(t, &rows->past_end);
+}
+
+/* Move ROWS on to the ones that X needs, which must not be left of the
+   ones they are at */
+static void sweep_span_rows(const OverlapTables* t,
+                            const Span* x,
+                            SpanRows* rows)
+{
+    sweep_row(t, &rows->past_start, x->past_start - 1);
+    sweep_row(t, &rows->before_end, x->before_end - 1);
+    sweep_row(t, &rows->past_end, x->past_end - 1);
+}
+
+static void free_span_rows(SpanRows* rows)
+{
+    free_row(&rows->past_start);
+    free_row(&rows->before_end);
+    free_row(&rows->past_end);
+}
+
+static Span make_span(const int* edges,
+                      int n_edges,
+                      int start,
+                      int end)
+{
+    Span s = {
+        .start = start,
+        .end = end,
+        .past_start = count_less(edges, n_edges, start + 1),
+        .before_end = count_less(edges, n_edges, end),
+        .past_end = count_less(edges, n_edges, end + 1)
+    };
+    return s;
+}
+
+/* Find the spans of the rects of SIZE which start or end at each of the
+   grid's EDGES, in that order */
+static void make_spans(const OverlapTables* t,
+                       const int* edges,
+                       int n_edges,
+                       int size,
+                       gboolean x_axis,
+                       Span* spans)
+{
+    const int* t_edges = x_axis ? t->x_edges : t->y_edges;
+    const int n_t_edges = x_axis ? t->n_x : t->n_y;
+    int i;
+    for (i = 0; i < n_edges && edges[i] != G_MAXINT; ++i) {
+        spans[2 * i] = make_span(t_edges, n_t_edges,
+                                 edges[i], edges[i] + size);
+        spans[2 * i + 1] = make_span(t_edges, n_t_edges,
+                                     edges[i] - size, edges[i]);
+    }
+}
+
+/* The sum of the client rects' areas which are above and left of (X, Y).
+   I and J are the number of edges less than X + 1 and Y + 1, and ROW is
+   the row for the edge before I. */
+static gint64 area_before(const OverlapTables* t,
+                          const TableRow* row,
+                          int x,
+                          int i,
+                          int y,
+                          int j)
+{
+    if (i == 0 || j == 0)
+        return 0;
+    /* nothing is covered past the last edges */
+    x = MIN(x, t->x_edges[t->n_x - 1]);
+    y = MIN(y, t->y_edges[t->n_y - 1]);
+
+    --i;
+    --j;
+    gint64 dx = x - t->x_edges[i];
+    gint64 dy = y - t->y_edges[j];
+    return row->area[j] + dy * row->area_dy[j] +
+        dx * (row->area_dx[j] + dy * row->cover[j]);
+}
+
+/* The number of client rects that CORNER is left of X and above Y for.
+   X and Y are indexes in the edges, or n_x and n_y to take all of them,
+   and ROW is the row for the edge before X. */
+static int count_corners(const TableRow* row,
+                         Corner corner,
+                         int x,
+                         int y)
+{
+    if (x == 0)
+        return 0;
+    return row->corners[corner][y];
+}
+
+/* The number of client rects that a rect overlaps, which is all of them
+   except for the ones entirely to one side of it.  A client rect is to the
+   left of it if its right edge is left of x->past_start, and to the right
+   of it if its left edge is not left of x->before_end, and the same for
+   above and below. */
+static int count_overlapping(const OverlapTables* t,
+                             const Span* x,
+                             const SpanRows* x_rows,
+                             const Span* y)
+{
+    const int n = t->n_rects;
+    const int all_x = t->n_x;
+    const int all_y = t->n_y;
+    const TableRow* past_start = &x_rows->past_start;
+    const TableRow* before_end = &x_rows->before_end;
+
+    int left = count_corners(past_start, CORNER_BOTTOM_RIGHT,
+                             x->past_start, all_y);
+    int right = n - count_corners(before_end, CORNER_TOP_LEFT,
+                                  x->before_end, all_y);
+    int top = count_corners(&t->all, CORNER_BOTTOM_RIGHT,
+                            all_x, y->past_start);
+    int bottom = n - count_corners(&t->all, CORNER_TOP_LEFT,
+                                   all_x, y->before_end);
+
+    /* a rect can't be on both the left and right, or top and bottom, but
+       it can be on a side and the top or bottom */
+    int top_left = count_corners(past_start, CORNER_BOTTOM_RIGHT,
+                                 x->past_start, y->past_start);
+    int bottom_left = left - count_corners(past_start, CORNER_TOP_RIGHT,
+                                           x->past_start, y->before_end);
+    int top_right = top - count_corners(before_end, CORNER_BOTTOM_LEFT,
+                                        x->before_end, y->past_start);
+    int bottom_right = right + bottom - n
+        + count_corners(before_end, CORNER_TOP_LEFT,
+                        x->before_end, y->before_end);
+
+    return n - (left + right + top + bottom
+                - top_left - bottom_left - top_right - bottom_right);
+}
+
+/* somewhat penalize #rects, overlapping an additional client is only
+ * better if it saves ~75x75 pixels. This is so that we don't overlap a
+ * bunch of windows just because there's a small gap between them. */
+#define OVERLAP_PENALTY 6000
+
+static int total_overlap(const OverlapTables* t,
+                         const Span* x,
+                         const SpanRows* x_rows,
+                         const Span* y,
                          const Rect* proposed_rect)
+{
+    gint64 overlap = 0;
+    int i;
+
+    if (t->n_rects > 0) {
+        int n = count_overlapping(t, x, x_rows, y);
+        if (n > 0) {
+            overlap = area_before(t, &x_rows->past_end, x->end, x->past_end,
+                                  y->end, y->past_end)
+                - area_before(t, &x_rows->past_start, x->start,
+                              x->past_start, y->end, y->past_end)
+                - area_before(t, &x_rows->past_end, x->end, x->past_end,
+                              y->start, y->past_start)
+                + area_before(t, &x_rows->past_start, x->start,
+                              x->past_start, y->start, y->past_start);
+            overlap += OVERLAP_PENALTY * n;
+        }
+    }
+    for (i = 0; i < t->n_flat; ++i) {
+        if (!RECT_INTERSECTS_RECT(*proposed_rect, t->flat[i]))
+            continue;
+        Rect rtemp;
+        RECT_SET_INTERSECTION(rtemp, *proposed_rect, t->flat[i]);
+        overlap += RECT_AREA(rtemp) + OVERLAP_PENALTY;
+    }
+    return overlap;
+}
+
+/* The overlap of a rect which is not on the grid, and so has no rows of
+   the tables swept to it.  This is only done a few times, so each client
+   rect is looked at instead. */
+static int rect_overlap(const OverlapTables* t,
+                        const Rect* proposed_rect)
 {
     int overlap = 0;
     int i;
-    for (i = 0; i < n_client_rects; ++i) {
-        if (!RECT_INTERSECTS_RECT(*proposed_rect, client_rects[i]))
+
+    for (i = 0; i < t->n_all; ++i) {
+        if (!RECT_INTERSECTS_RECT(*proposed_rect, t->rects[i]))
             continue;
         Rect rtemp;
-        RECT_SET_INTERSECTION(rtemp, *proposed_rect, client_rects[i]);
-        /* somewhat penalize #rects, overlapping an additional client is
-         * only better if it saves ~75x75 pixels. This is so that we don't
-         * overlap a bunch of windows just because there's a small gap
-         * between them. */
-        overlap += RECT_AREA(rtemp) + 6000;
+        RECT_SET_INTERSECTION(rtemp, *proposed_rect, t->rects[i]);
+        overlap += RECT_AREA(rtemp) + OVERLAP_PENALTY;
     }
     return overlap;
 }
@@ -214,8 +713,7 @@ typedef struct _ExpandInfo {
     int orig_width;
     int orig_height;
     const Rect* monitor;
-    const Rect* client_rects;
-    int n_client_rects;
+    const OverlapTables* tables;
     int max_edges;
 } ExpandInfo;
 
@@ -234,7 +732,7 @@ static int expand_field(int orig_edge_index,
     while (edge_index < i->max_edges - 1) {
         int next_edge_index = edge_index + 1;
         (*expand_by)(&field, edges[next_edge_index] - edges[edge_index]);
-        int overlap = total_overlap(i->client_rects, i->n_client_rects, &field);
+        int overlap = rect_overlap(i->tables, &field);
         if (overlap != 0 || !RECT_CONTAINS_RECT(*(i->monitor), field))
             break;
         edge_index = next_edge_index;
@@ -255,8 +753,7 @@ static int expand_field(int orig_edge_index,
 static void center_in_field(Point* top_left,
                             const Size* req_size,
                             const Rect *monitor,
-                            const Rect* client_rects,
-                            int n_client_rects,
+                            const OverlapTables* tables,
                             const int* x_edges,
                             const int* y_edges,
                             int max_edges)
@@ -273,8 +770,7 @@ static void center_in_field(Point* top_left,
         .orig_width = x_edges[orig_right_edge_index] - top_left->x,
         .orig_height = y_edges[orig_bottom_edge_index] - top_left->y,
         .monitor = monitor,
-        .client_rects = client_rects,
-        .n_client_rects = n_client_rects,
+        .tables = tables,
         .max_edges = max_edges};
     /* Try extending width. */
     int right_edge_index =
@@ -306,8 +802,10 @@ static void center_in_field(Point* top_left,
 #define NUM_DIRECTIONS 4
 
 static int best_direction(const Point* grid_point,
-                          const Rect* client_rects,
-                          int n_client_rects,
+                          const OverlapTables* tables,
+                          const Span* x_spans,
+                          const SpanRows* x_rows,
+                          const Span* y_spans,
                           const Rect* monitor,
                           const Size* req_size,
                           Point* best_top_left)
@@ -326,7 +824,10 @@ static int best_direction(const Point* grid_point,
         RECT_SET(r, pt.x, pt.y, req_size->width, req_size->height);
         if (!RECT_CONTAINS_RECT(*monitor, r))
             continue;
-        int this_overlap = total_overlap(client_rects, n_client_rects, &r);
+        int this_overlap =
+            total_overlap(tables, &x_spans[-directions[i].width],
+                          &x_rows[-directions[i].width],
+                          &y_spans[-directions[i].height], &r);
         if (this_overlap < overlap) {
             overlap = this_overlap;
             *best_top_left = pt;
@@ -0,0 +1,235 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   place_overlap_test.c for the Openbox window manager
+   Copyright (c) 2026        agent
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+/* Times place_overlap_find_least_placement() on sets of made up windows,
+   and checks that it places windows in the same spot as a plain search of
+   the grid which looks at every window for each spot. */
+
+#include "geom.h"
+#include "place_overlap.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* place_overlap.c reads this from the config */
+gboolean config_place_center = FALSE;
+
+typedef enum {
+    LAYOUT_RANDOM,  /* windows of any size anywhere */
+    LAYOUT_TILED,   /* windows in rows, filling the screen over again */
+    LAYOUT_CASCADE  /* windows stepping down from the top left */
+} Layout;
+
+static const struct {
+    const gchar *name;
+    Layout layout;
+} layouts[] = {
+    { "random", LAYOUT_RANDOM },
+    { "tiled", LAYOUT_TILED },
+    { "cascade", LAYOUT_CASCADE }
+};
+
+static void make_rects(Layout layout, const Rect *monitor, Rect *rects,
+                       gint n, GRand *rand)
+{
+    gint i;
+
+    for (i = 0; i < n; ++i) {
+        Rect *r = &rects[i];
+
+        switch (layout) {
+        case LAYOUT_RANDOM:
+            r->width = g_rand_int_range(rand, 50, monitor->width / 2);
+            r->height = g_rand_int_range(rand, 50, monitor->height / 2);
+            r->x = monitor->x +
+                g_rand_int_range(rand, -r->width / 2, monitor->width);
+            r->y = monitor->y +
+                g_rand_int_range(rand, -r->height / 2, monitor->height);
+            break;
+        case LAYOUT_TILED:
+            r->width = monitor->width / 12;
+            r->height = monitor->height / 12;
+            r->x = monitor->x + (i % 12) * r->width;
+            r->y = monitor->y + (i / 12 % 12) * r->height;
+            break;
+        case LAYOUT_CASCADE:
+            r->width = monitor->width / 2;
+            r->height = monitor->height / 2;
+            r->x = monitor->x + i * 23 % (monitor->width - r->width);
+            r->y = monitor->y + i * 29 % (monitor->height - r->height);
+            break;
+        }
+    }
+}
+
+/* The placement as it is defined: the least overlap of the request placed
+   to any side of any grid point, checking each window for each of them */
+static void reference_placement(const Rect *rects, gint n,
+                                const Rect *monitor, const Size *req_size,
+                                Point *result)
+{
+    gint *x_edges, *y_edges, n_edges, overlap, i, j, k, d;
+
+    x_edges = g_new(gint, 2 * n + 2);
+    y_edges = g_new(gint, 2 * n + 2);
+    n_edges = 0;
+    for (i = 0; i < n; ++i) {
+        if (!RECT_INTERSECTS_RECT(rects[i], *monitor))
+            continue;
+        x_edges[n_edges] = rects[i].x;
+        y_edges[n_edges++] = rects[i].y;
+        x_edges[n_edges] = rects[i].x + rects[i].width;
+        y_edges[n_edges++] = rects[i].y + rects[i].height;
+    }
+    x_edges[n_edges] = monitor->x;
+    y_edges[n_edges++] = monitor->y;
+    x_edges[n_edges] = monitor->x + monitor->width;
+    y_edges[n_edges++] = monitor->y + monitor->height;
+
+    /* sort with repeats, which can't change the first best one found */
+    for (i = 1; i < n_edges; ++i)
+        for (j = i; j > 0 && x_edges[j-1] > x_edges[j]; --j) {
+            gint t = x_edges[j]; x_edges[j] = x_edges[j-1]; x_edges[j-1] = t;
+        }
+    for (i = 1; i < n_edges; ++i)
+        for (j = i; j > 0 && y_edges[j-1] > y_edges[j]; --j) {
+            gint t = y_edges[j]; y_edges[j] = y_edges[j-1]; y_edges[j-1] = t;
+        }
+
+    POINT_SET(*result, monitor->x, monitor->y);
+    overlap = G_MAXINT;
+    for (i = 0; i < n_edges && overlap; ++i)
+        for (j = 0; j < n_edges && overlap; ++j)
+            for (d = 0; d < 4 && overlap; ++d) {
+                Rect r;
+                gint this_overlap = 0;
+
+                RECT_SET(r, x_edges[i] - (d & 2 ? req_size->width : 0),
+                         y_edges[j] - (d & 1 ? req_size->height : 0),
+                         req_size->width, req_size->height);
+                if (!RECT_CONTAINS_RECT(*monitor, r))
+                    continue;
+                for (k = 0; k < n; ++k) {
+                    Rect o;
+
+                    if (!RECT_INTERSECTS_RECT(r, rects[k]))
+                        continue;
+                    RECT_SET_INTERSECTION(o, r, rects[k]);
+                    this_overlap += RECT_AREA(o) + 6000;
+                }
+                if (this_overlap < overlap) {
+                    overlap = this_overlap;
+                    POINT_SET(*result, r.x, r.y);
+                }
+            }
+
+    g_free(x_edges);
+    g_free(y_edges);
+}
+
+static void usage(void)
+{
+    printf("Usage: overlaptest [options]\n\n"
+           "Options:\n"
+           "  --counts LIST   Comma separated numbers of windows to place "
+           "among\n"
+           "                  (default 10,50,100,150,250)\n"
+           "  --time MS       Time to spend on each case (default 200)\n"
+           "  --no-check      Do not compare with the reference search\n"
+           "  --seed N        Seed for the random windows (default 1)\n");
+}
+
+gint main(gint argc, gchar **argv)
+{
+    const Rect monitor = { 0, 0, 1920, 1080 };
+    const Size req_size = { 640, 480 };
+    const gchar *counts_arg = "10,50,100,150,250";
+    gchar **counts;
+    gint time_ms = 200, seed = 1, failed = 0;
+    gboolean check = TRUE;
+    GRand *rand;
+    guint i, j;
+
+    for (i = 1; i < (guint)argc; ++i) {
+        if (!strcmp(argv[i], "--counts") && i + 1 < (guint)argc)
+            counts_arg = argv[++i];
+        else if (!strcmp(argv[i], "--time") && i + 1 < (guint)argc) {
+            time_ms = atoi(argv[++i]);
+            time_ms = MAX(1, time_ms);
+        }
+        else if (!strcmp(argv[i], "--seed") && i + 1 < (guint)argc)
+            seed = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--no-check"))
+            check = FALSE;
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    rand = g_rand_new_with_seed(seed);
+    counts = g_strsplit(counts_arg, ",", 0);
+    for (i = 0; i < G_N_ELEMENTS(layouts); ++i)
+        for (j = 0; counts[j]; ++j) {
+            gint n = atoi(counts[j]);
+            Rect *rects;
+            Point result, expected;
+            GTimer *timer;
+            gint runs;
+            gdouble us;
+
+            if (n <= 0) {
+                fprintf(stderr, "Skipping the count \"%s\"\n", counts[j]);
+                continue;
+            }
+
+            rects = g_new(Rect, n);
+            make_rects(layouts[i].layout, &monitor, rects, n, rand);
+
+            timer = g_timer_new();
+            runs = 0;
+            do {
+                place_overlap_find_least_placement(rects, n, &monitor,
+                                                   &req_size, &result);
+                ++runs;
+            } while (g_timer_elapsed(timer, NULL) * 1000 < time_ms);
+            us = g_timer_elapsed(timer, NULL) * 1000000 / runs;
+            g_timer_destroy(timer);
+
+            printf("%-8s %5d windows %12.1f us/placement", layouts[i].name,
+                   n, us);
+            if (check) {
+                reference_placement(rects, n, &monitor, &req_size,
+                                    &expected);
+                if (result.x != expected.x || result.y != expected.y) {
+                    printf("  MISMATCH %d,%d should be %d,%d",
+                           result.x, result.y, expected.x, expected.y);
+                    ++failed;
+                }
+            }
+            printf("\n");
+
+            g_free(rects);
+        }
+    g_strfreev(counts);
+    g_rand_free(rand);
+
+    return failed ? 1 : 0;
+}
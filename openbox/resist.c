@@ -24,6 +24,7 @@
 #include "screen.h"
 #include "dock.h"
 #include "config.h"
+#include "spatial.h"
 
 #include <glib.h>
 
@@ -99,22 +100,45 @@ static gboolean resist_move_window(Rect window,
     return snapx && snapy;
 }
 
+/*! Sorts clients from the top of the stacking order to the bottom */
+static gint stacking_cmp(gconstpointer a, gconstpointer b)
+{
+    if (a == b) return 0;
+    return stacking_is_above(CLIENT_AS_WINDOW(a), CLIENT_AS_WINDOW(b)) ?
+        -1 : 1;
+}
+
 void resist_move_windows(ObClient *c, gint resist, gint *x, gint *y)
 {
-    GList *it;
+    GSList *targets, *it;
     Rect dock_area;
+    gint lo, hi;
+    const gint w = c->frame->area.width;
+    const gint h = c->frame->area.height;
 
     if (!resist) return;
 
     frame_client_gravity(c->frame, x, y);
 
-
-    for (it = stacking_list; it; it = g_list_next(it)) {
-        ObClient *target;
-
-        if (!WINDOW_IS_CLIENT(it->data))
-            continue;
-        target = it->data;
+    /* snapping only moves the window to somewhere between where it is and
+       where it is going, so only windows with edges near that can be
+       snapped to */
+    lo = MIN(*x, c->frame->area.x);
+    hi = MAX(*x, c->frame->area.x);
+    targets = spatial_find_edges(NULL, OB_SPATIAL_EDGE_RIGHT,
+                                 lo - 2, hi + resist + 1);
+    targets = spatial_find_edges(targets, OB_SPATIAL_EDGE_LEFT,
+                                 lo + w - resist - 2, hi + w + 1);
+    lo = MIN(*y, c->frame->area.y);
+    hi = MAX(*y, c->frame->area.y);
+    targets = spatial_find_edges(targets, OB_SPATIAL_EDGE_BOTTOM,
+                                 lo - 2, hi + resist + 1);
+    targets = spatial_find_edges(targets, OB_SPATIAL_EDGE_TOP,
+                                 lo + h - resist - 2, hi + h + 1);
+    targets = g_slist_sort(targets, stacking_cmp);
+
+    for (it = targets; it; it = g_slist_next(it)) {
+        ObClient *target = it->data;
 
         /* don't snap to self or non-visibles */
         if (!target->frame->visible || target == c)
@@ -127,6 +151,7 @@ void resist_move_windows(ObClient *c, gint resist, gint *x, gint *y)
                                resist, x, y))
             break;
     }
+    g_slist_free(targets);
     dock_get_area(&dock_area);
     resist_move_window(c->frame->area, dock_area, resist, x, y);
 
@@ -135,7 +160,7 @@ void resist_move_windows(ObClient *c, gint resist, gint *x, gint *y)
 
 void resist_move_monitors(ObClient *c, gint resist, gint *x, gint *y)
 {
-    Rect *area;
+    Rect area;
     const Rect *parea;
     guint i;
     gint l, t, r, b; /* requested edges */
@@ -171,13 +196,13 @@ void resist_move_monitors(ObClient *c, gint resist, gint *x, gint *y)
         if (!RECT_INTERSECTS_RECT(*parea, c->frame->area))
             continue;
 
-        area = screen_area(c->desktop, SCREEN_AREA_ALL_MONITORS,
-                           &desired_area);
+        screen_area(c->desktop, SCREEN_AREA_ALL_MONITORS, &desired_area,
+                    &area);
 
-        al = RECT_LEFT(*area);
-        at = RECT_TOP(*area);
-        ar = RECT_RIGHT(*area);
-        ab = RECT_BOTTOM(*area);
+        al = RECT_LEFT(area);
+        at = RECT_TOP(area);
+        ar = RECT_RIGHT(area);
+        ab = RECT_BOTTOM(area);
         pl = RECT_LEFT(*parea);
         pt = RECT_TOP(*parea);
         pr = RECT_RIGHT(*parea);
@@ -200,8 +225,6 @@ void resist_move_monitors(ObClient *c, gint resist, gint *x, gint *y)
             *y = pt;
         else if (cb <= pb && b > pb && b < pb + resist)
             *y = pb - h + 1;
-
-        g_slice_free(Rect, area);
     }
 
     frame_frame_gravity(c->frame, x, y);
@@ -292,15 +315,35 @@ static gboolean resist_size_window(Rect window, Rect target, gint resist,
 void resist_size_windows(ObClient *c, gint resist, gint *w, gint *h,
                          ObDirection dir)
 {
-    GList *it;
+    GSList *targets, *it;
     ObClient *target; /* target */
     Rect dock_area;
+    gint a, b;
 
     if (!resist) return;
 
-    for (it = stacking_list; it; it = g_list_next(it)) {
-        if (!WINDOW_IS_CLIENT(it->data))
-            continue;
+    /* snapping only moves the window's sides to somewhere between where they
+       are and where they are going, so only windows with edges near that
+       can be snapped to */
+    a = RECT_RIGHT(c->frame->area);
+    b = a + *w - c->frame->area.width;
+    targets = spatial_find_edges(NULL, OB_SPATIAL_EDGE_LEFT,
+                                 MIN(a, b) - resist - 1, MAX(a, b) + 1);
+    a = RECT_LEFT(c->frame->area);
+    b = a - *w + c->frame->area.width;
+    targets = spatial_find_edges(targets, OB_SPATIAL_EDGE_RIGHT,
+                                 MIN(a, b) - 1, MAX(a, b) + resist + 1);
+    a = RECT_BOTTOM(c->frame->area);
+    b = a + *h - c->frame->area.height;
+    targets = spatial_find_edges(targets, OB_SPATIAL_EDGE_TOP,
+                                 MIN(a, b) - resist - 1, MAX(a, b) + 1);
+    a = RECT_TOP(c->frame->area);
+    b = a - *h + c->frame->area.height;
+    targets = spatial_find_edges(targets, OB_SPATIAL_EDGE_BOTTOM,
+                                 MIN(a, b) - 1, MAX(a, b) + resist + 1);
+    targets = g_slist_sort(targets, stacking_cmp);
+
+    for (it = targets; it; it = g_slist_next(it)) {
         target = it->data;
 
         /* don't snap to invisibles or ourself */
@@ -314,6 +357,7 @@ void resist_size_windows(ObClient *c, gint resist, gint *w, gint *h,
                                resist, w, h, dir))
             break;
     }
+    g_slist_free(targets);
     dock_get_area(&dock_area);
     resist_size_window(c->frame->area, dock_area,
                        resist, w, h, dir);
@@ -324,7 +368,7 @@ void resist_size_monitors(ObClient *c, gint resist, gint *w, gint *h,
 {
     gint l, t, r, b; /* my left, top, right and bottom sides */
     gint dlt, drb; /* my destination left/top and right/bottom sides */
-    Rect *area;
+    Rect area;
     const Rect *parea;
     gint al, at, ar, ab; /* screen boundaries */
     gint pl, pt, pr, pb; /* physical screen boundaries */
@@ -346,14 +390,14 @@ void resist_size_monitors(ObClient *c, gint resist, gint *w, gint *h,
         if (!RECT_INTERSECTS_RECT(*parea, c->frame->area))
             continue;
 
-        area = screen_area(c->desktop, SCREEN_AREA_ALL_MONITORS,
-                           &desired_area);
+        screen_area(c->desktop, SCREEN_AREA_ALL_MONITORS, &desired_area,
+                    &area);
 
         /* get the screen boundaries */
-        al = RECT_LEFT(*area);
-        at = RECT_TOP(*area);
-        ar = RECT_RIGHT(*area);
-        ab = RECT_BOTTOM(*area);
+        al = RECT_LEFT(area);
+        at = RECT_TOP(area);
+        ar = RECT_RIGHT(area);
+        ab = RECT_BOTTOM(area);
         pl = RECT_LEFT(*parea);
         pt = RECT_TOP(*parea);
         pr = RECT_RIGHT(*parea);
@@ -410,7 +454,5 @@ void resist_size_monitors(ObClient *c, gint resist, gint *w, gint *h,
                 *h = b - pt + 1;
             break;
         }
-
-        g_slice_free(Rect, area);
     }
 }
@@ -0,0 +1,101 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   rootprops.c for the Openbox window manager
+   Copyright (c) 2026        agent
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "rootprops.h"
+#include "client.h"
+#include "stacking.h"
+#include "screen.h"
+#include "debug.h"
+
+typedef struct _ObRootPropInfo {
+    const gchar *name;
+    void (*write)(void);
+    gboolean dirty;
+    guint changes; /*!< How many times the property was marked dirty */
+    guint writes;  /*!< How many times the property was written */
+} ObRootPropInfo;
+
+static ObRootPropInfo props[OB_NUM_ROOT_PROPS] = {
+    { "_NET_CLIENT_LIST", client_write_list, FALSE, 0, 0 },
+    { "_NET_CLIENT_LIST_STACKING", stacking_write_list, FALSE, 0, 0 },
+    { "_NET_WORKAREA", screen_write_workarea, FALSE, 0, 0 }
+};
+
+static guint flush_id = 0;
+
+static gboolean flush_idle(gpointer data)
+{
+    flush_id = 0;
+    root_props_flush();
+    return FALSE; /* don't repeat */
+}
+
+void root_props_startup(gboolean reconfig)
+{
+    guint i;
+
+    if (reconfig) return;
+
+    for (i = 0; i < OB_NUM_ROOT_PROPS; ++i)
+        props[i].changes = props[i].writes = 0;
+}
+
+void root_props_shutdown(gboolean reconfig)
+{
+    guint i;
+
+    /* write out anything that changed since the main loop was last idle */
+    root_props_flush();
+
+    if (reconfig) return;
+
+    for (i = 0; i < OB_NUM_ROOT_PROPS; ++i)
+        ob_debug("Wrote %s %u times for %u changes",
+                 props[i].name, props[i].writes, props[i].changes);
+}
+
+void root_props_dirty(ObRootProp prop)
+{
+    g_assert(prop < OB_NUM_ROOT_PROPS);
+
+    props[prop].dirty = TRUE;
+    ++props[prop].changes;
+
+    /* wait until there are no more events to handle, which may change the
+       property again */
+    if (!flush_id)
+        flush_id = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE,
+                                   flush_idle, NULL, NULL);
+}
+
+void root_props_flush(void)
+{
+    guint i;
+
+    if (flush_id) {
+        g_source_remove(flush_id);
+        flush_id = 0;
+    }
+
+    for (i = 0; i < OB_NUM_ROOT_PROPS; ++i)
+        if (props[i].dirty) {
+            props[i].dirty = FALSE;
+            ++props[i].writes;
+            props[i].write();
+        }
+}
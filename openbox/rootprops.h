@@ -0,0 +1,44 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   rootprops.h for the Openbox window manager
+   Copyright (c) 2026        agent
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef __rootprops_h
+#define __rootprops_h
+
+#include <glib.h>
+
+/*! Properties on the root window which are made from Openbox's own state, and
+  which can change many times in a row */
+typedef enum {
+    OB_ROOT_PROP_CLIENT_LIST,          /*!< _NET_CLIENT_LIST */
+    OB_ROOT_PROP_CLIENT_LIST_STACKING, /*!< _NET_CLIENT_LIST_STACKING */
+    OB_ROOT_PROP_WORKAREA,             /*!< _NET_WORKAREA */
+    OB_NUM_ROOT_PROPS
+} ObRootProp;
+
+void root_props_startup(gboolean reconfig);
+void root_props_shutdown(gboolean reconfig);
+
+/*! Mark a property on the root window as out of date.  It is written once,
+  when the main loop is next idle, however many times it is marked before
+  then. */
+void root_props_dirty(ObRootProp prop);
+
+/*! Write any out of date properties now */
+void root_props_flush(void);
+
+#endif
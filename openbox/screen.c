@@ -28,10 +28,13 @@
 #include "client.h"
 #include "session.h"
 #include "frame.h"
+#include "framerender.h"
 #include "event.h"
 #include "focus.h"
 #include "focus_cycle.h"
 #include "popup.h"
+#include "rootprops.h"
+#include "spatial.h"
 #include "version.h"
 #include "obrender/render.h"
 #include "gettext.h"
@@ -59,6 +62,7 @@ static void     screen_fallback_focus(void);
 
 guint                  screen_num_desktops;
 guint                  screen_num_monitors;
+guint                  screen_monitors_serial = 1;
 guint                  screen_desktop;
 guint                  screen_last_desktop;
 ObScreenShowDestopMode screen_show_desktop_mode;
@@ -78,6 +82,11 @@ static GSList *struts_top = NULL;
 static GSList *struts_left = NULL;
 static GSList *struts_right = NULL;
 static GSList *struts_bottom = NULL;
+/*! The work areas for searching whole monitors, for each desktop and then
+  DESKTOP_ALL, holding an area for each monitor and then all the monitors.
+  NULL when the struts or monitors have changed since they were found. */
+static Rect  *work_areas = NULL;
+static guint  work_areas_desktops;
 
 static ObPagerPopup *desktop_popup;
 static guint         desktop_popup_timer = 0;
@@ -367,6 +376,10 @@ void screen_startup(gboolean reconfig)
     pager_popup_height(desktop_popup, POPUP_HEIGHT);
 
     if (reconfig) {
+        /* the primary monitor may have changed, and it wins ties for which
+           monitor a window is on */
+        ++screen_monitors_serial;
+
         /* update the pager popup's width */
         pager_popup_text_width_to_strings(desktop_popup,
                                           screen_desktop_names,
@@ -478,6 +491,9 @@ void screen_shutdown(gboolean reconfig)
 
     g_strfreev(screen_desktop_names);
     screen_desktop_names = NULL;
+
+    g_free(work_areas);
+    work_areas = NULL;
 }
 
 void screen_resize(void)
@@ -611,6 +627,7 @@ void screen_set_desktop(guint num, gboolean dofocus)
     GList *it;
     guint previous;
     gulong ignore_start;
+    gint64 start;
 
     g_assert(num < screen_num_desktops);
 
@@ -694,9 +711,18 @@ void screen_set_desktop(guint num, gboolean dofocus)
     if (ob_state() == OB_STATE_RUNNING)
         screen_show_desktop_popup(screen_desktop, FALSE);
 
+    start = g_get_monotonic_time();
+
     /* ignore enter events caused by the move */
     ignore_start = event_start_ignore_all_enters();
 
+    /* hold the server while the windows are shown and hidden, so that other
+       clients see the whole desktop change at once instead of one window at
+       a time, and it is all sent with a single flush at the end */
+    grab_server(TRUE);
+    /* the frames being shown are painted together too */
+    framerender_batch_begin();
+
     if (moveresize_client)
         client_set_desktop(moveresize_client, num, TRUE, FALSE);
 
@@ -732,10 +758,16 @@ void screen_set_desktop(guint num, gboolean dofocus)
         }
     }
 
+    framerender_batch_end();
+    grab_server(FALSE);
+
     focus_cycle_addremove(NULL, TRUE);
 
     event_end_ignore_all_enters(ignore_start);
 
+    ob_debug("Moved to desktop %d in %.3f ms", num+1,
+             (g_get_monotonic_time() - start) / 1000.0);
+
     if (event_source_time() != CurrentTime)
         screen_desktop_user_time = event_source_time();
 }
@@ -1221,6 +1253,7 @@ void screen_update_desktop_names(void)
 void screen_show_desktop(ObScreenShowDestopMode show_mode, ObClient *show_only)
 {
     GList *it;
+    gint64 start;
 
     ObScreenShowDestopMode before_mode = screen_show_desktop_mode;
 
@@ -1244,6 +1277,13 @@ void screen_show_desktop(ObScreenShowDestopMode show_mode, ObClient *show_only)
         return;
     }
 
+    start = g_get_monotonic_time();
+
+    /* hold the server so the windows all change together, as when switching
+       desktops */
+    grab_server(TRUE);
+    framerender_batch_begin();
+
     if (showing_after) {
         /* hide windows bottom to top */
         for (it = g_list_last(stacking_list); it; it = g_list_previous(it)) {
@@ -1297,6 +1337,13 @@ void screen_show_desktop(ObScreenShowDestopMode show_mode, ObClient *show_only)
                    NET_SHOWING_DESKTOP,
                    CARDINAL,
                    !!showing_after);
+
+    framerender_batch_end();
+    grab_server(FALSE);
+
+    ob_debug("%s the desktop in %.3f ms",
+             showing_after ? "Showed" : "Stopped showing",
+             (g_get_monotonic_time() - start) / 1000.0);
 }
 
 gboolean screen_showing_desktop()
@@ -1357,6 +1404,51 @@ typedef struct {
     } \
 }
 
+#define REMOVE_STRUT_FROM_LIST(sl, s) \
+{ \
+    GSList *it, *next; \
+    for (it = sl; it; it = next) { \
+        next = g_slist_next(it); \
+        if (((ObScreenStrut*)it->data)->strut == (s)) { \
+            g_slice_free(ObScreenStrut, it->data); \
+            sl = g_slist_delete_link(sl, it); \
+        } \
+    } \
+}
+
+static void add_client_struts(ObClient *c)
+{
+    if (c->strut.left)
+        ADD_STRUT_TO_LIST(struts_left, c->desktop, &c->strut);
+    if (c->strut.top)
+        ADD_STRUT_TO_LIST(struts_top, c->desktop, &c->strut);
+    if (c->strut.right)
+        ADD_STRUT_TO_LIST(struts_right, c->desktop, &c->strut);
+    if (c->strut.bottom)
+        ADD_STRUT_TO_LIST(struts_bottom, c->desktop, &c->strut);
+}
+
+static void remove_client_struts(ObClient *c)
+{
+    REMOVE_STRUT_FROM_LIST(struts_left, &c->strut);
+    REMOVE_STRUT_FROM_LIST(struts_top, &c->strut);
+    REMOVE_STRUT_FROM_LIST(struts_right, &c->strut);
+    REMOVE_STRUT_FROM_LIST(struts_bottom, &c->strut);
+}
+
+/*! Don't let any strut take up more than half of the screen */
+static void validate_struts(void)
+{
+    VALIDATE_STRUTS(struts_left, left,
+                    monitor_area[screen_num_monitors].width / 2);
+    VALIDATE_STRUTS(struts_right, right,
+                    monitor_area[screen_num_monitors].width / 2);
+    VALIDATE_STRUTS(struts_top, top,
+                    monitor_area[screen_num_monitors].height / 2);
+    VALIDATE_STRUTS(struts_bottom, bottom,
+                    monitor_area[screen_num_monitors].height / 2);
+}
+
 static void get_xinerama_screens(Rect **xin_areas, guint *nxin)
 {
     guint i;
@@ -1417,8 +1509,6 @@ static void get_xinerama_screens(Rect **xin_areas, guint *nxin)
 
 void screen_update_areas(void)
 {
-    guint i;
-    gulong *dims;
     GList *it, *onscreen;
 
     /* collect the clients that are on screen */
@@ -1430,6 +1520,8 @@ void screen_update_areas(void)
 
     g_free(monitor_area);
     get_xinerama_screens(&monitor_area, &screen_num_monitors);
+    ++screen_monitors_serial;
+    spatial_resize();
 
     /* set up the user-specified margins */
     config_margins.top_start = RECT_LEFT(monitor_area[screen_num_monitors]);
@@ -1447,17 +1539,8 @@ void screen_update_areas(void)
     RESET_STRUT_LIST(struts_bottom);
 
     /* collect the struts */
-    for (it = client_list; it; it = g_list_next(it)) {
-        ObClient *c = it->data;
-        if (c->strut.left)
-            ADD_STRUT_TO_LIST(struts_left, c->desktop, &c->strut);
-        if (c->strut.top)
-            ADD_STRUT_TO_LIST(struts_top, c->desktop, &c->strut);
-        if (c->strut.right)
-            ADD_STRUT_TO_LIST(struts_right, c->desktop, &c->strut);
-        if (c->strut.bottom)
-            ADD_STRUT_TO_LIST(struts_bottom, c->desktop, &c->strut);
-    }
+    for (it = client_list; it; it = g_list_next(it))
+        add_client_struts(it->data);
     if (dock_strut.left)
         ADD_STRUT_TO_LIST(struts_left, DESKTOP_ALL, &dock_strut);
     if (dock_strut.top)
@@ -1476,33 +1559,38 @@ void screen_update_areas(void)
     if (config_margins.bottom)
         ADD_STRUT_TO_LIST(struts_bottom, DESKTOP_ALL, &config_margins);
 
-    VALIDATE_STRUTS(struts_left, left,
-                    monitor_area[screen_num_monitors].width / 2);
-    VALIDATE_STRUTS(struts_right, right,
-                    monitor_area[screen_num_monitors].width / 2);
-    VALIDATE_STRUTS(struts_top, top,
-                    monitor_area[screen_num_monitors].height / 2);
-    VALIDATE_STRUTS(struts_bottom, bottom,
-                    monitor_area[screen_num_monitors].height / 2);
+    validate_struts();
+
+    /* the work areas are found again when they are next used */
+    g_free(work_areas);
+    work_areas = NULL;
+
+    root_props_dirty(OB_ROOT_PROP_WORKAREA);
+
+    /* the area has changed, adjust all the windows if they need it */
+    for (it = onscreen; it; it = g_list_next(it))
+        client_reconfigure(it->data, FALSE);
+}
+
+void screen_write_workarea(void)
+{
+    guint i;
+    gulong *dims;
 
     dims = g_new(gulong, 4 * screen_num_desktops);
     for (i = 0; i < screen_num_desktops; ++i) {
-        Rect *area = screen_area(i, SCREEN_AREA_ALL_MONITORS, NULL);
-        dims[i*4+0] = area->x;
-        dims[i*4+1] = area->y;
-        dims[i*4+2] = area->width;
-        dims[i*4+3] = area->height;
-        g_slice_free(Rect, area);
+        Rect area;
+        screen_area(i, SCREEN_AREA_ALL_MONITORS, NULL, &area);
+        dims[i*4+0] = area.x;
+        dims[i*4+1] = area.y;
+        dims[i*4+2] = area.width;
+        dims[i*4+3] = area.height;
     }
 
     /* set the legacy workarea hint to the union of all the monitors */
     OBT_PROP_SETA32(obt_root(ob_screen), NET_WORKAREA, CARDINAL,
                     dims, 4 * screen_num_desktops);
 
-    /* the area has changed, adjust all the windows if they need it */
-    for (it = onscreen; it; it = g_list_next(it))
-        client_reconfigure(it->data, FALSE);
-
     g_free(dims);
 }
 
@@ -1559,19 +1647,14 @@ Rect* screen_area_all_monitors(guint desktop)
     (head == SCREEN_AREA_ALL_MONITORS && us && \
      RECT_BOTTOM(monitor_area[i]) - s->bottom < RECT_BOTTOM(*search))
 
-Rect* screen_area(guint desktop, guint head, Rect *search)
+static void find_area(guint desktop, guint head, const Rect *search,
+                      Rect *area)
 {
-    Rect *a;
     GSList *it;
     gint l, r, t, b;
     guint i, d;
     gboolean us = search != NULL; /* user provided search */
 
-    g_assert(desktop < screen_num_desktops || desktop == DESKTOP_ALL);
-    g_assert(head < screen_num_monitors || head == SCREEN_AREA_ONE_MONITOR ||
-             head == SCREEN_AREA_ALL_MONITORS);
-    g_assert(!(head == SCREEN_AREA_ONE_MONITOR && search == NULL));
-
     /* find any struts for this monitor
        which will be affecting the search area.
     */
@@ -1664,12 +1747,127 @@ Rect* screen_area(guint desktop, guint head, Rect *search)
         }
     }
 
-    a = g_slice_new(Rect);
-    a->x = l;
-    a->y = t;
-    a->width = r - l + 1;
-    a->height = b - t + 1;
-    return a;
+    area->x = l;
+    area->y = t;
+    area->width = r - l + 1;
+    area->height = b - t + 1;
+}
+
+/*! Returns the work area for searching a whole monitor, or all of them */
+static const Rect* work_area(guint desktop, guint head)
+{
+    const guint n_heads = screen_num_monitors + 1;
+    guint d, h;
+
+    /* the number of desktops can change before the struts are updated */
+    if (!work_areas || work_areas_desktops != screen_num_desktops) {
+        g_free(work_areas);
+        work_areas = g_new(Rect, (screen_num_desktops + 1) * n_heads);
+        work_areas_desktops = screen_num_desktops;
+
+        for (d = 0; d <= screen_num_desktops; ++d)
+            for (h = 0; h < n_heads; ++h)
+                find_area(d < screen_num_desktops ? d : DESKTOP_ALL,
+                          (h < screen_num_monitors ?
+                           h : SCREEN_AREA_ALL_MONITORS),
+                          NULL, &work_areas[d * n_heads + h]);
+    }
+
+    d = desktop == DESKTOP_ALL ? screen_num_desktops : desktop;
+    h = head == SCREEN_AREA_ALL_MONITORS ? screen_num_monitors : head;
+    return &work_areas[d * n_heads + h];
+}
+
+void screen_area(guint desktop, guint head, const Rect *search, Rect *area)
+{
+    g_assert(desktop < screen_num_desktops || desktop == DESKTOP_ALL);
+    g_assert(head < screen_num_monitors || head == SCREEN_AREA_ONE_MONITOR ||
+             head == SCREEN_AREA_ALL_MONITORS);
+    g_assert(!(head == SCREEN_AREA_ONE_MONITOR && search == NULL));
+
+    if (search)
+        find_area(desktop, head, search, area);
+    else
+        *area = *work_area(desktop, head);
+}
+
+/*! Returns TRUE if a strut on strut_desktop limits the areas on desktop */
+#define STRUT_ON_DESKTOP(strut_desktop, desktop) \
+    ((desktop) == DESKTOP_ALL || (strut_desktop) == DESKTOP_ALL || \
+     (desktop) == (strut_desktop))
+
+void screen_update_strut(ObClient *c, guint old_desktop, gboolean managed)
+{
+    GList *it;
+    const guint n_heads = screen_num_monitors + 1;
+    gboolean changed, *area_changed;
+    guint d, h;
+
+    remove_client_struts(c);
+    if (managed) {
+        add_client_struts(c);
+        validate_struts();
+    }
+
+    if (!work_areas || work_areas_desktops != screen_num_desktops) {
+        /* they will all be found again when they are next used */
+        g_free(work_areas);
+        work_areas = NULL;
+        changed = TRUE;
+        area_changed = NULL;
+    }
+    else {
+        /* find the areas again on the desktops that the strut was or is on,
+           and see if any of them moved */
+        changed = FALSE;
+        area_changed = g_new0(gboolean, (screen_num_desktops + 1) * n_heads);
+        for (d = 0; d <= screen_num_desktops; ++d) {
+            const guint desktop = d < screen_num_desktops ? d : DESKTOP_ALL;
+
+            if (!STRUT_ON_DESKTOP(old_desktop, desktop) &&
+                !STRUT_ON_DESKTOP(c->desktop, desktop))
+                continue;
+
+            for (h = 0; h < n_heads; ++h) {
+                Rect *a = &work_areas[d * n_heads + h];
+                Rect n;
+
+                find_area(desktop,
+                          h < screen_num_monitors ?
+                          h : SCREEN_AREA_ALL_MONITORS,
+                          NULL, &n);
+                if (!RECT_EQUAL(*a, n)) {
+                    *a = n;
+                    changed = TRUE;
+                    area_changed[d * n_heads + h] = TRUE;
+                }
+            }
+        }
+    }
+    if (changed)
+        root_props_dirty(OB_ROOT_PROP_WORKAREA);
+
+    /* the struts only constrain maximized windows, so the others don't need
+       to be adjusted.  a window maximized both ways fills its monitor's
+       area, so it only moves when that area does.  a window maximized one
+       way may be affected even when the monitor's area did not change. */
+    for (it = client_list; it; it = g_list_next(it)) {
+        ObClient *m = it->data;
+
+        if (!(m->max_horz || m->max_vert))
+            continue;
+        if (!STRUT_ON_DESKTOP(old_desktop, m->desktop) &&
+            !STRUT_ON_DESKTOP(c->desktop, m->desktop))
+            continue;
+        if (m->max_horz && m->max_vert && area_changed) {
+            d = m->desktop == DESKTOP_ALL ? screen_num_desktops : m->desktop;
+            if (!area_changed[d * n_heads + client_monitor(m)])
+                continue;
+        }
+        client_reconfigure(m, FALSE);
+    }
+
+    g_free(area_changed);
 }
 
 typedef struct {
@@ -1677,7 +1875,7 @@ typedef struct {
     gboolean subtract;
 } RectArithmetic;
 
-guint screen_find_monitor(const Rect *search)
+static guint find_monitor_slow(const Rect *search)
 {
     guint i;
     guint mostpx_index = screen_num_monitors;
@@ -1821,6 +2019,28 @@ guint screen_find_monitor(const Rect *search)
     return closest_distance_index;
 }
 
+guint screen_find_monitor(const Rect *search)
+{
+    guint i, n, found;
+
+    /* most of the time the search area is on a single monitor, and then that
+       monitor has all of its pixels without needing to count anything */
+    n = 0;
+    found = screen_num_monitors;
+    for (i = 0; i < screen_num_monitors && n < 2; ++i)
+        if (RECT_INTERSECTS_RECT(*screen_physical_area_monitor(i), *search)) {
+            found = i;
+            ++n;
+        }
+    if (n != 1)
+        found = find_monitor_slow(search);
+
+#ifdef DEBUG
+    g_assert(found == find_monitor_slow(search));
+#endif
+    return found;
+}
+
 const Rect* screen_physical_area_all_monitors(void)
 {
     return screen_physical_area_monitor(screen_num_monitors);
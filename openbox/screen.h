@@ -36,6 +36,9 @@ typedef enum {
 extern guint screen_num_desktops;
 /*! The number of virtual "xinerama" screens/heads */
 extern guint screen_num_monitors;
+/*! Changes whenever the monitors are rearranged, so that anything remembering
+  which monitor something is on knows to look again */
+extern guint screen_monitors_serial;
 /*! The current desktop */
 extern guint screen_desktop;
 /*! The desktop which was last visible */
@@ -112,7 +115,20 @@ void screen_update_desktop_names(void);
   it handles the root colormap. */
 void screen_install_colormap(struct _ObClient *client, gboolean install);
 
+/*! Finds the monitors and collects the struts from every window again, and
+  adjusts all the windows on the screen to fit */
 void screen_update_areas(void);
+/*! Updates the work areas after a client's strut changes, or it is moved to
+  another desktop while it has a strut.  Only the areas on the desktops
+  that the strut was and is on are found again, and only the maximized
+  windows there are adjusted to fit.
+  @param old_desktop The desktop the client was on before it was moved
+  @param managed FALSE if the client is being unmanaged, to remove its strut
+*/
+void screen_update_strut(struct _ObClient *c, guint old_desktop,
+                         gboolean managed);
+/*! Writes the _NET_WORKAREA property, called through root_props_flush() */
+void screen_write_workarea(void);
 
 const Rect* screen_physical_area_all_monitors(void);
 
@@ -145,12 +161,15 @@ const Rect* screen_physical_area_primary(gboolean fixed);
 #define SCREEN_AREA_ALL_MONITORS ((unsigned)-1)
 #define SCREEN_AREA_ONE_MONITOR  ((unsigned)-2)
 
-/*! @param head is the number of the head or one of SCREEN_AREA_ALL_MONITORS,
+/*! Finds the area that windows can use, inside of the struts.  The areas
+    for searching whole monitors are kept until the struts or monitors
+    change, so they are quick to get.
+    @param head is the number of the head or one of SCREEN_AREA_ALL_MONITORS,
            SCREEN_AREA_ONE_MONITOR
     @param search NULL or the whole monitor(s)
-    @return A Rect allocated with g_slice_new()
+    @param area Set to the area
  */
-Rect* screen_area(guint desktop, guint head, Rect *search);
+void screen_area(guint desktop, guint head, const Rect *search, Rect *area);
 
 gboolean screen_physical_area_monitor_contains(guint head, Rect *search);
 
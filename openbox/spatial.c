@@ -0,0 +1,326 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   spatial.c for the Openbox window manager
+   Copyright (c) 2026        agent
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#include "spatial.h"
+#include "client.h"
+#include "frame.h"
+#include "screen.h"
+#include "geom.h"
+#include "obt/bsearch.h"
+
+typedef struct _ObSpatialEntry {
+    ObClient *client;
+    /*! The area of the frame which its edges were sorted for */
+    Rect area;
+    /*! The cells which the frame is in, inclusive */
+    gint x1, y1, x2, y2;
+    /*! The search which last found the client */
+    guint visited;
+    /*! The spatial_find_edges() list which the client was last added to */
+    guint edges_found;
+} ObSpatialEntry;
+
+/*! The entry for each client (ObClient* -> ObSpatialEntry*) */
+static GHashTable *entries = NULL;
+/*! The entries (ObSpatialEntry*) in each cell of the grid, by rows */
+static GSList **cells = NULL;
+/*! The top left corner of the grid */
+static gint grid_x, grid_y;
+static gint cols = 0, rows = 0;
+/*! Counts the searches, so clients are found once in each */
+static guint search_id = 0;
+/*! Counts the lists built by spatial_find_edges(), so clients are added to
+  each once */
+static guint edges_search_id = 0;
+/*! The edges of the frames, sorted by position (ObSpatialEdgeEntry) */
+static GArray *edges[OB_NUM_SPATIAL_EDGES];
+
+typedef struct _ObSpatialEdgeEntry {
+    gint pos;
+    ObSpatialEntry *entry;
+} ObSpatialEdgeEntry;
+
+/* anything outside of the grid goes in the cells on its edges */
+#define CELL_COL(x) CLAMP(((x) - grid_x) / SPATIAL_CELL_SIZE, 0, cols - 1)
+#define CELL_ROW(y) CLAMP(((y) - grid_y) / SPATIAL_CELL_SIZE, 0, rows - 1)
+#define CELL(c, r) (cells[(r) * cols + (c)])
+
+static void entry_add(ObSpatialEntry *e)
+{
+    const Rect *a = &e->client->frame->area;
+    gint i, j;
+
+    e->x1 = CELL_COL(a->x);
+    e->y1 = CELL_ROW(a->y);
+    e->x2 = CELL_COL(a->x + MAX(a->width, 1) - 1);
+    e->y2 = CELL_ROW(a->y + MAX(a->height, 1) - 1);
+    for (j = e->y1; j <= e->y2; ++j)
+        for (i = e->x1; i <= e->x2; ++i)
+            CELL(i, j) = g_slist_prepend(CELL(i, j), e);
+}
+
+static void entry_remove(ObSpatialEntry *e)
+{
+    gint i, j;
+
+    for (j = e->y1; j <= e->y2; ++j)
+        for (i = e->x1; i <= e->x2; ++i)
+            CELL(i, j) = g_slist_remove(CELL(i, j), e);
+}
+
+#define EDGE_POS(e) ((e).pos)
+
+/*! Returns the index of the first edge at pos or after it */
+static guint edge_find(GArray *a, gint pos)
+{
+    ObSpatialEdgeEntry *ar = (ObSpatialEdgeEntry*)a->data;
+    guint i;
+    BSEARCH_SETUP();
+
+    BSEARCH_CMP(gint, ar, 0, a->len, pos, EDGE_POS);
+    if (BSEARCH_FOUND())
+        /* go to the first of any edges at the same position */
+        for (i = BSEARCH_AT(); i > 0 && ar[i-1].pos == pos; --i);
+    else if (BSEARCH_FOUND_NEAREST_SMALLER())
+        i = BSEARCH_AT() + 1;
+    else
+        i = BSEARCH_AT();
+    return MIN(i, a->len);
+}
+
+static gint edge_pos(const Rect *r, ObSpatialEdge edge)
+{
+    switch (edge) {
+    case OB_SPATIAL_EDGE_LEFT: return RECT_LEFT(*r);
+    case OB_SPATIAL_EDGE_RIGHT: return RECT_RIGHT(*r);
+    case OB_SPATIAL_EDGE_TOP: return RECT_TOP(*r);
+    case OB_SPATIAL_EDGE_BOTTOM: return RECT_BOTTOM(*r);
+    case OB_NUM_SPATIAL_EDGES: break;
+    }
+    g_assert_not_reached();
+    return 0;
+}
+
+static void edges_add(ObSpatialEntry *e)
+{
+    gint i;
+
+    for (i = 0; i < OB_NUM_SPATIAL_EDGES; ++i) {
+        ObSpatialEdgeEntry n;
+
+        n.pos = edge_pos(&e->area, i);
+        n.entry = e;
+        g_array_insert_val(edges[i], edge_find(edges[i], n.pos), n);
+    }
+}
+
+static void edges_remove(ObSpatialEntry *e)
+{
+    gint i;
+
+    for (i = 0; i < OB_NUM_SPATIAL_EDGES; ++i) {
+        gint pos = edge_pos(&e->area, i);
+        guint j;
+
+        for (j = edge_find(edges[i], pos); j < edges[i]->len; ++j) {
+            ObSpatialEdgeEntry *n = &g_array_index(edges[i],
+                                                   ObSpatialEdgeEntry, j);
+            g_assert(n->pos == pos);
+            if (n->entry == e) {
+                g_array_remove_index(edges[i], j);
+                break;
+            }
+        }
+    }
+}
+
+static void entry_free(gpointer data)
+{
+    g_slice_free(ObSpatialEntry, data);
+}
+
+void spatial_startup(gboolean reconfig)
+{
+    gint i;
+
+    if (reconfig) return;
+
+    for (i = 0; i < OB_NUM_SPATIAL_EDGES; ++i)
+        edges[i] = g_array_new(FALSE, FALSE, sizeof(ObSpatialEdgeEntry));
+
+    entries = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                    NULL, entry_free);
+    /* the grid is made when the screen's size is known */
+}
+
+void spatial_shutdown(gboolean reconfig)
+{
+    gint i;
+
+    if (reconfig) return;
+
+    for (i = 0; i < cols * rows; ++i)
+        g_slist_free(cells[i]);
+    g_free(cells);
+    cells = NULL;
+    cols = rows = 0;
+
+    g_hash_table_destroy(entries);
+    entries = NULL;
+
+    for (i = 0; i < OB_NUM_SPATIAL_EDGES; ++i) {
+        g_array_free(edges[i], TRUE);
+        edges[i] = NULL;
+    }
+}
+
+void spatial_resize(void)
+{
+    const Rect *a;
+    GHashTableIter it;
+    gpointer e;
+    gint i;
+
+    if (!entries) return;
+
+    for (i = 0; i < cols * rows; ++i)
+        g_slist_free(cells[i]);
+    g_free(cells);
+
+    a = screen_physical_area_all_monitors();
+    grid_x = a->x;
+    grid_y = a->y;
+    cols = MAX((a->width + SPATIAL_CELL_SIZE - 1) / SPATIAL_CELL_SIZE, 1);
+    rows = MAX((a->height + SPATIAL_CELL_SIZE - 1) / SPATIAL_CELL_SIZE, 1);
+    cells = g_new0(GSList*, cols * rows);
+
+    g_hash_table_iter_init(&it, entries);
+    while (g_hash_table_iter_next(&it, NULL, &e))
+        entry_add(e);
+}
+
+void spatial_update(ObClient *c)
+{
+    ObSpatialEntry *e;
+    const Rect *a = &c->frame->area;
+
+    if (!cells) return;
+
+    if ((e = g_hash_table_lookup(entries, c))) {
+        if (RECT_EQUAL(e->area, *a))
+            return;
+        edges_remove(e);
+        e->area = *a;
+        edges_add(e);
+
+        /* it is usually still in the same cells */
+        if (e->x1 == CELL_COL(a->x) && e->y1 == CELL_ROW(a->y) &&
+            e->x2 == CELL_COL(a->x + MAX(a->width, 1) - 1) &&
+            e->y2 == CELL_ROW(a->y + MAX(a->height, 1) - 1))
+        {
+            return;
+        }
+        entry_remove(e);
+    }
+    else {
+        e = g_slice_new0(ObSpatialEntry);
+        e->client = c;
+        e->area = *a;
+        g_hash_table_insert(entries, c, e);
+        edges_add(e);
+    }
+    entry_add(e);
+}
+
+void spatial_remove(ObClient *c)
+{
+    ObSpatialEntry *e;
+
+    if (entries && (e = g_hash_table_lookup(entries, c))) {
+        edges_remove(e);
+        entry_remove(e);
+        g_hash_table_remove(entries, c);
+    }
+}
+
+/*! Returns FALSE if the search should stop */
+static gboolean search_cell(gint col, gint row, gint ring,
+                            ObSpatialFunc func, gpointer data)
+{
+    GSList *it;
+
+    for (it = CELL(col, row); it; it = g_slist_next(it)) {
+        ObSpatialEntry *e = it->data;
+
+        if (e->visited == search_id) continue;
+        e->visited = search_id;
+        if (!func(e->client, ring, data))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+void spatial_search(gint x, gint y, ObSpatialFunc func, gpointer data)
+{
+    gint cx, cy, r, maxr, i, j;
+
+    if (!cells) return;
+
+    ++search_id;
+
+    cx = CELL_COL(x);
+    cy = CELL_ROW(y);
+    maxr = MAX(MAX(cx, cols - 1 - cx), MAX(cy, rows - 1 - cy));
+    for (r = 0; r <= maxr; ++r)
+        for (j = MAX(cy - r, 0); j <= MIN(cy + r, rows - 1); ++j) {
+            /* in the top and bottom rows of the ring every cell is in it,
+               and in the others just the two cells on its sides */
+            gint step = (j == cy - r || j == cy + r) ? 1 : 2 * r;
+
+            for (i = cx - r; i <= cx + r; i += step)
+                if (i >= 0 && i < cols &&
+                    !search_cell(i, j, r, func, data))
+                {
+                    return;
+                }
+        }
+}
+
+GSList* spatial_find_edges(GSList *list, ObSpatialEdge edge,
+                           gint start, gint end)
+{
+    GArray *a;
+    guint i;
+
+    if (!entries) return list;
+
+    /* a new list is being started */
+    if (!list) ++edges_search_id;
+
+    a = edges[edge];
+    for (i = edge_find(a, start); i < a->len; ++i) {
+        ObSpatialEdgeEntry *n = &g_array_index(a, ObSpatialEdgeEntry, i);
+
+        if (n->pos > end) break;
+        if (n->entry->edges_found != edges_search_id) {
+            n->entry->edges_found = edges_search_id;
+            list = g_slist_prepend(list, n->entry->client);
+        }
+    }
+    return list;
+}
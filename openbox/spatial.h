@@ -0,0 +1,76 @@
+/* -*- indent-tabs-mode: nil; tab-width: 4; c-basic-offset: 4; -*-
+
+   spatial.h for the Openbox window manager
+   Copyright (c) 2026        agent
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   See the COPYING file for a copy of the GNU General Public License.
+*/
+
+#ifndef __spatial_h
+#define __spatial_h
+
+#include <glib.h>
+
+struct _ObClient;
+
+/*! The edges of the frames which are kept sorted */
+typedef enum {
+    OB_SPATIAL_EDGE_LEFT,   /*!< The x of each frame's left column */
+    OB_SPATIAL_EDGE_RIGHT,  /*!< The x of each frame's right column */
+    OB_SPATIAL_EDGE_TOP,    /*!< The y of each frame's top row */
+    OB_SPATIAL_EDGE_BOTTOM, /*!< The y of each frame's bottom row */
+    OB_NUM_SPATIAL_EDGES
+} ObSpatialEdge;
+
+/*! The width and height of each cell of the grid that the screen is divided
+  into, in pixels */
+#define SPATIAL_CELL_SIZE 256
+
+/*! Called for each client found by spatial_search().
+  @param ring How many cells away from the starting point the client was
+    found.  A client is found in the nearest cell that its frame covers.
+  @return FALSE to stop the search
+*/
+typedef gboolean (*ObSpatialFunc)(struct _ObClient *c, gint ring,
+                                  gpointer data);
+
+void spatial_startup(gboolean reconfig);
+void spatial_shutdown(gboolean reconfig);
+
+/*! Makes the grid cover the screen again, after its size changes */
+void spatial_resize(void);
+
+/*! Updates where the client's frame is, after its area changes */
+void spatial_update(struct _ObClient *c);
+/*! Forgets about the client */
+void spatial_remove(struct _ObClient *c);
+
+/*! Finds each client whose frame is near a point, once.  Clients in the cell
+  holding the point are found first, followed by the cells around it, and
+  working outwards one ring of cells at a time.  Clients are found no matter
+  what desktop they are on or if they are visible. */
+void spatial_search(gint x, gint y, ObSpatialFunc func, gpointer data);
+
+/*! Finds the clients with an edge of their frame between two positions.
+  Clients are found no matter what desktop they are on or if they are
+  visible.
+  @param list NULL to start a new list, or a list which was returned by the
+    last call to this function, to add the clients found to.
+  @param start The first position to look at.
+  @param end The last position to look at.
+  @return The list, with any clients found added that were not already in it
+*/
+GSList* spatial_find_edges(GSList *list, ObSpatialEdge edge,
+                           gint start, gint end);
+
+#endif
@@ -28,16 +28,182 @@
 #include "debug.h"
 #include "dock.h"
 #include "config.h"
+#include "rootprops.h"
 #include "obt/prop.h"
 
 GList  *stacking_list = NULL;
 GList  *stacking_list_tail = NULL;
+
+/*! Where a window is in the stacking_list */
+typedef struct _ObStackingPos {
+    GList *link;
+    ObStackingLayer layer; /*!< The layer it was in when it was added */
+    guint64 order; /*!< Grows going down the stacking_list, to compare the
+                      positions of two windows */
+} ObStackingPos;
+
+/*! The space left between the order of windows when they are numbered */
+#define ORDER_GAP ((guint64)1 << 32)
+
+/*! The position of each window in the stacking_list (ObWindow* ->
+  ObStackingPos*), so they can be found without searching the list */
+static GHashTable *stacking_pos = NULL;
+/*! The highest window in each layer of the stacking_list, or NULL if there
+  are no windows in the layer */
+static GList *layer_top[OB_NUM_STACKING_LAYERS];
 /*! When true, stacking changes will not be reflected on the screen.  This is
   to freeze the on-screen stacking order while a window is being temporarily
   raised during focus cycling */
 static gboolean pause_changes = FALSE;
 
+#define link_pos(link) \
+    ((ObStackingPos*)g_hash_table_lookup(stacking_pos, (link)->data))
+
+/*! Number all of the windows in the stacking_list again, spaced out evenly */
+static void renumber(void)
+{
+    GList *it;
+    guint64 order;
+
+    order = G_MAXUINT64 / 2 -
+        (guint64)g_hash_table_size(stacking_pos) / 2 * ORDER_GAP;
+    for (it = stacking_list; it; it = g_list_next(it)) {
+        link_pos(it)->order = order;
+        order += ORDER_GAP;
+    }
+}
+
+/*! Give a window an order between the windows above and below it */
+static void set_order(ObStackingPos *pos)
+{
+    GList *link = pos->link;
+    guint64 lo, hi;
+
+    lo = link->prev ? link_pos(link->prev)->order : 0;
+    hi = link->next ? link_pos(link->next)->order : G_MAXUINT64;
+
+    if (!link->prev && !link->next)
+        pos->order = G_MAXUINT64 / 2;
+    else if (!link->prev && hi >= ORDER_GAP)
+        pos->order = hi - ORDER_GAP;
+    else if (!link->next && lo <= G_MAXUINT64 - ORDER_GAP)
+        pos->order = lo + ORDER_GAP;
+    else if (hi - lo >= 2)
+        pos->order = lo + (hi - lo) / 2;
+    else
+        /* there is no room between them */
+        renumber();
+}
+
+/*! Put a window into the stacking_list above another, or at the bottom if
+  before is NULL */
+static void list_insert(ObWindow *win, GList *before)
+{
+    ObStackingPos *pos;
+    GList *link;
+
+    if (!stacking_pos)
+        stacking_pos = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    link = g_list_alloc();
+    link->data = win;
+    link->next = before;
+    link->prev = before ? before->prev : stacking_list_tail;
+    if (link->prev) link->prev->next = link;
+    else stacking_list = link;
+    if (link->next) link->next->prev = link;
+    else stacking_list_tail = link;
+
+    pos = g_slice_new(ObStackingPos);
+    pos->link = link;
+    pos->layer = window_layer(win);
+    /* going above the top of the layer, or into an empty layer */
+    if (!layer_top[pos->layer] || layer_top[pos->layer] == before)
+        layer_top[pos->layer] = link;
+    g_hash_table_insert(stacking_pos, win, pos);
+    set_order(pos);
+}
+
+/*! Take a window out of the stacking_list, if it is in there */
+static void list_remove(ObWindow *win)
+{
+    ObStackingPos *pos;
+    GList *link;
+
+    if (!stacking_pos || !(pos = g_hash_table_lookup(stacking_pos, win)))
+        return;
+    link = pos->link;
+
+    if (layer_top[pos->layer] == link) {
+        ObStackingPos *next = NULL;
+
+        if (link->next)
+            next = g_hash_table_lookup(stacking_pos, link->next->data);
+        layer_top[pos->layer] =
+            next && next->layer == pos->layer ? next->link : NULL;
+    }
+
+    if (link->prev) link->prev->next = link->next;
+    else stacking_list = link->next;
+    if (link->next) link->next->prev = link->prev;
+    else stacking_list_tail = link->prev;
+    g_list_free_1(link);
+
+    g_hash_table_remove(stacking_pos, win);
+    g_slice_free(ObStackingPos, pos);
+
+    if (!stacking_list) {
+        g_hash_table_destroy(stacking_pos);
+        stacking_pos = NULL;
+    }
+}
+
+GList* stacking_find(ObWindow *win)
+{
+    ObStackingPos *pos;
+
+    if (!stacking_pos || !(pos = g_hash_table_lookup(stacking_pos, win)))
+        return NULL;
+    return pos->link;
+}
+
+GList* stacking_layer_top(ObStackingLayer layer)
+{
+    gint i;
+
+    for (i = layer; i >= 0; --i)
+        if (layer_top[i]) return layer_top[i];
+    return NULL;
+}
+
+gboolean stacking_is_above(ObWindow *a, ObWindow *b)
+{
+    ObStackingPos *pa, *pb;
+
+    if (!stacking_pos) return FALSE;
+    pa = g_hash_table_lookup(stacking_pos, a);
+    pb = g_hash_table_lookup(stacking_pos, b);
+    return pa && pb && pa->order < pb->order;
+}
+
+/*! Returns the highest window which is in a lower layer than the given one,
+  or NULL if there are none */
+static GList* below_layer(ObStackingLayer layer)
+{
+    return layer > 0 ? stacking_layer_top(layer - 1) : NULL;
+}
+
+void stacking_remove(ObWindow *win)
+{
+    list_remove(win);
+}
+
 void stacking_set_list(void)
+{
+    root_props_dirty(OB_ROOT_PROP_CLIENT_LIST_STACKING);
+}
+
+void stacking_write_list(void)
 {
     Window *windows = NULL;
     GList *it;
@@ -51,8 +217,8 @@ void stacking_set_list(void)
     /* create an array of the window ids (from bottom to top,
        reverse order!) */
     if (stacking_list) {
-        windows = g_new(Window, g_list_length(stacking_list));
-        for (it = g_list_last(stacking_list); it; it = g_list_previous(it)) {
+        windows = g_new(Window, g_hash_table_size(stacking_pos));
+        for (it = stacking_list_tail; it; it = g_list_previous(it)) {
             if (WINDOW_IS_CLIENT(it->data))
                 windows[i++] = WINDOW_AS_CLIENT(it->data)->window;
         }
@@ -89,7 +255,7 @@ static void do_restack(GList *wins, GList *before)
     if (before == stacking_list)
         win[0] = screen_support_win;
     else if (!before)
-        win[0] = window_top(g_list_last(stacking_list)->data);
+        win[0] = window_top(stacking_list_tail->data);
     else
         win[0] = window_top(g_list_previous(before)->data);
 
@@ -97,7 +263,7 @@ static void do_restack(GList *wins, GList *before)
         win[i] = window_top(it->data);
         g_assert(win[i] != None); /* better not call stacking shit before
                                      setting your top level window value */
-        stacking_list = g_list_insert_before(stacking_list, before, it->data);
+        list_insert(it->data, before);
     }
 
 #ifdef DEBUG
@@ -150,7 +316,8 @@ void stacking_restore(void)
     gint i;
     gulong start;
 
-    win = g_new(Window, g_list_length(stacking_list) + 1);
+    win = g_new(Window, (stacking_pos ?
+                         g_hash_table_size(stacking_pos) : 0) + 1);
     win[0] = screen_support_win;
     for (i = 1, it = stacking_list; it; ++i, it = g_list_next(it))
         win[i] = window_top(it->data);
@@ -175,15 +342,10 @@ static void do_raise(GList *wins)
         layer[l] = g_list_append(layer[l], it->data);
     }
 
-    it = stacking_list;
     for (i = OB_NUM_STACKING_LAYERS - 1; i >= 0; --i) {
         if (layer[i]) {
-            for (; it; it = g_list_next(it)) {
-                /* look for the top of the layer */
-                if (window_layer(it->data) <= (ObStackingLayer) i)
-                    break;
-            }
-            do_restack(layer[i], it);
+            /* go on the top of the layer */
+            do_restack(layer[i], stacking_layer_top(i));
             g_list_free(layer[i]);
         }
     }
@@ -202,15 +364,10 @@ static void do_lower(GList *wins)
         layer[l] = g_list_append(layer[l], it->data);
     }
 
-    it = stacking_list;
     for (i = OB_NUM_STACKING_LAYERS - 1; i >= 0; --i) {
         if (layer[i]) {
-            for (; it; it = g_list_next(it)) {
-                /* look for the top of the next layer down */
-                if (window_layer(it->data) < (ObStackingLayer) i)
-                    break;
-            }
-            do_restack(layer[i], it);
+            /* go above the top of the next layer down */
+            do_restack(layer[i], below_layer(i));
             g_list_free(layer[i]);
         }
     }
@@ -218,7 +375,7 @@ static void do_lower(GList *wins)
 
 static void restack_windows(ObClient *selected, gboolean raise)
 {
-    GList *it, *last, *below, *above, *next;
+    GList *it, *below, *above, *next;
     GList *wins = NULL;
 
     GList *group_helpers = NULL;
@@ -237,14 +394,16 @@ static void restack_windows(ObClient *selected, gboolean raise)
     }
 
     /* remove first so we can't run into ourself */
-    it = g_list_find(stacking_list, selected);
-    g_assert(it);
-    stacking_list = g_list_delete_link(stacking_list, it);
+    g_assert(stacking_find(CLIENT_AS_WINDOW(selected)));
+    list_remove(CLIENT_AS_WINDOW(selected));
 
-    /* go from the bottom of the stacking list up. don't move any other windows
-       when lowering, we call this for each window independently */
+    /* go from the bottom of the selected window's layer up. don't move any
+       other windows when lowering, we call this for each window
+       independently */
     if (raise) {
-        for (it = g_list_last(stacking_list); it; it = next) {
+        it = below_layer(selected->layer);
+        it = it ? g_list_previous(it) : stacking_list_tail;
+        for (; it && window_layer(it->data) <= selected->layer; it = next) {
             next = g_list_previous(it);
 
             if (WINDOW_IS_CLIENT(it->data)) {
@@ -275,7 +434,7 @@ static void restack_windows(ObClient *selected, gboolean raise)
                         else
                             group_trans = g_list_prepend(group_trans, ch);
                     }
-                    stacking_list = g_list_delete_link(stacking_list, it);
+                    list_remove(it->data);
                 }
             }
         }
@@ -301,33 +460,17 @@ static void restack_windows(ObClient *selected, gboolean raise)
         group_trans = NULL;
     }
 
-    /* find where to put the selected window, start from bottom of list,
-       this is the window below everything we are re-adding to the list */
-    last = NULL;
-    for (it = g_list_last(stacking_list); it; it = g_list_previous(it))
-    {
-        if (window_layer(it->data) < selected->layer) {
-            last = it;
-            continue;
-        }
-        /* if lowering, stop at the beginning of the layer */
-        if (!raise)
-            break;
-        /* if raising, stop at the end of the layer */
-        if (window_layer(it->data) > selected->layer)
-            break;
-
-        last = it;
-    }
-
-    /* save this position in the stacking list */
-    below = last;
+    /* find where to put the selected window, this is the window below
+       everything we are re-adding to the list.  if raising, it goes on the top
+       of the layer, and if lowering, on the bottom of it */
+    if (raise)
+        below = stacking_layer_top(selected->layer);
+    else
+        below = below_layer(selected->layer);
 
-    /* find where to put the group transients, start from the top of list */
-    for (it = stacking_list; it; it = g_list_next(it)) {
-        /* skip past higher layers */
-        if (window_layer(it->data) > selected->layer)
-            continue;
+    /* find where to put the group transients, start from the top of the
+       layer */
+    for (it = stacking_layer_top(selected->layer); it; it = g_list_next(it)) {
         /* if we reach the end of the layer (how?) then don't go further */
         if (window_layer(it->data) < selected->layer)
             break;
@@ -350,17 +493,17 @@ static void restack_windows(ObClient *selected, gboolean raise)
        we actually want to save 1 position _above_ that, for for loops to work
        nicely, so move back one position in the list while saving it
     */
-    above = it ? g_list_previous(it) : g_list_last(stacking_list);
+    above = it ? g_list_previous(it) : stacking_list_tail;
 
     /* put the windows inside the gap to the other windows we're stacking
        into the restacking list, go from the bottom up so that we can use
        g_list_prepend */
     if (below) it = g_list_previous(below);
-    else       it = g_list_last(stacking_list);
+    else       it = stacking_list_tail;
     for (; it != above; it = next) {
         next = g_list_previous(it);
         wins = g_list_prepend(wins, it->data);
-        stacking_list = g_list_delete_link(stacking_list, it);
+        list_remove(it->data);
     }
 
     /* group transients go above the rest of the stuff acquired to now */
@@ -379,7 +522,7 @@ static void restack_windows(ObClient *selected, gboolean raise)
         parents_copy = g_slist_copy(selected->parents);
 
         /* go thru stacking list backwards so we can use g_slist_prepend */
-        for (it = g_list_last(stacking_list); it && parents_copy;
+        for (it = stacking_list_tail; it && parents_copy;
              it = g_list_previous(it))
             if ((sit = g_slist_find(parents_copy, it->data))) {
                 reorder = g_slist_prepend(reorder, sit->data);
@@ -402,11 +545,10 @@ void stacking_raise(ObWindow *window)
     } else {
         GList *wins;
         wins = g_list_append(NULL, window);
-        stacking_list = g_list_remove(stacking_list, window);
+        list_remove(window);
         do_raise(wins);
         g_list_free(wins);
     }
-    stacking_list_tail = g_list_last(stacking_list);
 }
 
 void stacking_lower(ObWindow *window)
@@ -418,11 +560,10 @@ void stacking_lower(ObWindow *window)
     } else {
         GList *wins;
         wins = g_list_append(NULL, window);
-        stacking_list = g_list_remove(stacking_list, window);
+        list_remove(window);
         do_lower(wins);
         g_list_free(wins);
     }
-    stacking_list_tail = g_list_last(stacking_list);
 }
 
 void stacking_below(ObWindow *window, ObWindow *below)
@@ -433,11 +574,10 @@ void stacking_below(ObWindow *window, ObWindow *below)
         return;
 
     wins = g_list_append(NULL, window);
-    stacking_list = g_list_remove(stacking_list, window);
-    before = g_list_next(g_list_find(stacking_list, below));
+    list_remove(window);
+    before = g_list_next(stacking_find(below));
     do_restack(wins, before);
     g_list_free(wins);
-    stacking_list_tail = g_list_last(stacking_list);
 }
 
 void stacking_add(ObWindow *win)
@@ -447,10 +587,9 @@ void stacking_add(ObWindow *win)
     /* don't add windows that are being unmanaged ! */
     if (WINDOW_IS_CLIENT(win)) g_assert(WINDOW_AS_CLIENT(win)->managed);
 
-    stacking_list = g_list_append(stacking_list, win);
+    list_insert(win, NULL);
 
     stacking_raise(win);
-    /* stacking_list_tail set by stacking_raise() */
 }
 
 static GList *find_highest_relative(ObClient *client)
@@ -464,14 +603,16 @@ static GList *find_highest_relative(ObClient *client)
         /* get all top level relatives of this client */
         top = client_search_all_top_parents_layer(client);
 
-        /* go from the top of the stacking order down */
-        for (it = stacking_list; !ret && it; it = g_list_next(it)) {
+        /* go from the top of the layer down, only looking at windows in the
+           same layer */
+        for (it = stacking_layer_top(client->layer);
+             !ret && it && window_layer(it->data) == client->layer;
+             it = g_list_next(it))
+        {
             if (WINDOW_IS_CLIENT(it->data)) {
                 ObClient *c = it->data;
-                /* only look at windows in the same layer and that are
-                   visible */
-                if (c->layer == client->layer &&
-                    !c->iconic &&
+                /* only look at windows that are visible */
+                if (!c->iconic &&
                     (c->desktop == client->desktop ||
                      c->desktop == DESKTOP_ALL ||
                      client->desktop == DESKTOP_ALL))
@@ -520,7 +661,7 @@ void stacking_add_nonintrusive(ObWindow *win)
         if (focus_client && client != focus_client &&
             focus_client->layer == client->layer)
         {
-            it_below = g_list_find(stacking_list, focus_client);
+            it_below = stacking_find(CLIENT_AS_WINDOW(focus_client));
             /* this can give NULL, but it means the focused window is on the
                bottom of the stacking order, so go to the bottom in that case,
                below it */
@@ -545,25 +686,19 @@ void stacking_add_nonintrusive(ObWindow *win)
     }
 
     /* make sure it's not in the wrong layer though ! */
-    for (; it_below; it_below = g_list_next(it_below)) {
-        /* stop when the window is not in a higher layer than the window
-           it is going above (it_below) */
-        if (client->layer >= window_layer(it_below->data))
-            break;
-    }
-    for (; it_below != stacking_list; it_below = it_above) {
-        /* stop when the window is not in a lower layer than the
-           window it is going under (it_above) */
-        it_above = it_below ?
-            g_list_previous(it_below) : g_list_last(stacking_list);
-        if (client->layer <= window_layer(it_above->data))
-            break;
+    if (it_below && client->layer < window_layer(it_below->data))
+        /* don't go above a window in a higher layer (it_below) */
+        it_below = stacking_layer_top(client->layer);
+    else {
+        it_above = it_below ? g_list_previous(it_below) : stacking_list_tail;
+        if (it_above && client->layer > window_layer(it_above->data))
+            /* don't go below a window in a lower layer (it_above) */
+            it_below = below_layer(client->layer);
     }
 
     wins = g_list_append(NULL, win);
     do_restack(wins, it_below);
     g_list_free(wins);
-    stacking_list_tail = g_list_last(stacking_list);
 }
 
 /*! Returns TRUE if client is occluded by the sibling. If sibling is NULL it
@@ -582,7 +717,7 @@ static gboolean stacking_occluded(ObClient *client, ObWindow *sibling_win)
     if (sibling && client->layer != sibling->layer)
         return FALSE;
 
-    for (it = g_list_previous(g_list_find(stacking_list, client)); it;
+    for (it = g_list_previous(stacking_find(CLIENT_AS_WINDOW(client))); it;
          it = g_list_previous(it))
         if (WINDOW_IS_CLIENT(it->data)) {
             ObClient *c = it->data;
@@ -642,7 +777,7 @@ static gboolean stacking_occludes(ObClient *client, ObWindow *sibling_win)
     if (sibling && client->layer != sibling->layer)
         return FALSE;
 
-    for (it = g_list_next(g_list_find(stacking_list, client));
+    for (it = g_list_next(stacking_find(CLIENT_AS_WINDOW(client)));
          it; it = g_list_next(it))
         if (WINDOW_IS_CLIENT(it->data)) {
             ObClient *c = it->data;
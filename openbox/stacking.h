@@ -43,13 +43,29 @@ extern GList *stacking_list;
 /* list of ObWindow*s in stacking order from lowest to highest */
 extern GList *stacking_list_tail;
 
+/*! Returns the window's link in the stacking_list, or NULL if it is not in
+  the list.  The list can be walked up or down from here. */
+GList* stacking_find(struct _ObWindow *win);
+
+/*! Returns the link in the stacking_list of the highest window in the layer,
+  or of the highest window below it if the layer is empty.  NULL if there are
+  no windows in the layer or below it. */
+GList* stacking_layer_top(ObStackingLayer layer);
+
+/*! Returns TRUE if window a is higher in the stacking order than window b.
+  Both must be in the stacking_list. */
+gboolean stacking_is_above(struct _ObWindow *a, struct _ObWindow *b);
+
 /*! Sets the window stacking list on the root window from the
   stacking_list */
 void stacking_set_list(void);
+/*! Writes the _NET_CLIENT_LIST_STACKING property, called through
+  root_props_flush() */
+void stacking_write_list(void);
 
 void stacking_add(struct _ObWindow *win);
 void stacking_add_nonintrusive(struct _ObWindow *win);
-#define stacking_remove(win) stacking_list = g_list_remove(stacking_list, win);
+void stacking_remove(struct _ObWindow *win);
 
 /*! Raises a window above all others in its stacking layer */
 void stacking_raise(struct _ObWindow *window);